@@ -44,8 +44,19 @@
 #include "pkl.h"
 #include <libxml++/libxml++.h>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+#include <boost/exception_ptr.hpp>
+#include <algorithm>
+#include <set>
 
 using std::string;
+using std::list;
+using std::vector;
+using std::set;
+using std::pair;
+using std::make_pair;
+using std::min;
 using boost::function;
 using boost::shared_ptr;
 using boost::optional;
@@ -171,3 +182,200 @@ Asset::set_hash (string hash)
 {
 	_hash = hash;
 }
+
+/** State shared between the threads of hash_assets() */
+struct HashJobs
+{
+	HashJobs ()
+		: next (0)
+		, running (0)
+		, changed (false)
+	{}
+
+	/** mutex for everything below except assets and sizes */
+	boost::mutex mutex;
+	boost::condition_variable condition;
+	std::vector<shared_ptr<Asset> > assets;
+	std::vector<boost::uintmax_t> sizes;
+	/** progress of each asset's hash, from 0 to 1 */
+	std::vector<float> progress;
+	/** true for each asset whose hash has been started */
+	std::vector<bool> started;
+	/** true for each asset whose hash has been successfully computed */
+	std::vector<bool> hashed;
+	/** index of the next asset to hash */
+	size_t next;
+	/** number of threads still running */
+	int running;
+	/** true if progress has changed since it was last reported */
+	bool changed;
+	boost::exception_ptr error;
+};
+
+static void
+hash_progress (HashJobs* jobs, size_t index, float progress)
+{
+	boost::mutex::scoped_lock lm (jobs->mutex);
+	jobs->progress[index] = progress;
+	jobs->changed = true;
+	jobs->condition.notify_all ();
+}
+
+static void
+hash_thread (HashJobs* jobs)
+{
+	boost::mutex::scoped_lock lm (jobs->mutex);
+
+	while (jobs->next < jobs->assets.size() && !jobs->error) {
+		size_t const index = jobs->next++;
+		jobs->started[index] = true;
+		jobs->changed = true;
+		jobs->condition.notify_all ();
+		lm.unlock ();
+
+		boost::exception_ptr error;
+		try {
+			jobs->assets[index]->hash (boost::bind (&hash_progress, jobs, index, _1));
+		} catch (...) {
+			error = boost::current_exception ();
+		}
+
+		lm.lock ();
+		if (error && !jobs->error) {
+			jobs->error = error;
+		} else if (!error) {
+			jobs->hashed[index] = true;
+		}
+		jobs->progress[index] = 1;
+		jobs->changed = true;
+		jobs->condition.notify_all ();
+	}
+
+	--jobs->running;
+	jobs->condition.notify_all ();
+}
+
+static bool
+larger (pair<boost::uintmax_t, shared_ptr<Asset> > const & a, pair<boost::uintmax_t, shared_ptr<Asset> > const & b)
+{
+	return a.first > b.first;
+}
+
+/** Compute the hashes of some assets, hashing up to @ref threads of them at the same time.
+ *  The hashes are then available from Asset::hash() without further work.
+ *  @param assets Assets to hash.
+ *  @param threads Number of threads to use.
+ *  @param progress Optional progress reporting function.  It will be called, on the calling
+ *  thread, with the progress through all the assets (weighted by their size) from 0 to 1.
+ *  @param done Optional function which will be called, on the calling thread, with each
+ *  asset as soon as its hash has been computed.
+ *  @param asset_progress Optional function which will be called, on the calling thread, with
+ *  an asset and the progress through its hash from 0 to 1.  It is first called for each asset
+ *  when its hash is started (though the progress given then may be more than 0 if the hash
+ *  is quick), and then whenever that progress changes.
+ */
+void
+dcp::hash_assets (
+	list<shared_ptr<Asset> > assets,
+	int threads,
+	function<void (float)> progress,
+	function<void (shared_ptr<Asset>)> done,
+	function<void (shared_ptr<Asset>, float)> asset_progress
+	)
+{
+	DCP_ASSERT (threads > 0);
+
+	/* Start on the biggest assets first so that we are not left waiting for one big
+	   asset on one thread at the end.
+	*/
+	vector<pair<boost::uintmax_t, shared_ptr<Asset> > > sorted;
+	set<Asset*> seen;
+	BOOST_FOREACH (shared_ptr<Asset> i, assets) {
+		if (i->file() && seen.find (i.get()) == seen.end ()) {
+			sorted.push_back (make_pair (boost::filesystem::file_size (i->file().get()), i));
+			seen.insert (i.get ());
+		}
+	}
+	std::stable_sort (sorted.begin(), sorted.end(), larger);
+
+	HashJobs jobs;
+	boost::uintmax_t total = 0;
+	for (size_t i = 0; i < sorted.size(); ++i) {
+		jobs.sizes.push_back (sorted[i].first);
+		jobs.assets.push_back (sorted[i].second);
+		total += sorted[i].first;
+	}
+	jobs.progress.resize (jobs.assets.size(), 0);
+	jobs.started.resize (jobs.assets.size(), false);
+	jobs.hashed.resize (jobs.assets.size(), false);
+	vector<bool> reported (jobs.assets.size(), false);
+	/* progress of each asset as it was last given to asset_progress, or -1 if it has not been */
+	vector<float> reported_progress (jobs.assets.size(), -1);
+	jobs.running = min (threads, int (jobs.assets.size ()));
+
+	boost::thread_group group;
+	for (int i = 0; i < jobs.running; ++i) {
+		group.create_thread (boost::bind (&hash_thread, &jobs));
+	}
+
+	try {
+		boost::mutex::scoped_lock lm (jobs.mutex);
+		while (jobs.running > 0) {
+			while (jobs.running > 0 && !jobs.changed) {
+				jobs.condition.wait (lm);
+			}
+
+			jobs.changed = false;
+
+			double so_far = 0;
+			for (size_t i = 0; i < jobs.progress.size(); ++i) {
+				so_far += double (jobs.sizes[i]) * jobs.progress[i];
+			}
+
+			list<pair<shared_ptr<Asset>, float> > progressed;
+			for (size_t i = 0; i < jobs.started.size(); ++i) {
+				if (jobs.started[i] && jobs.progress[i] != reported_progress[i]) {
+					progressed.push_back (make_pair (jobs.assets[i], jobs.progress[i]));
+					reported_progress[i] = jobs.progress[i];
+				}
+			}
+
+			list<shared_ptr<Asset> > finished;
+			for (size_t i = 0; i < jobs.hashed.size(); ++i) {
+				if (jobs.hashed[i] && !reported[i]) {
+					finished.push_back (jobs.assets[i]);
+					reported[i] = true;
+				}
+			}
+
+			lm.unlock ();
+			if (asset_progress) {
+				for (list<pair<shared_ptr<Asset>, float> >::const_iterator i = progressed.begin(); i != progressed.end(); ++i) {
+					asset_progress (i->first, i->second);
+				}
+			}
+			if (progress && total > 0) {
+				progress (so_far / total);
+			}
+			if (done) {
+				BOOST_FOREACH (shared_ptr<Asset> i, finished) {
+					done (i);
+				}
+			}
+			lm.lock ();
+		}
+	} catch (...) {
+		{
+			boost::mutex::scoped_lock lm (jobs.mutex);
+			jobs.next = jobs.assets.size ();
+		}
+		group.join_all ();
+		throw;
+	}
+
+	group.join_all ();
+
+	if (jobs.error) {
+		boost::rethrow_exception (jobs.error);
+	}
+}
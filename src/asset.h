@@ -45,6 +45,7 @@
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
 #include <boost/optional.hpp>
+#include <list>
 
 namespace xmlpp {
 	class Node;
@@ -109,6 +110,14 @@ private:
 	mutable boost::optional<std::string> _hash;
 };
 
+extern void hash_assets (
+	std::list<boost::shared_ptr<Asset> > assets,
+	int threads,
+	boost::function<void (float)> progress = 0,
+	boost::function<void (boost::shared_ptr<Asset>)> done = 0,
+	boost::function<void (boost::shared_ptr<Asset>, float)> asset_progress = 0
+	);
+
 }
 
 #endif
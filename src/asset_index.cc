@@ -0,0 +1,109 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/asset_index.cc
+ *  @brief AssetIndex class.
+ */
+
+#include "asset_index.h"
+#include "asset.h"
+#include "font_asset.h"
+#include <boost/algorithm/string.hpp>
+#include <boost/foreach.hpp>
+
+using std::list;
+using std::string;
+using boost::shared_ptr;
+using boost::dynamic_pointer_cast;
+using namespace dcp;
+
+/** @return an ID in the form that ids_equal() compares */
+static string
+normalise_id (string id)
+{
+	boost::algorithm::to_lower (id);
+	boost::algorithm::trim (id);
+	return id;
+}
+
+AssetIndex::AssetIndex (list<shared_ptr<Asset> > const & assets)
+{
+	_assets.rehash (assets.size ());
+	BOOST_FOREACH (shared_ptr<Asset> i, assets) {
+		/* insert() does nothing if the ID is already there, so the first asset wins */
+		_assets.insert (std::make_pair (normalise_id (i->id ()), i));
+		if (dynamic_pointer_cast<FontAsset> (i)) {
+			_fonts.push_back (i);
+		}
+	}
+}
+
+/** @param id ID to look for.
+ *  @return the asset with that ID, or 0.
+ */
+shared_ptr<Asset>
+AssetIndex::find (string id) const
+{
+	boost::unordered_map<string, shared_ptr<Asset> >::const_iterator i = _assets.find (normalise_id (id));
+	if (i == _assets.end ()) {
+		return shared_ptr<Asset> ();
+	}
+
+	return i->second;
+}
+
+/** Add an asset which has not yet been created.  It will only be found by
+ *  find_loader(), and only if there is no asset with the same ID.
+ *  @param id Asset ID.
+ *  @param loader Function to create the asset.
+ */
+void
+AssetIndex::add_loader (string id, Loader loader)
+{
+	_loaders.insert (std::make_pair (normalise_id (id), loader));
+}
+
+/** @param id ID to look for.
+ *  @return a function to create the asset with that ID, or an empty function.
+ */
+AssetIndex::Loader
+AssetIndex::find_loader (string id) const
+{
+	boost::unordered_map<string, Loader>::const_iterator i = _loaders.find (normalise_id (id));
+	if (i == _loaders.end ()) {
+		return Loader ();
+	}
+
+	return i->second;
+}
@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/asset_index.h
+ *  @brief AssetIndex class.
+ */
+
+#ifndef LIBDCP_ASSET_INDEX_H
+#define LIBDCP_ASSET_INDEX_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/unordered_map.hpp>
+#include <list>
+#include <string>
+
+namespace dcp {
+
+class Asset;
+
+/** @class AssetIndex
+ *  @brief A list of assets which can be searched by ID in constant time.
+ *
+ *  IDs are matched in the same way as ids_equal() does.  If more than one asset
+ *  has the same ID, the first one in the list is found.
+ */
+class AssetIndex
+{
+public:
+	/** A function which creates an asset when it is first needed */
+	typedef boost::function<boost::shared_ptr<Asset> ()> Loader;
+
+	explicit AssetIndex (std::list<boost::shared_ptr<Asset> > const & assets);
+
+	boost::shared_ptr<Asset> find (std::string id) const;
+
+	void add_loader (std::string id, Loader loader);
+	Loader find_loader (std::string id) const;
+
+	/** @return the assets in the index which are FontAssets, in their original order */
+	std::list<boost::shared_ptr<Asset> > const & fonts () const {
+		return _fonts;
+	}
+
+private:
+	boost::unordered_map<std::string, boost::shared_ptr<Asset> > _assets;
+	boost::unordered_map<std::string, Loader> _loaders;
+	std::list<boost::shared_ptr<Asset> > _fonts;
+};
+
+}
+
+#endif
@@ -37,9 +37,14 @@
 #include "dcp_assert.h"
 #include "asset.h"
 #include "crypto_context.h"
+#include "frame_pool.h"
 #include <asdcp/AS_DCP.h>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/exception_ptr.hpp>
+#include <deque>
 
 namespace dcp {
 
@@ -49,6 +54,12 @@ class AssetReader : public boost::noncopyable
 public:
 	explicit AssetReader (Asset const * asset, boost::optional<Key> key, Standard standard)
 		: _crypto_context (new DecryptionContext (key, standard))
+		, _read_ahead (0)
+		, _read_ahead_thread (0)
+		, _read_ahead_next (0)
+		, _read_ahead_generation (0)
+		, _read_ahead_paused (false)
+		, _read_ahead_stop (false)
 	{
 		_reader = new R ();
 		DCP_ASSERT (asset->file ());
@@ -61,17 +72,234 @@ public:
 
 	~AssetReader ()
 	{
+		stop_read_ahead ();
 		delete _reader;
 	}
 
+	/** Turn pooling of frames on or off.  When it is on, frames returned by get_frame()
+	 *  go back to a pool owned by this reader when the last shared_ptr to them is dropped,
+	 *  and are read into again by later calls to get_frame(); their buffers are allocated
+	 *  at a size that the MXF's index says is big enough for any frame.
+	 *  This must not be called while read-ahead is on.
+	 *  @param pooled true to pool frames.
+	 */
+	void set_pooled (bool pooled)
+	{
+		DCP_ASSERT (!_read_ahead_thread);
+
+		if (!pooled) {
+			_pool.reset ();
+		} else if (!_pool) {
+			_pool.reset (new FramePool<F> (frame_buffer_size (_reader)));
+		}
+	}
+
+	/** Turn read-ahead on or off.  When it is on a background thread reads (and decrypts)
+	 *  frames following the last one asked for, keeping up to @ref frames of them ready
+	 *  for subsequent calls to get_frame().  Asking for a frame other than the next one
+	 *  is treated as a seek(), so random access still works, just less quickly.
+	 *  @param frames Number of frames to read ahead, or 0 to turn read-ahead off.
+	 */
+	void set_read_ahead (int frames)
+	{
+		DCP_ASSERT (frames >= 0);
+
+		stop_read_ahead ();
+
+		_read_ahead = frames;
+		if (_read_ahead > 0) {
+			_read_ahead_stop = false;
+			_read_ahead_paused = false;
+			_read_ahead_thread = new boost::thread (boost::bind (&AssetReader::read_ahead_thread, this));
+		}
+	}
+
+	/** Tell the read-ahead thread that the next frame we want is @ref n, discarding
+	 *  anything that it has read or is reading for other frames.  Does nothing if
+	 *  read-ahead is off.
+	 *  @param n Frame index.
+	 */
+	void seek (int n) const
+	{
+		boost::mutex::scoped_lock lm (_read_ahead_mutex);
+		if (_read_ahead_thread) {
+			seek_locked (n);
+		}
+	}
+
 	boost::shared_ptr<const F> get_frame (int n) const
 	{
-		return boost::shared_ptr<const F> (new F (_reader, n, _crypto_context));
+		if (!_read_ahead_thread) {
+			return make_frame (n);
+		}
+
+		boost::mutex::scoped_lock lm (_read_ahead_mutex);
+
+		/* Drop any frames that were read ahead but have been skipped over */
+		while (!_read_ahead_queue.empty() && _read_ahead_queue.front().n < n && n < _read_ahead_next) {
+			_read_ahead_queue.pop_front ();
+		}
+
+		if (_read_ahead_queue.empty() ? (n != _read_ahead_next || _read_ahead_paused) : n != _read_ahead_queue.front().n) {
+			seek_locked (n);
+		}
+
+		while (_read_ahead_queue.empty ()) {
+			_read_ahead_condition.wait (lm);
+		}
+
+		ReadAhead const r = _read_ahead_queue.front ();
+		_read_ahead_queue.pop_front ();
+		_read_ahead_condition.notify_all ();
+		lm.unlock ();
+
+		if (r.error) {
+			boost::rethrow_exception (r.error);
+		}
+
+		return r.frame;
+	}
+
+	/** Get a frame, re-using the buffers of a frame that we returned earlier if
+	 *  nobody else is holding on to it.  This avoids allocating (and faulting in)
+	 *  new frame buffers when a caller is stepping through an asset.
+	 *  @param n Frame index.
+	 *  @param previous Frame previously returned by this reader, or 0.  If the caller
+	 *  has the only reference to it, its contents will be overwritten and it will
+	 *  be returned; otherwise (or if read-ahead is on) a new frame is made.
+	 */
+	boost::shared_ptr<const F> get_frame (int n, boost::shared_ptr<const F> const & previous) const
+	{
+		if (!previous || !previous.unique () || _read_ahead_thread) {
+			return get_frame (n);
+		}
+
+		boost::shared_ptr<F> f = boost::const_pointer_cast<F> (previous);
+		f->read (_reader, n, _crypto_context);
+		return f;
 	}
 
 protected:
 	R* _reader;
 	boost::shared_ptr<DecryptionContext> _crypto_context;
+	/** pool of idle frames, or 0 if we are not pooling */
+	boost::shared_ptr<FramePool<F> > _pool;
+
+private:
+	/** Read a frame on the calling thread */
+	boost::shared_ptr<const F> make_frame (int n) const
+	{
+		if (!_pool) {
+			return boost::shared_ptr<const F> (new F (_reader, n, _crypto_context));
+		}
+
+		F* f = _pool->take ();
+		if (f) {
+			try {
+				f->read (_reader, n, _crypto_context);
+			} catch (...) {
+				_pool->give (f);
+				throw;
+			}
+		} else {
+			f = new F (_reader, n, _crypto_context, _pool->buffer_size ());
+		}
+
+		return boost::shared_ptr<const F> (f, typename FramePool<F>::Return (_pool));
+	}
+
+	/** Must be called with _read_ahead_mutex held */
+	void seek_locked (int n) const
+	{
+		_read_ahead_queue.clear ();
+		_read_ahead_next = n;
+		/* This makes the thread throw away anything that it is reading now */
+		++_read_ahead_generation;
+		_read_ahead_paused = false;
+		_read_ahead_condition.notify_all ();
+	}
+
+	void stop_read_ahead ()
+	{
+		if (!_read_ahead_thread) {
+			return;
+		}
+
+		{
+			boost::mutex::scoped_lock lm (_read_ahead_mutex);
+			_read_ahead_stop = true;
+			_read_ahead_condition.notify_all ();
+		}
+
+		_read_ahead_thread->join ();
+		delete _read_ahead_thread;
+		_read_ahead_thread = 0;
+		_read_ahead_queue.clear ();
+	}
+
+	void read_ahead_thread ()
+	{
+		boost::mutex::scoped_lock lm (_read_ahead_mutex);
+
+		while (true) {
+			while (!_read_ahead_stop && (_read_ahead_paused || int (_read_ahead_queue.size()) >= _read_ahead)) {
+				_read_ahead_condition.wait (lm);
+			}
+
+			if (_read_ahead_stop) {
+				return;
+			}
+
+			ReadAhead r;
+			r.n = _read_ahead_next;
+			int const generation = _read_ahead_generation;
+
+			lm.unlock ();
+			try {
+				r.frame = make_frame (r.n);
+			} catch (...) {
+				r.error = boost::current_exception ();
+			}
+			lm.lock ();
+
+			if (generation != _read_ahead_generation) {
+				/* There was a seek while we were reading */
+				continue;
+			}
+
+			_read_ahead_queue.push_back (r);
+			if (r.error) {
+				/* Probably the end of the asset; wait for a seek before trying again */
+				_read_ahead_paused = true;
+			} else {
+				++_read_ahead_next;
+			}
+			_read_ahead_condition.notify_all ();
+		}
+	}
+
+	/** A frame that has been read ahead, or the error that we got trying to read it */
+	struct ReadAhead
+	{
+		int n;
+		boost::shared_ptr<const F> frame;
+		boost::exception_ptr error;
+	};
+
+	/** maximum number of frames to read ahead, or 0 */
+	int _read_ahead;
+	boost::thread* _read_ahead_thread;
+	/** mutex for everything below */
+	mutable boost::mutex _read_ahead_mutex;
+	mutable boost::condition_variable _read_ahead_condition;
+	mutable std::deque<ReadAhead> _read_ahead_queue;
+	/** frame that the read-ahead thread will read next */
+	mutable int _read_ahead_next;
+	/** incremented on each seek so that the thread can spot frames that are no longer wanted */
+	mutable int _read_ahead_generation;
+	/** true if the thread should wait for a seek before reading any more */
+	mutable bool _read_ahead_paused;
+	bool _read_ahead_stop;
 };
 
 }
@@ -0,0 +1,101 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/colour_conversion_plan.cc
+ *  @brief ColourConversionPlan class.
+ */
+
+#include "colour_conversion_plan.h"
+#include "colour_conversion.h"
+#include "rgb_xyz_simd.h"
+
+using boost::shared_ptr;
+using namespace dcp;
+
+ColourConversionPlan::ColourConversionPlan (ColourConversion const & conversion)
+	: _rgb_to_xyz (new simd::RGBToXYZTables (conversion))
+	, _xyz_to_rgb (new simd::XYZToRGBTables (conversion, simd::XYZToRGBTables::RGB48))
+	, _xyz_to_rgba (new simd::XYZToRGBTables (conversion, simd::XYZToRGBTables::BGRA))
+{
+
+}
+
+ColourConversionPlan const &
+ColourConversionPlan::srgb_to_xyz ()
+{
+	static ColourConversionPlan* p = new ColourConversionPlan (ColourConversion::srgb_to_xyz ());
+	return *p;
+}
+
+ColourConversionPlan const &
+ColourConversionPlan::rec601_to_xyz ()
+{
+	static ColourConversionPlan* p = new ColourConversionPlan (ColourConversion::rec601_to_xyz ());
+	return *p;
+}
+
+ColourConversionPlan const &
+ColourConversionPlan::rec709_to_xyz ()
+{
+	static ColourConversionPlan* p = new ColourConversionPlan (ColourConversion::rec709_to_xyz ());
+	return *p;
+}
+
+ColourConversionPlan const &
+ColourConversionPlan::p3_to_xyz ()
+{
+	static ColourConversionPlan* p = new ColourConversionPlan (ColourConversion::p3_to_xyz ());
+	return *p;
+}
+
+ColourConversionPlan const &
+ColourConversionPlan::rec1886_to_xyz ()
+{
+	static ColourConversionPlan* p = new ColourConversionPlan (ColourConversion::rec1886_to_xyz ());
+	return *p;
+}
+
+ColourConversionPlan const &
+ColourConversionPlan::rec2020_to_xyz ()
+{
+	static ColourConversionPlan* p = new ColourConversionPlan (ColourConversion::rec2020_to_xyz ());
+	return *p;
+}
+
+ColourConversionPlan const &
+ColourConversionPlan::s_gamut3_to_xyz ()
+{
+	static ColourConversionPlan* p = new ColourConversionPlan (ColourConversion::s_gamut3_to_xyz ());
+	return *p;
+}
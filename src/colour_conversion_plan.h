@@ -0,0 +1,143 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/colour_conversion_plan.h
+ *  @brief ColourConversionPlan class, and the RGB / XYZ conversion tables that it holds.
+ */
+
+#ifndef LIBDCP_COLOUR_CONVERSION_PLAN_H
+#define LIBDCP_COLOUR_CONVERSION_PLAN_H
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <stdint.h>
+
+namespace dcp {
+
+class ColourConversion;
+
+namespace simd {
+
+/** @class XYZToRGBTables
+ *  @brief Everything that the XYZ to RGB row kernels need from a ColourConversion,
+ *  prepared once per image rather than once per pixel.
+ */
+class XYZToRGBTables
+{
+public:
+	enum Output {
+		/** 16-bit RGB, as written by xyz_to_rgb */
+		RGB48,
+		/** 8-bit BGRA, as written by xyz_to_rgba */
+		BGRA
+	};
+
+	XYZToRGBTables (ColourConversion const & conversion, Output output);
+
+	/** 4096-entry input LUT, with the DCI companding already removed */
+	std::vector<double> lut_in;
+	/** XYZ to RGB matrix, row-major */
+	double matrix[9];
+	/** 65536-entry output LUT giving 16-bit values, with one entry of padding
+	 *  so that 32-bit gathers from the last entry stay in bounds; only filled for RGB48.
+	 */
+	std::vector<uint16_t> lut_out_16;
+	/** 65536-entry output LUT giving 8-bit values, with three entries of padding
+	 *  so that 32-bit gathers from the last entry stay in bounds; only filled for BGRA.
+	 */
+	std::vector<uint8_t> lut_out_8;
+};
+
+/** @class RGBToXYZTables
+ *  @brief Everything that rgb_to_xyz needs from a ColourConversion, prepared once per image
+ *  rather than once per pixel.
+ */
+class RGBToXYZTables
+{
+public:
+	explicit RGBToXYZTables (ColourConversion const & conversion);
+
+	/** 4096-entry input LUT */
+	std::vector<double> lut_in;
+	/** Product of the RGB to XYZ matrix, the Bradford transform and the DCI companding, row-major */
+	double matrix[9];
+	/** 65536-entry output LUT giving 12-bit values */
+	std::vector<uint16_t> lut_out;
+};
+
+}
+
+/** @class ColourConversionPlan
+ *  @brief The look-up tables and matrices needed to convert between RGB and XYZ using
+ *  a particular ColourConversion.
+ *
+ *  These are otherwise re-built from the ColourConversion for every call to rgb_to_xyz,
+ *  xyz_to_rgb or xyz_to_rgba.  A plan is built once and never changes, so one plan can
+ *  be used for any number of frames, from any number of threads.
+ */
+class ColourConversionPlan : public boost::noncopyable
+{
+public:
+	explicit ColourConversionPlan (ColourConversion const & conversion);
+
+	simd::RGBToXYZTables const & rgb_to_xyz () const {
+		return *_rgb_to_xyz;
+	}
+
+	simd::XYZToRGBTables const & xyz_to_rgb () const {
+		return *_xyz_to_rgb;
+	}
+
+	simd::XYZToRGBTables const & xyz_to_rgba () const {
+		return *_xyz_to_rgba;
+	}
+
+	static ColourConversionPlan const & srgb_to_xyz ();
+	static ColourConversionPlan const & rec601_to_xyz ();
+	static ColourConversionPlan const & rec709_to_xyz ();
+	static ColourConversionPlan const & p3_to_xyz ();
+	static ColourConversionPlan const & rec1886_to_xyz ();
+	static ColourConversionPlan const & rec2020_to_xyz ();
+	static ColourConversionPlan const & s_gamut3_to_xyz ();
+
+private:
+	boost::shared_ptr<const simd::RGBToXYZTables> _rgb_to_xyz;
+	boost::shared_ptr<const simd::XYZToRGBTables> _xyz_to_rgb;
+	boost::shared_ptr<const simd::XYZToRGBTables> _xyz_to_rgba;
+};
+
+}
+
+#endif
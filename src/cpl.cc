@@ -45,6 +45,7 @@
 #include "local_time.h"
 #include "dcp_assert.h"
 #include "compose.hpp"
+#include "asset_index.h"
 #include <libxml/parser.h>
 #include <libxml++/libxml++.h>
 #include <boost/foreach.hpp>
@@ -261,6 +262,12 @@ CPL::add (DecryptedKDM const & kdm)
 
 void
 CPL::resolve_refs (list<shared_ptr<Asset> > assets)
+{
+	resolve_refs (AssetIndex (assets));
+}
+
+void
+CPL::resolve_refs (AssetIndex const & assets)
 {
 	BOOST_FOREACH (shared_ptr<Reel> i, _reels) {
 		i->resolve_refs (assets);
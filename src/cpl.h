@@ -53,6 +53,7 @@ namespace dcp {
 
 class ReelAsset;
 class Reel;
+class AssetIndex;
 class XMLMetadata;
 class MXFMetadata;
 class CertificateChain;
@@ -133,6 +134,7 @@ public:
 		) const;
 
 	void resolve_refs (std::list<boost::shared_ptr<Asset> >);
+	void resolve_refs (AssetIndex const & assets);
 
 	int64_t duration () const;
 
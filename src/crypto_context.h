@@ -40,6 +40,7 @@
 #include <asdcp/AS_DCP.h>
 #include <asdcp/KM_prng.h>
 #include <boost/optional.hpp>
+#include <boost/throw_exception.hpp>
 
 namespace dcp {
 
@@ -57,14 +58,14 @@ public:
 
 		_context = new T;
 		if (ASDCP_FAILURE (_context->InitKey (key->value ()))) {
-			throw MiscError ("could not set up crypto context");
+			boost::throw_exception (MiscError ("could not set up crypto context"));
 		}
 
 		uint8_t cbc_buffer[ASDCP::CBC_BLOCK_SIZE];
 
 		Kumu::FortunaRNG rng;
 		if (ASDCP_FAILURE (_context->SetIVec (rng.FillRandom (cbc_buffer, ASDCP::CBC_BLOCK_SIZE)))) {
-			throw MiscError ("could not set up CBC initialization vector");
+			boost::throw_exception (MiscError ("could not set up CBC initialization vector"));
 		}
 
 		_hmac = new ASDCP::HMACContext;
@@ -77,7 +78,7 @@ public:
 		}
 
 		if (ASDCP_FAILURE (_hmac->InitKey (key->value(), type))) {
-			throw MiscError ("could not set up HMAC context");
+			boost::throw_exception (MiscError ("could not set up HMAC context"));
 		}
 	}
 
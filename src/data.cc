@@ -36,6 +36,7 @@
 #include "exceptions.h"
 #include <cstdio>
 #include <cerrno>
+#include <boost/throw_exception.hpp>
 
 using boost::shared_array;
 using namespace dcp;
@@ -74,13 +75,13 @@ Data::Data (boost::filesystem::path file)
 
 	FILE* f = fopen_boost (file, "rb");
 	if (!f) {
-		throw FileError ("could not open file for reading", file, errno);
+		boost::throw_exception (FileError ("could not open file for reading", file, errno));
 	}
 
 	size_t const r = fread (_data.get(), 1, _size, f);
 	if (r != size_t (_size)) {
 		fclose (f);
-		throw FileError ("could not read from file", file, errno);
+		boost::throw_exception (FileError ("could not read from file", file, errno));
 	}
 
 	fclose (f);
@@ -91,12 +92,12 @@ Data::write (boost::filesystem::path file) const
 {
 	FILE* f = fopen_boost (file, "wb");
 	if (!f) {
-		throw FileError ("could not write to file", file, errno);
+		boost::throw_exception (FileError ("could not write to file", file, errno));
 	}
 	size_t const r = fwrite (_data.get(), 1, _size, f);
 	if (r != size_t (_size)) {
 		fclose (f);
-		throw FileError ("could not write to file", file, errno);
+		boost::throw_exception (FileError ("could not write to file", file, errno));
 	}
 	fclose (f);
 }
@@ -57,13 +57,20 @@
 #include "reel_asset.h"
 #include "font_asset.h"
 #include "pkl.h"
+#include "asset_index.h"
 #include <asdcp/AS_DCP.h>
 #include <xmlsec/xmldsig.h>
 #include <xmlsec/app.h>
 #include <libxml++/libxml++.h>
+#include <libxml/xmlreader.h>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/throw_exception.hpp>
 
 using std::string;
 using std::list;
@@ -71,11 +78,13 @@ using std::vector;
 using std::cout;
 using std::make_pair;
 using std::map;
+using std::min;
 using std::cerr;
 using std::exception;
 using boost::shared_ptr;
 using boost::dynamic_pointer_cast;
 using boost::optional;
+using boost::function;
 using boost::algorithm::starts_with;
 using namespace dcp;
 
@@ -103,12 +112,242 @@ survivable_error (bool keep_going, dcp::DCP::ReadErrors* errors, T const & e)
 			errors->push_back (shared_ptr<T> (new T (e)));
 		}
 	} else {
-		throw e;
+		boost::throw_exception (e);
+	}
+}
+
+/** @return the local name of the root node of an XML file, reading no more of it than necessary */
+static string
+xml_root_name (boost::filesystem::path file)
+{
+	xmlTextReaderPtr reader = xmlReaderForFile (file.string().c_str(), 0, 0);
+	if (!reader) {
+		boost::throw_exception (DCPReadError (String::compose ("XML error in %1", file.string()), "could not open file"));
+	}
+
+	string name;
+	while (xmlTextReaderRead (reader) == 1) {
+		if (xmlTextReaderNodeType (reader) == XML_READER_TYPE_ELEMENT) {
+			xmlChar const * n = xmlTextReaderConstLocalName (reader);
+			if (n) {
+				name = reinterpret_cast<char const *> (n);
+			}
+			break;
+		}
+	}
+
+	xmlFreeTextReader (reader);
+
+	if (name.empty ()) {
+		boost::throw_exception (DCPReadError (String::compose ("XML error in %1", file.string()), "could not find root node"));
+	}
+
+	return name;
+}
+
+/** Open an MXF asset, working out what sort of asset it is from its essence type */
+static shared_ptr<Asset>
+open_mxf (boost::filesystem::path path, bool ignore_incorrect_picture_mxf_type)
+{
+	/* XXX: asdcplib does not appear to support discovery of read MXFs standard
+	   (Interop / SMPTE)
+	*/
+
+	ASDCP::EssenceType_t type;
+	if (ASDCP::EssenceType (path.string().c_str(), type) != ASDCP::RESULT_OK) {
+		boost::throw_exception (DCPReadError ("Could not find essence type"));
+	}
+	switch (type) {
+		case ASDCP::ESS_UNKNOWN:
+		case ASDCP::ESS_MPEG2_VES:
+			boost::throw_exception (DCPReadError ("MPEG2 video essences are not supported"));
+		case ASDCP::ESS_JPEG_2000:
+			try {
+				return shared_ptr<Asset> (new MonoPictureAsset (path));
+			} catch (dcp::MXFFileError& e) {
+				if (ignore_incorrect_picture_mxf_type && e.number() == ASDCP::RESULT_SFORMAT) {
+					/* Tried to load it as mono but the error says it's stereo; try that instead */
+					return shared_ptr<Asset> (new StereoPictureAsset (path));
+				}
+				throw;
+			}
+		case ASDCP::ESS_PCM_24b_48k:
+		case ASDCP::ESS_PCM_24b_96k:
+			return shared_ptr<Asset> (new SoundAsset (path));
+		case ASDCP::ESS_JPEG_2000_S:
+			return shared_ptr<Asset> (new StereoPictureAsset (path));
+		case ASDCP::ESS_TIMED_TEXT:
+			return shared_ptr<Asset> (new SMPTESubtitleAsset (path));
+	        case ASDCP::ESS_DCDATA_DOLBY_ATMOS:
+			return shared_ptr<Asset> (new AtmosAsset (path));
+		default:
+			boost::throw_exception (DCPReadError (String::compose ("Unknown MXF essence type %1 in %2", int(type), path.string())));
+	}
+}
+
+/** An MXF asset which will be opened the first time that it is needed */
+class LazyMXF : public boost::noncopyable
+{
+public:
+	LazyMXF (boost::filesystem::path path, bool ignore_incorrect_picture_mxf_type)
+		: _path (path)
+		, _ignore_incorrect_picture_mxf_type (ignore_incorrect_picture_mxf_type)
+	{}
+
+	shared_ptr<Asset> get () {
+		boost::mutex::scoped_lock lm (_mutex);
+		if (!_asset) {
+			_asset = open_mxf (_path, _ignore_incorrect_picture_mxf_type);
+		}
+		return _asset;
+	}
+
+private:
+	boost::filesystem::path _path;
+	bool _ignore_incorrect_picture_mxf_type;
+	/** mutex for _asset */
+	boost::mutex _mutex;
+	shared_ptr<Asset> _asset;
+};
+
+/** An asset from a DCP's asset map, and the result of reading it */
+struct AssetMapEntry
+{
+	AssetMapEntry (string id_, boost::filesystem::path path_)
+		: id (id_)
+		, path (path_)
+		, done (false)
+	{}
+
+	string id;
+	boost::filesystem::path path;
+	/** true if we have tried to read this asset */
+	bool done;
+	shared_ptr<CPL> cpl;
+	shared_ptr<Asset> asset;
+	/** function to load the asset, if it is to be opened later */
+	AssetIndex::Loader loader;
+	/** errors that were survived while reading this asset on another thread */
+	DCP::ReadErrors errors;
+	/** error that stopped us reading this asset */
+	boost::exception_ptr error;
+};
+
+/** State shared between the threads of DCP::read */
+struct ReadJobs
+{
+	ReadJobs (
+		vector<AssetMapEntry>& entries_, PKL const & pkl_, Standard standard_, bool keep_going_, bool ignore_incorrect_picture_mxf_type_, bool lazy_
+		)
+		: entries (entries_)
+		, pkl (pkl_)
+		, standard (standard_)
+		, keep_going (keep_going_)
+		, ignore_incorrect_picture_mxf_type (ignore_incorrect_picture_mxf_type_)
+		, lazy (lazy_)
+		, next (0)
+		, failed (false)
+	{}
+
+	vector<AssetMapEntry>& entries;
+	PKL const & pkl;
+	Standard standard;
+	bool keep_going;
+	bool ignore_incorrect_picture_mxf_type;
+	/** true to open MXFs only when they are first needed */
+	bool lazy;
+
+	/** mutex for next and failed */
+	boost::mutex mutex;
+	/** index of the next entry to read */
+	size_t next;
+	/** true if reading some entry has failed */
+	bool failed;
+};
+
+/** Read one asset from the asset map.
+ *  @param errors List to add survivable errors to.
+ */
+static void
+read_entry (ReadJobs const * jobs, AssetMapEntry& entry, DCP::ReadErrors* errors)
+{
+	boost::filesystem::path const & path = entry.path;
+	Standard const standard = jobs->standard;
+	bool const keep_going = jobs->keep_going;
+
+	if (!boost::filesystem::exists (path)) {
+		survivable_error (keep_going, errors, MissingAssetError (path));
+		return;
+	}
+
+	string const pkl_type = jobs->pkl.type (entry.id);
+
+	if (pkl_type == CPL::static_pkl_type(standard) || pkl_type == InteropSubtitleAsset::static_pkl_type(standard)) {
+		try {
+			string const root = xml_root_name (path);
+
+			if (root == "CompositionPlaylist") {
+				shared_ptr<CPL> cpl (new CPL (path));
+				if (cpl->standard() && cpl->standard().get() != standard) {
+					survivable_error (keep_going, errors, MismatchedStandardError ());
+				}
+				entry.cpl = cpl;
+			} else if (root == "DCSubtitle") {
+				if (standard == SMPTE) {
+					survivable_error (keep_going, errors, MismatchedStandardError ());
+				}
+				entry.asset.reset (new InteropSubtitleAsset (path));
+			}
+		} catch (xmlpp::exception& e) {
+			boost::throw_exception (DCPReadError (String::compose("XML error in %1", path.string()), e.what()));
+		}
+	} else if (
+		pkl_type == PictureAsset::static_pkl_type(standard) ||
+		pkl_type == SoundAsset::static_pkl_type(standard) ||
+		pkl_type == AtmosAsset::static_pkl_type(standard) ||
+		pkl_type == SMPTESubtitleAsset::static_pkl_type(standard)
+		) {
+
+		if (jobs->lazy) {
+			shared_ptr<LazyMXF> lazy (new LazyMXF (path, jobs->ignore_incorrect_picture_mxf_type));
+			entry.loader = boost::bind (&LazyMXF::get, lazy);
+		} else {
+			entry.asset = open_mxf (path, jobs->ignore_incorrect_picture_mxf_type);
+		}
+	} else if (pkl_type == FontAsset::static_pkl_type(standard)) {
+		entry.asset.reset (new FontAsset (entry.id, path));
+	} else if (pkl_type == "image/png") {
+		/* It's an Interop PNG subtitle; let it go */
+	} else {
+		boost::throw_exception (DCPReadError (String::compose("Unknown asset type %1 in PKL", pkl_type)));
+	}
+}
+
+static void
+read_thread (ReadJobs* jobs)
+{
+	boost::mutex::scoped_lock lm (jobs->mutex);
+
+	while (jobs->next < jobs->entries.size() && !jobs->failed) {
+		AssetMapEntry& entry = jobs->entries[jobs->next++];
+		lm.unlock ();
+
+		try {
+			read_entry (jobs, entry, &entry.errors);
+		} catch (...) {
+			entry.error = boost::current_exception ();
+		}
+
+		lm.lock ();
+		entry.done = true;
+		if (entry.error) {
+			jobs->failed = true;
+		}
 	}
 }
 
 void
-DCP::read (bool keep_going, ReadErrors* errors, bool ignore_incorrect_picture_mxf_type)
+DCP::read (bool keep_going, ReadErrors* errors, bool ignore_incorrect_picture_mxf_type, int threads, bool lazy)
 {
 	/* Read the ASSETMAP and PKL */
 
@@ -172,111 +411,75 @@ DCP::read (bool keep_going, ReadErrors* errors, bool ignore_incorrect_picture_mx
 
 	/* Read all the assets from the asset map */
 
-	/* Make a list of non-CPL/PKL assets so that we can resolve the references
-	   from the CPLs.
-	*/
-	list<shared_ptr<Asset> > other_assets;
-
+	vector<AssetMapEntry> entries;
+	_asset_paths.clear ();
 	for (map<string, boost::filesystem::path>::const_iterator i = paths.begin(); i != paths.end(); ++i) {
-		boost::filesystem::path path = _directory / i->second;
+		entries.push_back (AssetMapEntry (i->first, _directory / i->second));
+		_asset_paths[i->first] = _directory / i->second;
+	}
 
-		if (!boost::filesystem::exists (path)) {
-			survivable_error (keep_going, errors, MissingAssetError (path));
-			continue;
+	ReadJobs jobs (entries, *_pkl, *_standard, keep_going, ignore_incorrect_picture_mxf_type, lazy);
+	threads = min (threads, int (entries.size ()));
+	if (threads > 1) {
+		/* libxml2 must be initialised before it is used on more than one thread */
+		xmlInitParser ();
+		boost::thread_group group;
+		for (int i = 0; i < threads; ++i) {
+			group.create_thread (boost::bind (&read_thread, &jobs));
 		}
+		group.join_all ();
+	} else {
+		/* Read on this thread, letting any exception go straight to the caller */
+		BOOST_FOREACH (AssetMapEntry& i, entries) {
+			read_entry (&jobs, i, errors);
+			i.done = true;
+		}
+	}
 
-		string const pkl_type = _pkl->type(i->first);
-
-		if (pkl_type == CPL::static_pkl_type(*_standard) || pkl_type == InteropSubtitleAsset::static_pkl_type(*_standard)) {
-			xmlpp::DomParser* p = new xmlpp::DomParser;
-			try {
-				p->parse_file (path.string());
-			} catch (std::exception& e) {
-				delete p;
-				throw DCPReadError(String::compose("XML error in %1", path.string()), e.what());
-			}
-
-			string const root = p->get_document()->get_root_node()->get_name ();
-			delete p;
+	/* Make a list of non-CPL/PKL assets so that we can resolve the references
+	   from the CPLs.  Going through the entries in order, and stopping at the first
+	   one which failed, gives the same result as reading them one by one.
+	*/
+	list<shared_ptr<Asset> > other_assets;
+	list<AssetMapEntry const *> lazy_assets;
 
-			if (root == "CompositionPlaylist") {
-				shared_ptr<CPL> cpl (new CPL (path));
-				if (_standard && cpl->standard() && cpl->standard().get() != _standard.get()) {
-					survivable_error (keep_going, errors, MismatchedStandardError ());
-				}
-				_cpls.push_back (cpl);
-			} else if (root == "DCSubtitle") {
-				if (_standard && _standard.get() == SMPTE) {
-					survivable_error (keep_going, errors, MismatchedStandardError ());
-				}
-				other_assets.push_back (shared_ptr<InteropSubtitleAsset> (new InteropSubtitleAsset (path)));
-			}
-		} else if (
-			pkl_type == PictureAsset::static_pkl_type(*_standard) ||
-			pkl_type == SoundAsset::static_pkl_type(*_standard) ||
-			pkl_type == AtmosAsset::static_pkl_type(*_standard) ||
-			pkl_type == SMPTESubtitleAsset::static_pkl_type(*_standard)
-			) {
-
-			/* XXX: asdcplib does not appear to support discovery of read MXFs standard
-			   (Interop / SMPTE)
-			*/
-
-			ASDCP::EssenceType_t type;
-			if (ASDCP::EssenceType (path.string().c_str(), type) != ASDCP::RESULT_OK) {
-				throw DCPReadError ("Could not find essence type");
-			}
-			switch (type) {
-				case ASDCP::ESS_UNKNOWN:
-				case ASDCP::ESS_MPEG2_VES:
-					throw DCPReadError ("MPEG2 video essences are not supported");
-				case ASDCP::ESS_JPEG_2000:
-					try {
-						other_assets.push_back (shared_ptr<MonoPictureAsset> (new MonoPictureAsset (path)));
-					} catch (dcp::MXFFileError& e) {
-						if (ignore_incorrect_picture_mxf_type && e.number() == ASDCP::RESULT_SFORMAT) {
-							/* Tried to load it as mono but the error says it's stereo; try that instead */
-							other_assets.push_back (shared_ptr<StereoPictureAsset> (new StereoPictureAsset (path)));
-						} else {
-							throw;
-						}
-					}
-					break;
-				case ASDCP::ESS_PCM_24b_48k:
-				case ASDCP::ESS_PCM_24b_96k:
-					other_assets.push_back (shared_ptr<SoundAsset> (new SoundAsset (path)));
-					break;
-				case ASDCP::ESS_JPEG_2000_S:
-					other_assets.push_back (shared_ptr<StereoPictureAsset> (new StereoPictureAsset (path)));
-					break;
-				case ASDCP::ESS_TIMED_TEXT:
-					other_assets.push_back (shared_ptr<SMPTESubtitleAsset> (new SMPTESubtitleAsset (path)));
-					break;
-			        case ASDCP::ESS_DCDATA_DOLBY_ATMOS:
-					other_assets.push_back (shared_ptr<AtmosAsset> (new AtmosAsset (path)));
-					break;
-				default:
-					throw DCPReadError (String::compose ("Unknown MXF essence type %1 in %2", int(type), path.string()));
-			}
-		} else if (pkl_type == FontAsset::static_pkl_type(*_standard)) {
-			other_assets.push_back (shared_ptr<FontAsset> (new FontAsset (i->first, path)));
-		} else if (pkl_type == "image/png") {
-			/* It's an Interop PNG subtitle; let it go */
-		} else {
-			throw DCPReadError (String::compose("Unknown asset type %1 in PKL", pkl_type));
+	BOOST_FOREACH (AssetMapEntry const & i, entries) {
+		if (!i.done) {
+			/* We stopped because of an error in an earlier entry */
+			break;
+		}
+		if (errors) {
+			errors->insert (errors->end(), i.errors.begin(), i.errors.end());
+		}
+		if (i.error) {
+			boost::rethrow_exception (i.error);
+		}
+		if (i.cpl) {
+			_cpls.push_back (i.cpl);
+		}
+		if (i.asset) {
+			other_assets.push_back (i.asset);
+		}
+		if (i.loader) {
+			lazy_assets.push_back (&i);
 		}
 	}
 
+	AssetIndex index (other_assets);
+	BOOST_FOREACH (AssetMapEntry const * i, lazy_assets) {
+		index.add_loader (i->id, i->loader);
+	}
 	BOOST_FOREACH (shared_ptr<CPL> i, cpls ()) {
-		i->resolve_refs (other_assets);
+		i->resolve_refs (index);
 	}
 }
 
 void
 DCP::resolve_refs (list<shared_ptr<Asset> > assets)
 {
+	AssetIndex const index (assets);
 	BOOST_FOREACH (shared_ptr<CPL> i, cpls ()) {
-		i->resolve_refs (assets);
+		i->resolve_refs (index);
 	}
 }
 
@@ -453,13 +656,17 @@ DCP::write_assetmap (Standard standard, string pkl_uuid, boost::filesystem::path
  *  @param standand INTEROP or SMPTE.
  *  @param metadata Metadata to use for PKL and asset map files.
  *  @param signer Signer to use, or 0.
+ *  @param threads Number of assets to hash at the same time when making the PKL.
+ *  @param progress Optional function to report progress of the asset hashing, from 0 to 1.
  */
 void
 DCP::write_xml (
 	Standard standard,
 	XMLMetadata metadata,
 	shared_ptr<const CertificateChain> signer,
-	NameFormat name_format
+	NameFormat name_format,
+	int threads,
+	function<void (float)> progress
 	)
 {
 	BOOST_FOREACH (shared_ptr<CPL> i, cpls ()) {
@@ -469,6 +676,18 @@ DCP::write_xml (
 	}
 
 	if (!_pkl) {
+		/* Hash the assets that are in this DCP (rather than referenced from elsewhere)
+		   in parallel; add_to_pkl will then use the hashes that this finds.
+		*/
+		boost::filesystem::path const root = boost::filesystem::canonical (_directory);
+		list<shared_ptr<Asset> > to_hash;
+		BOOST_FOREACH (shared_ptr<Asset> i, assets ()) {
+			if (i->file() && relative_to_root (root, boost::filesystem::canonical (i->file().get()))) {
+				to_hash.push_back (i);
+			}
+		}
+		hash_assets (to_hash, threads, progress);
+
 		_pkl.reset (new PKL (standard, metadata.annotation_text, metadata.issue_date, metadata.issuer, metadata.creator));
 		BOOST_FOREACH (shared_ptr<Asset> i, assets ()) {
 			i->add_to_pkl (_pkl, _directory);
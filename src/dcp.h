@@ -43,10 +43,12 @@
 #include "certificate.h"
 #include "metadata.h"
 #include "name_format.h"
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/signals2.hpp>
 #include <string>
 #include <vector>
+#include <map>
 
 namespace xmlpp {
 	class Document;
@@ -91,8 +93,18 @@ public:
 	 *  @param ignore_incorrect_picture_mxf_type true to try loading MXF files marked as monoscopic
 	 *  as stereoscopic if the monoscopic load fails; fixes problems some 3D DCPs that (I think)
 	 *  have an incorrect descriptor in their MXF.
+	 *  @param threads Number of threads to use to open the DCP's assets and parse its CPLs.
+	 *  @param lazy true to open MXF assets only when something first asks a CPL's reel assets for them,
+	 *  rather than now.  This makes reading much quicker if only the CPLs' metadata is needed,
+	 *  but means that errors in the MXFs will not be found until they are used.
 	 */
-	void read (bool keep_going = false, ReadErrors* errors = 0, bool ignore_incorrect_picture_mxf_type = false);
+	void read (
+		bool keep_going = false,
+		ReadErrors* errors = 0,
+		bool ignore_incorrect_picture_mxf_type = false,
+		int threads = 1,
+		bool lazy = false
+		);
 
 	/** Compare this DCP with another, according to various options.
 	 *  @param other DCP to compare this one to.
@@ -115,7 +127,9 @@ public:
 		Standard standard,
 		XMLMetadata metadata = XMLMetadata (),
 		boost::shared_ptr<const CertificateChain> signer = boost::shared_ptr<const CertificateChain> (),
-		NameFormat name_format = NameFormat("%t")
+		NameFormat name_format = NameFormat("%t"),
+		int threads = 1,
+		boost::function<void (float)> progress = 0
 	);
 
 	void resolve_refs (std::list<boost::shared_ptr<Asset> > assets);
@@ -136,6 +150,13 @@ public:
 		return _pkl;
 	}
 
+	/** @return the full path of each asset (other than the PKL) in the ASSETMAP of a DCP that was
+	 *  read in, indexed by asset ID.
+	 */
+	std::map<std::string, boost::filesystem::path> asset_paths () const {
+		return _asset_paths;
+	}
+
 	static std::vector<boost::filesystem::path> directories_from_files (std::vector<boost::filesystem::path> files);
 
 private:
@@ -156,6 +177,8 @@ private:
 
 	/** Standard of DCP that was read in */
 	boost::optional<Standard> _standard;
+	/** full paths of the assets in the ASSETMAP of a DCP that was read in, indexed by ID */
+	std::map<std::string, boost::filesystem::path> _asset_paths;
 };
 
 }
@@ -32,5 +32,6 @@
 */
 
 #include "exceptions.h"
+#include <boost/throw_exception.hpp>
 
-#define DCP_ASSERT(x) if (!(x)) throw ProgrammingError (__FILE__, __LINE__);
+#define DCP_ASSERT(x) if (!(x)) boost::throw_exception (ProgrammingError (__FILE__, __LINE__));
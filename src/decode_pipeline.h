@@ -0,0 +1,218 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/decode_pipeline.h
+ *  @brief DecodePipeline class and decode_frames method.
+ */
+
+#ifndef LIBDCP_DECODE_PIPELINE_H
+#define LIBDCP_DECODE_PIPELINE_H
+
+#include "asset_reader.h"
+#include "dcp_assert.h"
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/exception_ptr.hpp>
+#include <deque>
+#include <map>
+
+namespace dcp {
+
+/** @class DecodePipeline
+ *  @brief A pool of threads which run a function on frames, keeping the results until they are asked for.
+ *
+ *  Frames are given to the pipeline with add() and the results are collected with get().
+ *  Most callers will want decode_frames() rather than using this directly.
+ */
+template <class F, class T>
+class DecodePipeline : public boost::noncopyable
+{
+public:
+	/** @param decode Function to run on each frame; it is called on one of the pipeline's threads.
+	 *  @param threads Number of threads to use.
+	 */
+	DecodePipeline (boost::function<T (boost::shared_ptr<const F>)> decode, int threads)
+		: _decode (decode)
+		, _stop (false)
+	{
+		DCP_ASSERT (threads > 0);
+		for (int i = 0; i < threads; ++i) {
+			_threads.create_thread (boost::bind (&DecodePipeline::thread, this));
+		}
+	}
+
+	~DecodePipeline ()
+	{
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			_stop = true;
+			_condition.notify_all ();
+		}
+		_threads.join_all ();
+	}
+
+	/** Add a frame to be decoded.
+	 *  @param n Index of the frame.
+	 */
+	void add (int64_t n, boost::shared_ptr<const F> frame)
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_pending.push_back (std::make_pair (n, frame));
+		_condition.notify_all ();
+	}
+
+	/** Wait for a frame that was passed to add() to be decoded, and return the result.
+	 *  If decoding failed the exception that was thrown is rethrown here.
+	 *  @param n Index of the frame.
+	 */
+	T get (int64_t n)
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		typename std::map<int64_t, Result>::iterator i = _done.find (n);
+		while (i == _done.end ()) {
+			_condition.wait (lm);
+			i = _done.find (n);
+		}
+
+		Result const r = i->second;
+		_done.erase (i);
+		lm.unlock ();
+
+		if (r.error) {
+			boost::rethrow_exception (r.error);
+		}
+
+		return r.value;
+	}
+
+private:
+	struct Result
+	{
+		T value;
+		boost::exception_ptr error;
+	};
+
+	void thread ()
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+
+		while (true) {
+			while (!_stop && _pending.empty ()) {
+				_condition.wait (lm);
+			}
+
+			if (_stop) {
+				return;
+			}
+
+			std::pair<int64_t, boost::shared_ptr<const F> > job = _pending.front ();
+			_pending.pop_front ();
+			lm.unlock ();
+
+			Result r;
+			try {
+				r.value = _decode (job.second);
+			} catch (...) {
+				r.error = boost::current_exception ();
+			}
+			/* Drop the frame now, so that if it came from a pool it can be re-used */
+			job.second.reset ();
+
+			lm.lock ();
+			_done[job.first] = r;
+			_condition.notify_all ();
+		}
+	}
+
+	boost::function<T (boost::shared_ptr<const F>)> _decode;
+	boost::thread_group _threads;
+	/** mutex for everything below */
+	boost::mutex _mutex;
+	boost::condition_variable _condition;
+	std::deque<std::pair<int64_t, boost::shared_ptr<const F> > > _pending;
+	std::map<int64_t, Result> _done;
+	bool _stop;
+};
+
+/** Read frames from an asset and decode them on a pool of threads, giving the results
+ *  to a handler in frame order.  Frames are read, and the handler is called, on the
+ *  calling thread.  No more than @ref queue_length frames are read ahead of the one
+ *  that the handler is waiting for, so a slow handler holds up reading and decoding
+ *  rather than letting decoded frames pile up.
+ *
+ *  @param reader Reader for the asset.
+ *  @param from First frame to decode.
+ *  @param to One more than the last frame to decode.
+ *  @param decode Function to decode a frame; it is called on the pipeline's threads, so it
+ *  can also do any other per-frame work which should be done in parallel (e.g. conversion to RGB).
+ *  @param handler Function to call with each frame index and the result of decode().
+ *  @param threads Number of decoding threads.
+ *  @param queue_length Maximum number of frames to have read but not handled, or 0 for twice the number of threads.
+ */
+template <class R, class F, class T>
+void
+decode_frames (
+	boost::shared_ptr<AssetReader<R, F> > reader,
+	int64_t from,
+	int64_t to,
+	boost::function<T (boost::shared_ptr<const F>)> decode,
+	boost::function<void (int64_t, T)> handler,
+	int threads,
+	int queue_length = 0
+	)
+{
+	DCP_ASSERT (from <= to);
+
+	if (queue_length <= 0) {
+		queue_length = threads * 2;
+	}
+
+	DecodePipeline<F, T> pipeline (decode, threads);
+
+	int64_t next_read = from;
+	for (int64_t n = from; n < to; ++n) {
+		while (next_read < to && (next_read - n) < queue_length) {
+			pipeline.add (next_read, reader->get_frame (next_read));
+			++next_read;
+		}
+		handler (n, pipeline.get (n));
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,307 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/encode_pipeline.cc
+ *  @brief EncodePipeline class.
+ */
+
+#include "encode_pipeline.h"
+#include "colour_conversion_plan.h"
+#include "openjpeg_image.h"
+#include "rgb_xyz.h"
+#include "j2k.h"
+#include "dcp_assert.h"
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using boost::shared_ptr;
+using boost::shared_array;
+using boost::optional;
+using boost::function;
+using namespace dcp;
+
+static double
+seconds_since (boost::posix_time::ptime start)
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+}
+
+/** @param writer Writer to give compressed frames to.
+ *  @param bandwidth JPEG2000 bandwidth in bits per second, as for compress_j2k.
+ *  @param frames_per_second Frame rate, as for compress_j2k.
+ *  @param threed true if the asset is stereoscopic, as for compress_j2k.
+ *  @param fourk true if the asset is 4K, as for compress_j2k.
+ *  @param threads Number of threads to convert and compress with.
+ *  @param conversion Conversion to use for RGB frames; only required if encode() will be given RGB.
+ *  @param queue_length Maximum number of frames to have been given to encode() but not yet written,
+ *  or 0 for twice the number of threads.  encode() blocks when there are this many.
+ *  @param written Function to call with the index and FrameInfo of each frame once it has been written;
+ *  it is called from a thread belonging to this pipeline.
+ */
+EncodePipeline::EncodePipeline (
+	shared_ptr<PictureAssetWriter> writer,
+	int bandwidth,
+	int frames_per_second,
+	bool threed,
+	bool fourk,
+	int threads,
+	optional<ColourConversion> conversion,
+	int queue_length,
+	function<void (int64_t, FrameInfo)> written
+	)
+	: _writer (writer)
+	, _bandwidth (bandwidth)
+	, _frames_per_second (frames_per_second)
+	, _threed (threed)
+	, _fourk (fourk)
+	, _queue_length (queue_length > 0 ? queue_length : threads * 2)
+	, _written (written)
+	, _next_index (0)
+	, _next_write (0)
+	, _stop (false)
+	, _finished (false)
+{
+	DCP_ASSERT (threads > 0);
+
+	if (conversion) {
+		_plan.reset (new ColourConversionPlan (*conversion));
+	}
+
+	for (int i = 0; i < threads; ++i) {
+		_threads.create_thread (boost::bind (&EncodePipeline::encode_thread, this));
+	}
+	_threads.create_thread (boost::bind (&EncodePipeline::write_thread, this));
+}
+
+EncodePipeline::~EncodePipeline ()
+{
+	terminate ();
+}
+
+void
+EncodePipeline::terminate ()
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_condition.notify_all ();
+	}
+
+	_threads.join_all ();
+}
+
+/** Must be called with _mutex held */
+void
+EncodePipeline::rethrow () const
+{
+	if (_error) {
+		boost::rethrow_exception (_error);
+	}
+}
+
+/** Add an XYZ frame.  The image's data will be overwritten by the compressor,
+ *  so it must not be used again by the caller.
+ */
+void
+EncodePipeline::encode (shared_ptr<OpenJPEGImage> xyz)
+{
+	Job job;
+	job.xyz = xyz;
+	add (job);
+}
+
+/** Add an RGB frame, which will be converted to XYZ using the conversion that was given to our constructor.
+ *  @param rgb RGB data; packed RGB48LE, as for rgb_to_xyz.  It is copied, so it can be re-used as soon as this returns.
+ *  @param size Size of the frame in pixels.
+ *  @param stride Length of a row of rgb in bytes.
+ */
+void
+EncodePipeline::encode (uint8_t const * rgb, Size size, int stride)
+{
+	DCP_ASSERT (_plan);
+
+	Job job;
+	job.rgb.reset (new uint8_t[size.height * stride]);
+	memcpy (job.rgb.get(), rgb, size.height * stride);
+	job.size = size;
+	job.stride = stride;
+	add (job);
+}
+
+void
+EncodePipeline::add (Job job)
+{
+	boost::posix_time::ptime const start = boost::posix_time::microsec_clock::universal_time ();
+
+	boost::mutex::scoped_lock lm (_mutex);
+	/* Our threads have gone, so nothing would ever take this job */
+	DCP_ASSERT (!_finished);
+
+	while (!_error && (_next_index - _next_write) >= _queue_length) {
+		_condition.wait (lm);
+	}
+	rethrow ();
+
+	_timings.waiting += seconds_since (start);
+
+	job.index = _next_index++;
+	_queue.push_back (job);
+	_condition.notify_all ();
+}
+
+/** Wait for all the frames that have been given to encode() to be written, then stop
+ *  our threads.  If anything went wrong while converting, compressing or writing the
+ *  exception is rethrown here.
+ */
+void
+EncodePipeline::finish ()
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_finished = true;
+		while (!_error && _next_write < _next_index) {
+			_condition.wait (lm);
+		}
+	}
+
+	terminate ();
+
+	boost::mutex::scoped_lock lm (_mutex);
+	rethrow ();
+}
+
+EncodeTimings
+EncodePipeline::timings () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _timings;
+}
+
+void
+EncodePipeline::encode_thread ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	while (true) {
+		while (!_stop && _queue.empty ()) {
+			_condition.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		Job job = _queue.front ();
+		_queue.pop_front ();
+		lm.unlock ();
+
+		double colour = 0;
+		double compress = 0;
+		optional<Data> encoded;
+		boost::exception_ptr error;
+
+		try {
+			shared_ptr<OpenJPEGImage> xyz = job.xyz;
+			if (!xyz) {
+				boost::posix_time::ptime const start = boost::posix_time::microsec_clock::universal_time ();
+				xyz = rgb_to_xyz (job.rgb.get(), job.size, job.stride, *_plan);
+				job.rgb.reset ();
+				colour = seconds_since (start);
+			}
+
+			boost::posix_time::ptime const start = boost::posix_time::microsec_clock::universal_time ();
+			encoded = compress_j2k (xyz, _bandwidth, _frames_per_second, _threed, _fourk);
+			compress = seconds_since (start);
+		} catch (...) {
+			error = boost::current_exception ();
+		}
+
+		lm.lock ();
+		_timings.colour += colour;
+		_timings.compress += compress;
+		if (error) {
+			if (!_error) {
+				_error = error;
+			}
+		} else {
+			_encoded[job.index] = *encoded;
+		}
+		_condition.notify_all ();
+	}
+}
+
+void
+EncodePipeline::write_thread ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	while (true) {
+		while (!_stop && !_error && _encoded.find (_next_write) == _encoded.end ()) {
+			_condition.wait (lm);
+		}
+
+		if (_stop || _error) {
+			return;
+		}
+
+		int64_t const index = _next_write;
+		std::map<int64_t, Data>::iterator i = _encoded.find (index);
+		Data const data = i->second;
+		_encoded.erase (i);
+		lm.unlock ();
+
+		boost::exception_ptr error;
+		double write = 0;
+		try {
+			boost::posix_time::ptime const start = boost::posix_time::microsec_clock::universal_time ();
+			FrameInfo const info = _writer->write (data.data().get(), data.size());
+			write = seconds_since (start);
+			if (_written) {
+				_written (index, info);
+			}
+		} catch (...) {
+			error = boost::current_exception ();
+		}
+
+		lm.lock ();
+		_timings.write += write;
+		if (error) {
+			_error = error;
+		} else {
+			++_next_write;
+			++_timings.frames;
+		}
+		_condition.notify_all ();
+	}
+}
@@ -0,0 +1,173 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/encode_pipeline.h
+ *  @brief EncodePipeline class.
+ */
+
+#ifndef LIBDCP_ENCODE_PIPELINE_H
+#define LIBDCP_ENCODE_PIPELINE_H
+
+#include "types.h"
+#include "data.h"
+#include "picture_asset_writer.h"
+#include "colour_conversion.h"
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/shared_array.hpp>
+#include <boost/function.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <boost/exception_ptr.hpp>
+#include <deque>
+#include <map>
+
+namespace dcp {
+
+class OpenJPEGImage;
+class ColourConversionPlan;
+
+/** @class EncodeTimings
+ *  @brief Time spent in each stage of an EncodePipeline.
+ *
+ *  Times are in seconds, summed over all threads, so with several encoding
+ *  threads colour and compress can be more than the elapsed time.
+ */
+struct EncodeTimings
+{
+	EncodeTimings ()
+		: colour (0)
+		, compress (0)
+		, write (0)
+		, waiting (0)
+		, frames (0)
+	{}
+
+	/** time spent converting RGB to XYZ */
+	double colour;
+	/** time spent in JPEG2000 compression */
+	double compress;
+	/** time spent writing to the MXF */
+	double write;
+	/** time that callers of EncodePipeline::encode spent waiting for the pipeline to have space */
+	double waiting;
+	/** number of frames written */
+	int frames;
+};
+
+/** @class EncodePipeline
+ *  @brief Convert and compress frames on a pool of threads and write them, in order, to a PictureAssetWriter.
+ *
+ *  Frames are written in the order in which they are given to encode(); for a stereoscopic
+ *  asset this means alternately left and right.  Once all the frames have been given,
+ *  call finish(), then finalize the writer as usual.  encode() must not be called after finish().
+ */
+class EncodePipeline : public boost::noncopyable
+{
+public:
+	EncodePipeline (
+		boost::shared_ptr<PictureAssetWriter> writer,
+		int bandwidth,
+		int frames_per_second,
+		bool threed,
+		bool fourk,
+		int threads,
+		boost::optional<ColourConversion> conversion = boost::optional<ColourConversion> (),
+		int queue_length = 0,
+		boost::function<void (int64_t, FrameInfo)> written = boost::function<void (int64_t, FrameInfo)> ()
+		);
+
+	~EncodePipeline ();
+
+	void encode (boost::shared_ptr<OpenJPEGImage> xyz);
+	void encode (uint8_t const * rgb, Size size, int stride);
+	void finish ();
+
+	EncodeTimings timings () const;
+
+private:
+	/** A frame waiting to be encoded; it has either xyz or rgb */
+	struct Job
+	{
+		Job ()
+			: index (0)
+			, stride (0)
+		{}
+
+		int64_t index;
+		boost::shared_ptr<OpenJPEGImage> xyz;
+		boost::shared_array<uint8_t> rgb;
+		Size size;
+		int stride;
+	};
+
+	void add (Job job);
+	void encode_thread ();
+	void write_thread ();
+	void terminate ();
+	void rethrow () const;
+
+	boost::shared_ptr<PictureAssetWriter> _writer;
+	int _bandwidth;
+	int _frames_per_second;
+	bool _threed;
+	bool _fourk;
+	boost::shared_ptr<const ColourConversionPlan> _plan;
+	int _queue_length;
+	boost::function<void (int64_t, FrameInfo)> _written;
+
+	boost::thread_group _threads;
+
+	/** mutex for everything below */
+	mutable boost::mutex _mutex;
+	boost::condition_variable _condition;
+	/** frames waiting to be encoded */
+	std::deque<Job> _queue;
+	/** frames which have been encoded but not yet written, keyed by index */
+	std::map<int64_t, Data> _encoded;
+	/** index to give to the next frame passed to encode() */
+	int64_t _next_index;
+	/** index of the next frame to write */
+	int64_t _next_write;
+	/** first error from any of our threads */
+	boost::exception_ptr _error;
+	bool _stop;
+	/** true once finish() has been called */
+	bool _finished;
+	EncodeTimings _timings;
+};
+
+}
+
+#endif
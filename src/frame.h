@@ -36,24 +36,27 @@
 
 #include "crypto_context.h"
 #include "exceptions.h"
+#include "frame_pool.h"
 #include <asdcp/KM_fileio.h>
 #include <asdcp/AS_DCP.h>
 #include <boost/noncopyable.hpp>
 
 namespace dcp {
 
+template <class R, class F>
+class AssetReader;
+
 template <class R, class B>
 class Frame : public boost::noncopyable
 {
 public:
-	Frame (R* reader, int n, boost::shared_ptr<const DecryptionContext> c)
+	/** @param buffer_size Size of buffer to allocate; if it turns out to be too small it will be grown.
+	 *  XXX: the default is unfortunate guesswork.
+	 */
+	Frame (R* reader, int n, boost::shared_ptr<const DecryptionContext> c, int buffer_size = Kumu::Megabyte)
 	{
-		/* XXX: unfortunate guesswork on this buffer size */
-		_buffer = new B (Kumu::Megabyte);
-
-		if (ASDCP_FAILURE (reader->ReadFrame (n, *_buffer, c->context(), c->hmac()))) {
-			boost::throw_exception (DCPReadError ("could not read frame"));
-		}
+		_buffer = new B (buffer_size);
+		read (reader, n, c);
 	}
 
 	~Frame ()
@@ -72,6 +75,22 @@ public:
 	}
 
 private:
+	template <class, class> friend class AssetReader;
+
+	/** Read a frame into our existing buffer, replacing whatever was there */
+	void read (R* reader, int n, boost::shared_ptr<const DecryptionContext> c)
+	{
+		ASDCP::Result_t r = reader->ReadFrame (n, *_buffer, c->context(), c->hmac());
+		while (r == ASDCP::RESULT_SMALLBUF && int (_buffer->Capacity()) < MAX_FRAME_BUFFER_SIZE) {
+			_buffer->Capacity (_buffer->Capacity() * 2);
+			r = reader->ReadFrame (n, *_buffer, c->context(), c->hmac());
+		}
+
+		if (ASDCP_FAILURE (r)) {
+			boost::throw_exception (DCPReadError ("could not read frame"));
+		}
+	}
+
 	B* _buffer;
 };
 
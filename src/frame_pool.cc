@@ -0,0 +1,124 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/frame_pool.cc
+ *  @brief frame_buffer_size methods.
+ */
+
+#include "frame_pool.h"
+#include <asdcp/AS_DCP.h>
+#include <asdcp/MXF.h>
+#include <asdcp/KM_fileio.h>
+#include <algorithm>
+
+using std::max;
+using namespace dcp;
+
+/** @param entries Number of entries in the index.
+ *  @return The biggest gap between the start of one frame and the next in an MXF's index,
+ *  or 0 if there are not enough frames to tell.  The last frame is not covered; if it is
+ *  bigger than all the others our frames' buffers will be grown when it is read.
+ */
+static int
+biggest_frame (ASDCP::MXF::OPAtomIndexFooter& index, int entries)
+{
+	int biggest = 0;
+
+	ASDCP::MXF::IndexTableSegment::IndexEntry last;
+	if (entries < 2 || ASDCP_FAILURE (index.Lookup (0, last))) {
+		return 0;
+	}
+
+	for (int i = 1; i < entries; ++i) {
+		ASDCP::MXF::IndexTableSegment::IndexEntry entry;
+		if (ASDCP_FAILURE (index.Lookup (i, entry))) {
+			break;
+		}
+		biggest = max (biggest, int (entry.StreamOffset - last.StreamOffset));
+		last = entry;
+	}
+
+	return biggest;
+}
+
+/* XXX: these are the same guesses that the frames make when they are not given a size */
+
+int
+dcp::frame_buffer_size (ASDCP::JP2K::MXFReader* reader)
+{
+	ASDCP::JP2K::PictureDescriptor desc;
+	if (ASDCP_FAILURE (reader->FillPictureDescriptor (desc))) {
+		return 4 * Kumu::Megabyte;
+	}
+
+	int const size = biggest_frame (reader->OPAtomIndexFooter(), desc.ContainerDuration);
+	return size > 0 ? size : 4 * Kumu::Megabyte;
+}
+
+int
+dcp::frame_buffer_size (ASDCP::JP2K::MXFSReader* reader)
+{
+	ASDCP::JP2K::PictureDescriptor desc;
+	if (ASDCP_FAILURE (reader->FillPictureDescriptor (desc))) {
+		return 4 * Kumu::Megabyte;
+	}
+
+	/* There is an index entry for each eye, so twice as many entries as frames */
+	int const size = biggest_frame (reader->OPAtomIndexFooter(), desc.ContainerDuration * 2);
+	return size > 0 ? size : 4 * Kumu::Megabyte;
+}
+
+int
+dcp::frame_buffer_size (ASDCP::PCM::MXFReader* reader)
+{
+	ASDCP::PCM::AudioDescriptor desc;
+	if (ASDCP_FAILURE (reader->FillAudioDescriptor (desc))) {
+		return Kumu::Megabyte;
+	}
+
+	/* PCM frames are all the same size so we don't need the index */
+	return ASDCP::PCM::CalcFrameBufferSize (desc);
+}
+
+int
+dcp::frame_buffer_size (ASDCP::ATMOS::MXFReader* reader)
+{
+	ASDCP::ATMOS::AtmosDescriptor desc;
+	if (ASDCP_FAILURE (reader->FillAtmosDescriptor (desc))) {
+		return Kumu::Megabyte;
+	}
+
+	int const size = biggest_frame (reader->OPAtomIndexFooter(), desc.ContainerDuration);
+	return size > 0 ? size : Kumu::Megabyte;
+}
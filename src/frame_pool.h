@@ -0,0 +1,144 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/frame_pool.h
+ *  @brief FramePool class and frame_buffer_size methods.
+ */
+
+#ifndef LIBDCP_FRAME_POOL_H
+#define LIBDCP_FRAME_POOL_H
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <vector>
+
+namespace ASDCP {
+	namespace JP2K {
+		class MXFReader;
+		class MXFSReader;
+	}
+	namespace PCM {
+		class MXFReader;
+	}
+	namespace ATMOS {
+		class MXFReader;
+	}
+}
+
+namespace dcp {
+
+/** Largest that we will grow a frame's buffer to when a frame does not fit in it */
+int const MAX_FRAME_BUFFER_SIZE = 64 * 1024 * 1024;
+
+/** @return A frame buffer size which should be big enough for any frame in the MXF file that
+ *  a reader has open, going by the file's index table.
+ */
+extern int frame_buffer_size (ASDCP::JP2K::MXFReader* reader);
+extern int frame_buffer_size (ASDCP::JP2K::MXFSReader* reader);
+extern int frame_buffer_size (ASDCP::PCM::MXFReader* reader);
+extern int frame_buffer_size (ASDCP::ATMOS::MXFReader* reader);
+
+/** @class FramePool
+ *  @brief A set of idle frames which an AssetReader can read into instead of allocating new ones.
+ *
+ *  Frames are handed out in shared_ptrs whose deleter gives them back to the pool,
+ *  so a frame can outlive both its reader and the pool's owner.
+ */
+template <class F>
+class FramePool : public boost::noncopyable
+{
+public:
+	explicit FramePool (int buffer_size)
+		: _buffer_size (buffer_size)
+	{}
+
+	~FramePool ()
+	{
+		for (typename std::vector<F*>::iterator i = _frames.begin(); i != _frames.end(); ++i) {
+			delete *i;
+		}
+	}
+
+	/** @return Size of buffer to allocate for new frames */
+	int buffer_size () const {
+		return _buffer_size;
+	}
+
+	/** @return An idle frame, or 0 if there are none */
+	F* take ()
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (_frames.empty ()) {
+			return 0;
+		}
+		F* f = _frames.back ();
+		_frames.pop_back ();
+		return f;
+	}
+
+	/** Give a frame (back) to the pool */
+	void give (F* f)
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_frames.push_back (f);
+	}
+
+	/** Deleter for frames handed out by the pool */
+	class Return
+	{
+	public:
+		explicit Return (boost::shared_ptr<FramePool> pool)
+			: _pool (pool)
+		{}
+
+		void operator() (F* f) const
+		{
+			_pool->give (f);
+		}
+
+	private:
+		boost::shared_ptr<FramePool> _pool;
+	};
+
+private:
+	int _buffer_size;
+	/** mutex for _frames, since frames may be dropped by any thread */
+	boost::mutex _mutex;
+	std::vector<F*> _frames;
+};
+
+}
+
+#endif
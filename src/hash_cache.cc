@@ -0,0 +1,279 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/hash_cache.cc
+ *  @brief HashCache class.
+ */
+
+#include "hash_cache.h"
+#include "exceptions.h"
+#include "raw_convert.h"
+#include "util.h"
+#include <boost/thread/mutex.hpp>
+#include <boost/throw_exception.hpp>
+#ifndef LIBDCP_WINDOWS
+#include <sys/stat.h>
+#endif
+#include <cerrno>
+#include <cstdio>
+
+using std::string;
+using boost::optional;
+using boost::shared_ptr;
+using namespace dcp;
+
+/** The cache that make_digest() uses, if any */
+static shared_ptr<HashCache> global_hash_cache;
+static boost::mutex global_hash_cache_mutex;
+
+/** Open a hash cache, reading any entries which are already in its file.  Each line
+ *  of the file is the size, modification time (as seconds.nanoseconds), inode number,
+ *  hash and canonical path of a file, separated by spaces; when a path appears more
+ *  than once the last entry is used.  Lines which cannot be understood are ignored.
+ *  Entries for files which have gone or changed are dropped, and if anything was
+ *  dropped the file is rewritten with only the entries which are left.
+ *
+ *  @param file File to keep the cache in; it will be created if it does not exist.
+ */
+HashCache::HashCache (boost::filesystem::path file)
+	: _file (file)
+{
+	FILE* f = fopen_boost (_file, "r");
+	if (!f) {
+		return;
+	}
+
+	int lines = 0;
+	char line[8192];
+	while (fgets (line, sizeof (line), f)) {
+		++lines;
+		string s (line);
+		if (s.empty() || s[s.length() - 1] != '\n') {
+			/* Too long, or the last line of an interrupted write */
+			continue;
+		}
+		s = s.substr (0, s.length() - 1);
+
+		size_t fields[4];
+		size_t p = 0;
+		int n = 0;
+		while (n < 4 && (p = s.find (' ', n == 0 ? 0 : fields[n - 1] + 1)) != string::npos) {
+			fields[n++] = p;
+		}
+		if (n < 4) {
+			continue;
+		}
+
+		Entry e;
+		e.identity.size = raw_convert<long long> (s.substr (0, fields[0]));
+		string const mtime = s.substr (fields[0] + 1, fields[1] - fields[0] - 1);
+		size_t const dot = mtime.find ('.');
+		e.identity.mtime = raw_convert<long long> (mtime.substr (0, dot));
+		if (dot != string::npos) {
+			e.identity.mtime_nsec = raw_convert<long> (mtime.substr (dot + 1));
+		}
+		e.identity.inode = raw_convert<long long> (s.substr (fields[1] + 1, fields[2] - fields[1] - 1));
+		e.hash = s.substr (fields[2] + 1, fields[3] - fields[2] - 1);
+		_entries[s.substr (fields[3] + 1)] = e;
+	}
+
+	fclose (f);
+
+	for (std::map<boost::filesystem::path, Entry>::iterator i = _entries.begin(); i != _entries.end(); ) {
+		bool current = false;
+		try {
+			current = identify (i->first) == i->second.identity;
+		} catch (boost::filesystem::filesystem_error &) {
+
+		}
+
+		if (current) {
+			++i;
+		} else {
+			_entries.erase (i++);
+		}
+	}
+
+	if (lines > int (_entries.size ())) {
+		compact ();
+	}
+}
+
+HashCache::Identity
+HashCache::identify (boost::filesystem::path file)
+{
+	Identity id;
+	id.size = boost::filesystem::file_size (file);
+	id.mtime = boost::filesystem::last_write_time (file);
+#ifndef LIBDCP_WINDOWS
+	struct stat st;
+	if (stat (file.string().c_str(), &st) == 0) {
+		id.inode = st.st_ino;
+#ifdef LIBDCP_OSX
+		id.mtime_nsec = st.st_mtimespec.tv_nsec;
+#else
+		id.mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+	}
+#endif
+	return id;
+}
+
+/** @param file A file.
+ *  @return The cached hash of the file, if there is one and the file has not changed
+ *  (in size, modification time or inode) since it was added.
+ */
+optional<string>
+HashCache::get (boost::filesystem::path file) const
+{
+	boost::system::error_code ec;
+	boost::filesystem::path const canonical = boost::filesystem::canonical (file, ec);
+	if (ec) {
+		return optional<string> ();
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	std::map<boost::filesystem::path, Entry>::const_iterator i = _entries.find (canonical);
+	if (i == _entries.end()) {
+		return optional<string> ();
+	}
+
+	Entry const entry = i->second;
+	lm.unlock ();
+
+	try {
+		if (identify (canonical) == entry.identity) {
+			return entry.hash;
+		}
+	} catch (boost::filesystem::filesystem_error &) {
+
+	}
+
+	return optional<string> ();
+}
+
+/** Add the hash of a file to the cache, replacing any that is already there.
+ *  This can be used to prime the cache with a hash that was computed some other way,
+ *  for example as the file was written.  The file must not change between the hash
+ *  being computed and this method being called.
+ *
+ *  @param file File.
+ *  @param hash Hash of the file's current contents.
+ */
+void
+HashCache::add (boost::filesystem::path file, string hash)
+{
+	boost::filesystem::path const canonical = boost::filesystem::canonical (file);
+
+	Entry e;
+	e.identity = identify (canonical);
+	e.hash = hash;
+
+	boost::mutex::scoped_lock lm (_mutex);
+	_entries[canonical] = e;
+
+	FILE* f = fopen_boost (_file, "a");
+	if (!f) {
+		boost::throw_exception (FileError ("could not open hash cache", _file, errno));
+	}
+
+	write (f, canonical, e);
+	fclose (f);
+}
+
+/** Write one line of the cache's file */
+void
+HashCache::write (FILE* f, boost::filesystem::path file, Entry const & entry)
+{
+	char nsec[16];
+	snprintf (nsec, sizeof (nsec), "%09ld", entry.identity.mtime_nsec);
+
+	fprintf (
+		f, "%s %s.%s %s %s %s\n",
+		raw_convert<string> (entry.identity.size).c_str(),
+		raw_convert<string> (entry.identity.mtime).c_str(),
+		nsec,
+		raw_convert<string> (entry.identity.inode).c_str(),
+		entry.hash.c_str(),
+		file.string().c_str()
+		);
+}
+
+/** Replace the cache's file with one that holds just the entries in _entries */
+void
+HashCache::compact ()
+{
+	boost::filesystem::path const temp = _file.string() + ".tmp";
+
+	FILE* f = fopen_boost (temp, "w");
+	if (!f) {
+		boost::throw_exception (FileError ("could not open hash cache", temp, errno));
+	}
+
+	for (std::map<boost::filesystem::path, Entry>::const_iterator i = _entries.begin(); i != _entries.end(); ++i) {
+		write (f, i->first, i->second);
+	}
+
+	fclose (f);
+	boost::filesystem::rename (temp, _file);
+}
+
+/** Remove all entries from the cache, including from its file */
+void
+HashCache::clear ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_entries.clear ();
+	boost::system::error_code ec;
+	boost::filesystem::remove (_file, ec);
+}
+
+/** Set a cache to be used by make_digest() (and hence by Asset::hash()) for all
+ *  files from now on.
+ *  @param cache Cache, or an empty pointer to use no cache.
+ */
+void
+dcp::set_hash_cache (shared_ptr<HashCache> cache)
+{
+	boost::mutex::scoped_lock lm (global_hash_cache_mutex);
+	global_hash_cache = cache;
+}
+
+/** @return The cache which is being used by make_digest(), or an empty pointer */
+shared_ptr<HashCache>
+dcp::hash_cache ()
+{
+	boost::mutex::scoped_lock lm (global_hash_cache_mutex);
+	return global_hash_cache;
+}
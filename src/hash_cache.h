@@ -0,0 +1,125 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/hash_cache.h
+ *  @brief HashCache class.
+ */
+
+#ifndef LIBDCP_HASH_CACHE_H
+#define LIBDCP_HASH_CACHE_H
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/optional.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <stdint.h>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <string>
+
+namespace dcp {
+
+/** @class HashCache
+ *  @brief A store of file digests which persists in a file on disk.
+ *
+ *  Each digest is stored along with the canonical path, size, modification time and
+ *  (where the filesystem has them) inode number of the file that it was computed from.
+ *  A digest is only returned for a file if all of these still match.  New digests are
+ *  appended to the cache's file as soon as they are added, so nothing is lost if the
+ *  program is interrupted.  The file is compacted when a HashCache is created from it,
+ *  so it holds only one entry for each file which still exists and has not changed.
+ *
+ *  A HashCache may be used from several threads at once.
+ */
+class HashCache : public boost::noncopyable
+{
+public:
+	explicit HashCache (boost::filesystem::path file);
+
+	boost::optional<std::string> get (boost::filesystem::path file) const;
+	void add (boost::filesystem::path file, std::string hash);
+	void clear ();
+
+	boost::filesystem::path file () const {
+		return _file;
+	}
+
+private:
+	/** Things that identify a particular version of a file */
+	struct Identity
+	{
+		Identity ()
+			: size (0)
+			, mtime (0)
+			, mtime_nsec (0)
+			, inode (0)
+		{}
+
+		boost::uintmax_t size;
+		std::time_t mtime;
+		/** nanoseconds part of the modification time, or 0 where it is not known */
+		long mtime_nsec;
+		/** inode number, or 0 on filesystems that have none */
+		uint64_t inode;
+
+		bool operator== (Identity const & other) const {
+			return size == other.size && mtime == other.mtime && mtime_nsec == other.mtime_nsec && inode == other.inode;
+		}
+	};
+
+	struct Entry
+	{
+		Identity identity;
+		std::string hash;
+	};
+
+	static Identity identify (boost::filesystem::path file);
+	static void write (FILE* f, boost::filesystem::path file, Entry const & entry);
+	void compact ();
+
+	boost::filesystem::path _file;
+	/** mutex for _entries and for writes to _file */
+	mutable boost::mutex _mutex;
+	/** entries, indexed by canonical path */
+	std::map<boost::filesystem::path, Entry> _entries;
+};
+
+extern void set_hash_cache (boost::shared_ptr<HashCache> cache);
+extern boost::shared_ptr<HashCache> hash_cache ();
+
+}
+
+#endif
@@ -44,6 +44,7 @@
 #include <libxml++/libxml++.h>
 #include <boost/foreach.hpp>
 #include <boost/weak_ptr.hpp>
+#include <boost/throw_exception.hpp>
 #include <cmath>
 #include <cstdio>
 
@@ -175,7 +176,7 @@ InteropSubtitleAsset::write (boost::filesystem::path p) const
 {
 	FILE* f = fopen_boost (p, "w");
 	if (!f) {
-		throw FileError ("Could not open file for writing", p, -1);
+		boost::throw_exception (FileError ("Could not open file for writing", p, -1));
 	}
 
 	string const s = xml_as_string ();
@@ -198,7 +199,7 @@ InteropSubtitleAsset::write (boost::filesystem::path p) const
 		boost::filesystem::path file = p.parent_path() / i->uri;
 		FILE* f = fopen_boost (file, "wb");
 		if (!f) {
-			throw FileError ("could not open font file for writing", file, errno);
+			boost::throw_exception (FileError ("could not open font file for writing", file, errno));
 		}
 		list<Font>::const_iterator j = _fonts.begin ();
 		while (j != _fonts.end() && j->load_id != i->id) {
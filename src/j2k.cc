@@ -38,11 +38,15 @@
 #include "dcp_assert.h"
 #include "compose.hpp"
 #include <openjpeg.h>
+#include <boost/thread/tss.hpp>
 #include <cmath>
 #include <iostream>
+#include <vector>
 
 using std::min;
+using std::max;
 using std::pow;
+using std::vector;
 using boost::shared_ptr;
 using boost::shared_array;
 using namespace dcp;
@@ -53,12 +57,38 @@ dcp::decompress_j2k (Data data, int reduce)
 	return dcp::decompress_j2k (data.data().get(), data.size(), reduce);
 }
 
+/** Per-thread buffer for the version of compress_j2k which returns Data */
+static boost::thread_specific_ptr<vector<uint8_t> > compress_buffer;
+
+/** @param xyz Picture to compress.  Parts of xyz's data WILL BE OVERWRITTEN by libopenjpeg so xyz cannot be re-used
+ *  after this call.
+ *  @return JPEG2000 codestream.
+ */
+Data
+dcp::compress_j2k (shared_ptr<const OpenJPEGImage> xyz, int bandwidth, int frames_per_second, bool threed, bool fourk)
+{
+	if (!compress_buffer.get ()) {
+		compress_buffer.reset (new vector<uint8_t> ());
+	}
+
+	compress_j2k (xyz, bandwidth, frames_per_second, threed, fourk, *compress_buffer);
+	if (compress_buffer->empty ()) {
+		return Data ();
+	}
+
+	return Data (&(*compress_buffer)[0], compress_buffer->size ());
+}
+
 #ifdef LIBDCP_OPENJPEG2
 
+/** Wrapper around some J2K data in memory which opj_stream_t reads from.
+ *  It does not own the data, and it lives on the stack of decompress_j2k so
+ *  that decoding a frame needs no allocation for the source.
+ */
 class ReadBuffer
 {
 public:
-	ReadBuffer (uint8_t* data, int64_t size)
+	ReadBuffer (uint8_t const * data, int64_t size)
 		: _data (data)
 		, _size (size)
 		, _offset (0)
@@ -66,14 +96,34 @@ public:
 
 	OPJ_SIZE_T read (void* buffer, OPJ_SIZE_T nb_bytes)
 	{
-		int64_t N = min (nb_bytes, _size - _offset);
+		OPJ_SIZE_T const N = min (nb_bytes, _size - _offset);
 		memcpy (buffer, _data + _offset, N);
 		_offset += N;
 		return N;
 	}
 
+	OPJ_OFF_T skip (OPJ_OFF_T nb_bytes)
+	{
+		if (nb_bytes < 0 || OPJ_SIZE_T (nb_bytes) > _size - _offset) {
+			/* Skipping backwards or off the end; leave our position at the end */
+			_offset = _size;
+			return -1;
+		}
+		_offset += nb_bytes;
+		return nb_bytes;
+	}
+
+	bool seek (OPJ_OFF_T position)
+	{
+		if (position < 0 || OPJ_SIZE_T (position) > _size) {
+			return false;
+		}
+		_offset = position;
+		return true;
+	}
+
 private:
-	uint8_t* _data;
+	uint8_t const * _data;
 	OPJ_SIZE_T _size;
 	OPJ_SIZE_T _offset;
 };
@@ -84,16 +134,22 @@ read_function (void* buffer, OPJ_SIZE_T nb_bytes, void* data)
 	return reinterpret_cast<ReadBuffer*>(data)->read (buffer, nb_bytes);
 }
 
-static void
-read_free_function (void* data)
+static OPJ_OFF_T
+read_skip_function (OPJ_OFF_T nb_bytes, void* data)
 {
-	delete reinterpret_cast<ReadBuffer*>(data);
+	return reinterpret_cast<ReadBuffer*>(data)->skip (nb_bytes);
+}
+
+static OPJ_BOOL
+read_seek_function (OPJ_OFF_T position, void* data)
+{
+	return reinterpret_cast<ReadBuffer*>(data)->seek (position) ? OPJ_TRUE : OPJ_FALSE;
 }
 
 static void
 error_callback (char const * msg, void *)
 {
-	throw MiscError (msg);
+	boost::throw_exception (MiscError (msg));
 }
 
 /** Decompress a JPEG2000 image to a bitmap.
@@ -106,7 +162,7 @@ error_callback (char const * msg, void *)
  *  @return OpenJPEGImage.
  */
 shared_ptr<dcp::OpenJPEGImage>
-dcp::decompress_j2k (uint8_t* data, int64_t size, int reduce)
+dcp::decompress_j2k (uint8_t const * data, int64_t size, int reduce)
 {
 	DCP_ASSERT (reduce >= 0);
 
@@ -135,16 +191,23 @@ dcp::decompress_j2k (uint8_t* data, int64_t size, int reduce)
 	parameters.cp_reduce = reduce;
 	opj_setup_decoder (decoder, &parameters);
 
-	opj_stream_t* stream = opj_stream_default_create (OPJ_TRUE);
+	/* opj_stream_default_create would give us a 1MB internal buffer whatever the
+	   size of the codestream; a frame is usually much smaller than that, so ask for
+	   no more than we will ever read.
+	*/
+	opj_stream_t* stream = opj_stream_create (min (OPJ_SIZE_T (max (size, int64_t (1))), OPJ_SIZE_T (OPJ_J2K_STREAM_CHUNK_SIZE)), OPJ_TRUE);
 	if (!stream) {
-		throw MiscError ("could not create JPEG2000 stream");
+		opj_destroy_codec (decoder);
+		boost::throw_exception (MiscError ("could not create JPEG2000 stream"));
 	}
 
 	opj_set_error_handler(decoder, error_callback, 00);
 
+	ReadBuffer buffer (data, size);
 	opj_stream_set_read_function (stream, read_function);
-	ReadBuffer* buffer = new ReadBuffer (data, size);
-	opj_stream_set_user_data (stream, buffer, read_free_function);
+	opj_stream_set_skip_function (stream, read_skip_function);
+	opj_stream_set_seek_function (stream, read_seek_function);
+	opj_stream_set_user_data (stream, &buffer, 0);
 	opj_stream_set_user_data_length (stream, size);
 
 	opj_image_t* image = 0;
@@ -179,14 +242,14 @@ dcp::decompress_j2k (uint8_t* data, int64_t size, int reduce)
  *  @return XYZ image.
  */
 shared_ptr<dcp::OpenJPEGImage>
-dcp::decompress_j2k (uint8_t* data, int64_t size, int reduce)
+dcp::decompress_j2k (uint8_t const * data, int64_t size, int reduce)
 {
 	opj_dinfo_t* decoder = opj_create_decompress (CODEC_J2K);
 	opj_dparameters_t parameters;
 	opj_set_default_decoder_parameters (&parameters);
 	parameters.cp_reduce = reduce;
 	opj_setup_decoder (decoder, &parameters);
-	opj_cio_t* cio = opj_cio_open ((opj_common_ptr) decoder, data, size);
+	opj_cio_t* cio = opj_cio_open ((opj_common_ptr) decoder, const_cast<uint8_t*> (data), size);
 	opj_image_t* image = opj_decode (decoder, cio);
 	if (!image) {
 		opj_destroy_decompress (decoder);
@@ -204,26 +267,27 @@ dcp::decompress_j2k (uint8_t* data, int64_t size, int reduce)
 #endif
 
 #ifdef LIBDCP_OPENJPEG2
+/** Wrapper around a caller's vector which opj_stream_t writes to, growing it as required */
 class WriteBuffer
 {
 public:
-/* XXX: is there a better strategy for this? */
-#define MAX_J2K_SIZE (1024 * 1024 * 2)
-	WriteBuffer ()
-		: _data (shared_array<uint8_t> (new uint8_t[MAX_J2K_SIZE]), MAX_J2K_SIZE)
+	explicit WriteBuffer (std::vector<uint8_t>& data)
+		: _data (data)
 		, _offset (0)
 	{
-		_data.set_size (0);
+		/* This keeps the vector's capacity, so a vector which is re-used for
+		   many frames will soon stop needing to allocate.
+		*/
+		_data.clear ();
 	}
 
 	OPJ_SIZE_T write (void* buffer, OPJ_SIZE_T nb_bytes)
 	{
-		DCP_ASSERT ((_offset + nb_bytes) < MAX_J2K_SIZE);
-		memcpy (_data.data().get() + _offset, buffer, nb_bytes);
-		_offset += nb_bytes;
-		if (_offset > OPJ_SIZE_T (_data.size())) {
-			_data.set_size (_offset);
+		if ((_offset + nb_bytes) > _data.size ()) {
+			_data.resize (_offset + nb_bytes);
 		}
+		memcpy (&_data[_offset], buffer, nb_bytes);
+		_offset += nb_bytes;
 		return nb_bytes;
 	}
 
@@ -233,13 +297,8 @@ public:
 		return OPJ_TRUE;
 	}
 
-	Data data () const
-	{
-		return _data;
-	}
-
 private:
-	Data _data;
+	std::vector<uint8_t>& _data;
 	OPJ_SIZE_T _offset;
 };
 
@@ -249,28 +308,24 @@ write_function (void* buffer, OPJ_SIZE_T nb_bytes, void* data)
 	return reinterpret_cast<WriteBuffer*>(data)->write (buffer, nb_bytes);
 }
 
-static void
-write_free_function (void* data)
-{
-	delete reinterpret_cast<WriteBuffer*>(data);
-}
-
 static OPJ_BOOL
 seek_function (OPJ_OFF_T nb_bytes, void* data)
 {
 	return reinterpret_cast<WriteBuffer*>(data)->seek (nb_bytes);
 }
 
-/** @xyz Picture to compress.  Parts of xyz's data WILL BE OVERWRITTEN by libopenjpeg so xyz cannot be re-used
+/** @param xyz Picture to compress.  Parts of xyz's data WILL BE OVERWRITTEN by libopenjpeg so xyz cannot be re-used
  *  after this call; see opj_j2k_encode where if l_reuse_data is false it will set l_tilec->data = l_img_comp->data.
+ *  @param output Vector to put the JPEG2000 codestream in; it is resized to fit, and if it is re-used for several
+ *  frames it will not need to be re-allocated once it is big enough.
  */
-Data
-dcp::compress_j2k (shared_ptr<const OpenJPEGImage> xyz, int bandwidth, int frames_per_second, bool threed, bool fourk)
+void
+dcp::compress_j2k (shared_ptr<const OpenJPEGImage> xyz, int bandwidth, int frames_per_second, bool threed, bool fourk, vector<uint8_t>& output)
 {
 	/* get a J2K compressor handle */
 	opj_codec_t* encoder = opj_create_compress (OPJ_CODEC_J2K);
 	if (encoder == 0) {
-		throw MiscError ("could not create JPEG2000 encoder");
+		boost::throw_exception (MiscError ("could not create JPEG2000 encoder"));
 	}
 
 	opj_set_error_handler (encoder, error_callback, 0);
@@ -299,48 +354,47 @@ dcp::compress_j2k (shared_ptr<const OpenJPEGImage> xyz, int bandwidth, int frame
 
 	opj_stream_t* stream = opj_stream_default_create (OPJ_FALSE);
 	if (!stream) {
-		throw MiscError ("could not create JPEG2000 stream");
+		boost::throw_exception (MiscError ("could not create JPEG2000 stream"));
 	}
 
+	/* Reserve enough for a codestream of the maximum size, with a little extra for headers */
+	output.reserve (parameters.max_cs_size + 65536);
+
+	WriteBuffer buffer (output);
 	opj_stream_set_write_function (stream, write_function);
 	opj_stream_set_seek_function (stream, seek_function);
-	WriteBuffer* buffer = new WriteBuffer ();
-	opj_stream_set_user_data (stream, buffer, write_free_function);
+	opj_stream_set_user_data (stream, &buffer, 0);
 
 	if (!opj_start_compress (encoder, xyz->opj_image(), stream)) {
 		if ((errno & 0x61500) == 0x61500) {
 			/* We've had one of the magic error codes from our patched openjpeg */
-			throw MiscError (String::compose ("could not start JPEG2000 encoding (%1)", errno & 0xff));
+			boost::throw_exception (MiscError (String::compose ("could not start JPEG2000 encoding (%1)", errno & 0xff)));
 		} else {
-			throw MiscError ("could not start JPEG2000 encoding");
+			boost::throw_exception (MiscError ("could not start JPEG2000 encoding"));
 		}
 	}
 
 	if (!opj_encode (encoder, stream)) {
 		opj_destroy_codec (encoder);
 		opj_stream_destroy (stream);
-		throw MiscError ("JPEG2000 encoding failed");
+		boost::throw_exception (MiscError ("JPEG2000 encoding failed"));
 	}
 
 	if (!opj_end_compress (encoder, stream)) {
 		opj_destroy_codec (encoder);
 		opj_stream_destroy (stream);
-		throw MiscError ("could not end JPEG2000 encoding");
+		boost::throw_exception (MiscError ("could not end JPEG2000 encoding"));
 	}
 
-	Data enc (buffer->data ());
-
 	free (parameters.cp_comment);
 	opj_destroy_codec (encoder);
 	opj_stream_destroy (stream);
-
-	return enc;
 }
 #endif
 
 #ifdef LIBDCP_OPENJPEG1
-Data
-dcp::compress_j2k (shared_ptr<const OpenJPEGImage> xyz, int bandwidth, int frames_per_second, bool threed, bool fourk)
+void
+dcp::compress_j2k (shared_ptr<const OpenJPEGImage> xyz, int bandwidth, int frames_per_second, bool threed, bool fourk, vector<uint8_t>& output)
 {
 	/* Set the max image and component sizes based on frame_rate */
 	int max_cs_len = ((float) bandwidth) / 8 / frames_per_second;
@@ -353,7 +407,7 @@ dcp::compress_j2k (shared_ptr<const OpenJPEGImage> xyz, int bandwidth, int frame
 	/* get a J2K compressor handle */
 	opj_cinfo_t* cinfo = opj_create_compress (CODEC_J2K);
 	if (cinfo == 0) {
-		throw MiscError ("could not create JPEG2000 encoder");
+		boost::throw_exception (MiscError ("could not create JPEG2000 encoder"));
 	}
 
 	/* Set encoding parameters to default values */
@@ -436,23 +490,21 @@ dcp::compress_j2k (shared_ptr<const OpenJPEGImage> xyz, int bandwidth, int frame
 	opj_cio_t* cio = opj_cio_open ((opj_common_ptr) cinfo, 0, 0);
 	if (cio == 0) {
 		opj_destroy_compress (cinfo);
-		throw MiscError ("could not open JPEG2000 stream");
+		boost::throw_exception (MiscError ("could not open JPEG2000 stream"));
 	}
 
 	int const r = opj_encode (cinfo, cio, xyz->opj_image(), 0);
 	if (r == 0) {
 		opj_cio_close (cio);
 		opj_destroy_compress (cinfo);
-		throw MiscError ("JPEG2000 encoding failed");
+		boost::throw_exception (MiscError ("JPEG2000 encoding failed"));
 	}
 
-	Data enc (cio->buffer, cio_tell (cio));
+	output.assign (cio->buffer, cio->buffer + cio_tell (cio));
 
 	opj_cio_close (cio);
 	free (parameters.cp_comment);
 	opj_destroy_compress (cinfo);
-
-	return enc;
 }
 
 #endif
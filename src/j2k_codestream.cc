@@ -0,0 +1,225 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/j2k_codestream.cc
+ *  @brief J2KCodestream class.
+ */
+
+#include "j2k_codestream.h"
+#include "dcp_assert.h"
+#include <algorithm>
+#include <cstring>
+
+using std::map;
+using std::vector;
+using namespace dcp;
+
+/* Markers, from ISO 15444-1 Annex A */
+static int const SOC = 0xff4f;
+static int const SOT = 0xff90;
+static int const SOD = 0xff93;
+static int const EOC = 0xffd9;
+static int const TLM = 0xff55;
+static int const PLM = 0xff57;
+static int const PLT = 0xff58;
+static int const COM = 0xff64;
+
+static int
+read_16 (uint8_t const * p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static int64_t
+read_32 (uint8_t const * p)
+{
+	return (int64_t (p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/** @return true if a marker segment makes no difference to the decoded image */
+static bool
+ignorable (int marker)
+{
+	return marker == TLM || marker == PLM || marker == PLT || marker == COM;
+}
+
+/** Parse a codestream.  If it cannot be parsed valid() will return false.
+ *  @param data Codestream data, which must outlive this object.
+ *  @param size Size of the data in bytes.
+ */
+J2KCodestream::J2KCodestream (uint8_t const * data, int64_t size)
+{
+	_valid = parse (data, size);
+	if (!_valid) {
+		_header.clear ();
+		_tiles.clear ();
+	}
+}
+
+bool
+J2KCodestream::parse (uint8_t const * data, int64_t size)
+{
+	if (size < 4 || read_16 (data) != SOC) {
+		return false;
+	}
+
+	int64_t p = 2;
+
+	/* Main header */
+	while (true) {
+		if (p + 4 > size) {
+			return false;
+		}
+		int const marker = read_16 (data + p);
+		if (marker == SOT) {
+			break;
+		}
+		int const length = read_16 (data + p + 2);
+		if ((marker & 0xff00) != 0xff00 || length < 2 || p + 2 + length > size) {
+			return false;
+		}
+		if (!ignorable (marker)) {
+			_header.push_back (Part (data + p, 2 + length));
+		}
+		p += 2 + length;
+	}
+
+	/* Tile-parts */
+	while (true) {
+		if (p + 2 > size) {
+			return false;
+		}
+
+		int const marker = read_16 (data + p);
+		if (marker == EOC) {
+			return true;
+		} else if (marker != SOT || p + 12 > size || read_16 (data + p + 2) != 10) {
+			return false;
+		}
+
+		int const tile = read_16 (data + p + 4);
+		int64_t const length = read_32 (data + p + 6);
+		/* A length of 0 means that the tile-part runs until the EOC at the end of the codestream */
+		int64_t const end = length ? p + length : size - 2;
+		if (end > size || end < p + 14) {
+			return false;
+		}
+
+		Parts& parts = _tiles[tile];
+
+		p += 12;
+		while (true) {
+			if (p + 2 > end) {
+				return false;
+			}
+			int const marker = read_16 (data + p);
+			if (marker == SOD) {
+				p += 2;
+				break;
+			}
+			if (p + 4 > end) {
+				return false;
+			}
+			int const length = read_16 (data + p + 2);
+			if ((marker & 0xff00) != 0xff00 || length < 2 || p + 2 + length > end) {
+				return false;
+			}
+			if (!ignorable (marker)) {
+				parts.push_back (Part (data + p, 2 + length));
+			}
+			p += 2 + length;
+		}
+
+		parts.push_back (Part (data + p, end - p));
+		p = end;
+	}
+}
+
+/** @return true if two lists of parts contain the same bytes; the bytes may be split up differently */
+bool
+J2KCodestream::parts_equal (Parts const & a, Parts const & b)
+{
+	Parts::const_iterator i = a.begin ();
+	Parts::const_iterator j = b.begin ();
+	int64_t i_offset = 0;
+	int64_t j_offset = 0;
+
+	while (true) {
+		/* Skip over anything that we have finished with */
+		while (i != a.end() && i_offset == i->size) {
+			++i;
+			i_offset = 0;
+		}
+		while (j != b.end() && j_offset == j->size) {
+			++j;
+			j_offset = 0;
+		}
+
+		if (i == a.end() || j == b.end()) {
+			return i == a.end() && j == b.end();
+		}
+
+		int64_t const n = std::min (i->size - i_offset, j->size - j_offset);
+		if (memcmp (i->data + i_offset, j->data + j_offset, n) != 0) {
+			return false;
+		}
+		i_offset += n;
+		j_offset += n;
+	}
+}
+
+/** @return indices of the tiles which might decode differently in this codestream and another.
+ *  If the main headers differ this will be every tile.  Both codestreams must be valid.
+ */
+vector<int>
+J2KCodestream::different_tiles (J2KCodestream const & other) const
+{
+	DCP_ASSERT (_valid && other._valid);
+
+	bool const all = !parts_equal (_header, other._header);
+
+	map<int, Parts> tiles = _tiles;
+	tiles.insert (other._tiles.begin(), other._tiles.end());
+
+	vector<int> different;
+	for (map<int, Parts>::const_iterator i = tiles.begin(); i != tiles.end(); ++i) {
+		map<int, Parts>::const_iterator a = _tiles.find (i->first);
+		map<int, Parts>::const_iterator b = other._tiles.find (i->first);
+		if (all || a == _tiles.end() || b == other._tiles.end() || !parts_equal (a->second, b->second)) {
+			different.push_back (i->first);
+		}
+	}
+
+	return different;
+}
@@ -0,0 +1,104 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/j2k_codestream.h
+ *  @brief J2KCodestream class.
+ */
+
+#ifndef LIBDCP_J2K_CODESTREAM_H
+#define LIBDCP_J2K_CODESTREAM_H
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+namespace dcp {
+
+/** @class J2KCodestream
+ *  @brief A JPEG2000 codestream split up into the parts which affect its decoded image.
+ *
+ *  Two codestreams whose main headers, tile-part headers and packet data are the same will
+ *  decode to the same image, even if they have different comments, packet length markers or
+ *  tile-part divisions.  Comparing these parts is much quicker than decoding.
+ *
+ *  The codestream's data is not copied, so it must outlive the J2KCodestream.
+ */
+class J2KCodestream
+{
+public:
+	J2KCodestream (uint8_t const * data, int64_t size);
+
+	/** @return true if the data could be parsed as a codestream */
+	bool valid () const {
+		return _valid;
+	}
+
+	/** @return number of tiles which have data in the codestream */
+	int tiles () const {
+		return _tiles.size ();
+	}
+
+	std::vector<int> different_tiles (J2KCodestream const & other) const;
+
+private:
+	/** A piece of the codestream */
+	struct Part
+	{
+		Part (uint8_t const * data_, int64_t size_)
+			: data (data_)
+			, size (size_)
+		{}
+
+		uint8_t const * data;
+		int64_t size;
+	};
+
+	typedef std::vector<Part> Parts;
+
+	bool parse (uint8_t const * data, int64_t size);
+	static bool parts_equal (Parts const & a, Parts const & b);
+
+	/** true if the data could be parsed */
+	bool _valid;
+	/** main header marker segments which affect the decoded image */
+	Parts _header;
+	/** tile-part header marker segments which affect the decoded image, and packet data,
+	 *  in codestream order, indexed by tile
+	 */
+	std::map<int, Parts> _tiles;
+};
+
+}
+
+#endif
@@ -0,0 +1,367 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/library.cc
+ *  @brief Library class.
+ */
+
+#include "library.h"
+#include "dcp.h"
+#include "cpl.h"
+#include "pkl.h"
+#include "reel_asset.h"
+#include "exceptions.h"
+#include "raw_convert.h"
+#include "util.h"
+#include <libcxml/cxml.h>
+#include <libxml++/libxml++.h>
+#include <libxml/parser.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+using std::string;
+using std::list;
+using std::map;
+using boost::shared_ptr;
+using boost::optional;
+using namespace dcp;
+
+/** Open a library, reading its index from a file if the file exists.
+ *  @param file File to keep the library's index in.
+ */
+Library::Library (boost::filesystem::path file)
+	: _file (file)
+{
+	if (!boost::filesystem::exists (_file)) {
+		return;
+	}
+
+	cxml::Document doc ("Library");
+	doc.read_file (_file);
+
+	BOOST_FOREACH (cxml::ConstNodePtr i, doc.node_children ("DCP")) {
+		LibraryDCP dcp;
+		dcp.directory = i->string_child ("Directory");
+		optional<string> standard = i->optional_string_child ("Standard");
+		if (standard) {
+			dcp.standard = *standard == "SMPTE" ? SMPTE : INTEROP;
+		}
+
+		BOOST_FOREACH (cxml::ConstNodePtr j, i->node_children ("XMLFile")) {
+			dcp.xml_files[j->string_child("Name")] = j->number_child<int64_t> ("MTime");
+		}
+
+		BOOST_FOREACH (cxml::ConstNodePtr j, i->node_children ("CPL")) {
+			LibraryCPL cpl;
+			cpl.id = j->string_child ("Id");
+			cpl.file = j->string_child ("File");
+			cpl.annotation_text = j->string_child ("AnnotationText");
+			cpl.content_title_text = j->string_child ("ContentTitleText");
+			cpl.content_kind = content_kind_from_string (j->string_child ("ContentKind"));
+			cpl.duration = j->number_child<int64_t> ("Duration");
+			BOOST_FOREACH (cxml::ConstNodePtr k, j->node_children ("AssetId")) {
+				cpl.asset_ids.push_back (k->content ());
+			}
+			dcp.cpls.push_back (cpl);
+		}
+
+		BOOST_FOREACH (cxml::ConstNodePtr j, i->node_children ("Asset")) {
+			LibraryAsset asset;
+			asset.id = j->string_child ("Id");
+			asset.file = j->string_child ("File");
+			asset.size = j->number_child<boost::uintmax_t> ("Size");
+			asset.type = j->string_child ("Type");
+			asset.hash = j->string_child ("Hash");
+			dcp.assets.push_back (asset);
+		}
+
+		_dcps[dcp.directory] = dcp;
+	}
+}
+
+/** Write the library's index to its file */
+void
+Library::write () const
+{
+	xmlpp::Document doc;
+	xmlpp::Element* root = doc.create_root_node ("Library");
+
+	for (map<boost::filesystem::path, LibraryDCP>::const_iterator i = _dcps.begin(); i != _dcps.end(); ++i) {
+		LibraryDCP const & dcp = i->second;
+		xmlpp::Element* node = root->add_child ("DCP");
+		node->add_child("Directory")->add_child_text (dcp.directory.string ());
+		if (dcp.standard) {
+			node->add_child("Standard")->add_child_text (*dcp.standard == SMPTE ? "SMPTE" : "Interop");
+		}
+
+		for (map<boost::filesystem::path, std::time_t>::const_iterator j = dcp.xml_files.begin(); j != dcp.xml_files.end(); ++j) {
+			xmlpp::Element* file = node->add_child ("XMLFile");
+			file->add_child("Name")->add_child_text (j->first.string ());
+			file->add_child("MTime")->add_child_text (raw_convert<string> (static_cast<int64_t> (j->second)));
+		}
+
+		BOOST_FOREACH (LibraryCPL const & j, dcp.cpls) {
+			xmlpp::Element* cpl = node->add_child ("CPL");
+			cpl->add_child("Id")->add_child_text (j.id);
+			cpl->add_child("File")->add_child_text (j.file.string ());
+			cpl->add_child("AnnotationText")->add_child_text (j.annotation_text);
+			cpl->add_child("ContentTitleText")->add_child_text (j.content_title_text);
+			cpl->add_child("ContentKind")->add_child_text (content_kind_to_string (j.content_kind));
+			cpl->add_child("Duration")->add_child_text (raw_convert<string> (j.duration));
+			BOOST_FOREACH (string const & k, j.asset_ids) {
+				cpl->add_child("AssetId")->add_child_text (k);
+			}
+		}
+
+		BOOST_FOREACH (LibraryAsset const & j, dcp.assets) {
+			xmlpp::Element* asset = node->add_child ("Asset");
+			asset->add_child("Id")->add_child_text (j.id);
+			asset->add_child("File")->add_child_text (j.file.string ());
+			asset->add_child("Size")->add_child_text (raw_convert<string> (j.size));
+			asset->add_child("Type")->add_child_text (j.type);
+			asset->add_child("Hash")->add_child_text (j.hash);
+		}
+	}
+
+	/* Write to a temporary file first so that an interrupted write does not lose the index */
+	boost::filesystem::path tmp = _file;
+	tmp += ".tmp";
+	doc.write_to_file_formatted (tmp.string (), "UTF-8");
+	boost::filesystem::rename (tmp, _file);
+}
+
+/** @return all the DCPs in the library, in order of directory */
+list<LibraryDCP>
+Library::dcps () const
+{
+	list<LibraryDCP> d;
+	for (map<boost::filesystem::path, LibraryDCP>::const_iterator i = _dcps.begin(); i != _dcps.end(); ++i) {
+		d.push_back (i->second);
+	}
+	return d;
+}
+
+/** State shared between the threads of Library::scan */
+struct ScanJobs
+{
+	explicit ScanJobs (map<boost::filesystem::path, LibraryDCP> const & old_)
+		: old (old_)
+		, busy (0)
+	{}
+
+	/** DCPs that were in the library before the scan; not changed during the scan */
+	map<boost::filesystem::path, LibraryDCP> const & old;
+
+	/** mutex for everything below */
+	boost::mutex mutex;
+	boost::condition_variable condition;
+	/** directories waiting to be looked at */
+	list<boost::filesystem::path> directories;
+	/** number of threads which are looking at a directory */
+	int busy;
+	map<boost::filesystem::path, LibraryDCP> found;
+	map<boost::filesystem::path, string> errors;
+};
+
+/** @return true if a file might be part of a DCP's XML (ASSETMAP, PKL, CPL and so on) */
+static bool
+is_xml_file (boost::filesystem::path file)
+{
+	return file.filename() == "ASSETMAP" || boost::algorithm::to_lower_copy (file.extension().string()) == ".xml";
+}
+
+static LibraryDCP
+read_dcp (boost::filesystem::path directory, map<boost::filesystem::path, std::time_t> const & xml_files)
+{
+	DCP dcp (directory);
+	DCP::ReadErrors errors;
+	/* We only need the XML, so there is no need to open the MXFs */
+	dcp.read (true, &errors, false, 1, true);
+
+	LibraryDCP d;
+	d.directory = directory;
+	d.standard = dcp.standard ();
+	d.xml_files = xml_files;
+
+	shared_ptr<PKL> pkl = dcp.pkl ();
+	map<string, boost::filesystem::path> const paths = dcp.asset_paths ();
+	for (map<string, boost::filesystem::path>::const_iterator i = paths.begin(); i != paths.end(); ++i) {
+		LibraryAsset a;
+		a.id = i->first;
+		a.file = i->second;
+		boost::system::error_code ec;
+		a.size = boost::filesystem::file_size (i->second, ec);
+		if (ec) {
+			a.size = 0;
+		}
+		a.type = pkl->type (i->first);
+		a.hash = pkl->hash (i->first);
+		d.assets.push_back (a);
+	}
+
+	BOOST_FOREACH (shared_ptr<CPL> i, dcp.cpls ()) {
+		LibraryCPL c;
+		c.id = i->id ();
+		if (i->file ()) {
+			c.file = i->file().get ();
+		}
+		c.annotation_text = i->annotation_text ();
+		c.content_title_text = i->content_title_text ();
+		c.content_kind = i->content_kind ();
+		c.duration = i->duration ();
+		BOOST_FOREACH (shared_ptr<const ReelAsset> j, i->reel_assets ()) {
+			c.asset_ids.push_back (j->asset_ref().id ());
+		}
+		d.cpls.push_back (c);
+	}
+
+	return d;
+}
+
+static void
+scan_thread (ScanJobs* jobs)
+{
+	boost::mutex::scoped_lock lm (jobs->mutex);
+
+	while (true) {
+		while (jobs->directories.empty() && jobs->busy > 0) {
+			jobs->condition.wait (lm);
+		}
+
+		if (jobs->directories.empty ()) {
+			/* Nothing left to look at and nobody looking, so we are finished */
+			return;
+		}
+
+		boost::filesystem::path const directory = jobs->directories.front ();
+		jobs->directories.pop_front ();
+		++jobs->busy;
+		lm.unlock ();
+
+		list<boost::filesystem::path> subdirectories;
+		map<boost::filesystem::path, std::time_t> xml_files;
+		optional<LibraryDCP> dcp;
+		optional<string> error;
+
+		try {
+			bool asset_map = false;
+			for (boost::filesystem::directory_iterator i (directory); i != boost::filesystem::directory_iterator(); ++i) {
+				boost::filesystem::path const p = i->path ();
+				if (boost::filesystem::is_symlink (p)) {
+					/* Don't follow links, as they might make loops */
+					continue;
+				} else if (boost::filesystem::is_directory (p)) {
+					subdirectories.push_back (p);
+				} else if (is_xml_file (p)) {
+					xml_files[p.filename()] = boost::filesystem::last_write_time (p);
+					if (p.filename() == "ASSETMAP" || p.filename() == "ASSETMAP.xml") {
+						asset_map = true;
+					}
+				}
+			}
+
+			if (asset_map) {
+				map<boost::filesystem::path, LibraryDCP>::const_iterator i = jobs->old.find (directory);
+				if (i != jobs->old.end() && i->second.xml_files == xml_files) {
+					dcp = i->second;
+				} else {
+					dcp = read_dcp (directory, xml_files);
+				}
+			}
+		} catch (std::exception& e) {
+			error = e.what ();
+		} catch (...) {
+			error = "unknown error";
+		}
+
+		lm.lock ();
+		jobs->directories.insert (jobs->directories.end(), subdirectories.begin(), subdirectories.end());
+		if (dcp) {
+			jobs->found[directory] = *dcp;
+		}
+		if (error) {
+			jobs->errors[directory] = *error;
+		}
+		--jobs->busy;
+		jobs->condition.notify_all ();
+	}
+}
+
+/** Look for DCPs in a directory and all its subdirectories, update the library with
+ *  what is found and then write the library's index.  DCPs in the library which are
+ *  not under the directory are left alone; those which are under it but which are no
+ *  longer there are removed.
+ *
+ *  @param root Directory to scan.
+ *  @param threads Number of threads to scan with.
+ */
+void
+Library::scan (boost::filesystem::path root, int threads)
+{
+	boost::filesystem::path const top = boost::filesystem::canonical (root);
+
+	ScanJobs jobs (_dcps);
+	jobs.directories.push_back (top);
+
+	if (threads > 1) {
+		/* libxml2 must be initialised before it is used on more than one thread */
+		xmlInitParser ();
+		boost::thread_group group;
+		for (int i = 0; i < threads; ++i) {
+			group.create_thread (boost::bind (&scan_thread, &jobs));
+		}
+		group.join_all ();
+	} else {
+		scan_thread (&jobs);
+	}
+
+	map<boost::filesystem::path, LibraryDCP>::iterator i = _dcps.begin ();
+	while (i != _dcps.end ()) {
+		map<boost::filesystem::path, LibraryDCP>::iterator tmp = i;
+		++i;
+		if (relative_to_root (top, tmp->first)) {
+			_dcps.erase (tmp);
+		}
+	}
+
+	for (map<boost::filesystem::path, LibraryDCP>::const_iterator j = jobs.found.begin(); j != jobs.found.end(); ++j) {
+		_dcps[j->first] = j->second;
+	}
+
+	_errors = jobs.errors;
+
+	write ();
+}
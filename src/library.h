@@ -0,0 +1,136 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/library.h
+ *  @brief Library class.
+ */
+
+#ifndef LIBDCP_LIBRARY_H
+#define LIBDCP_LIBRARY_H
+
+#include "types.h"
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+
+namespace dcp {
+
+/** @brief Details of an asset in a LibraryDCP */
+struct LibraryAsset
+{
+	LibraryAsset ()
+		: size (0)
+	{}
+
+	std::string id;
+	/** full path of the asset's file */
+	boost::filesystem::path file;
+	/** size of the file in bytes */
+	boost::uintmax_t size;
+	/** type given in the PKL */
+	std::string type;
+	/** hash given in the PKL */
+	std::string hash;
+};
+
+/** @brief Details of a CPL in a LibraryDCP */
+struct LibraryCPL
+{
+	LibraryCPL ()
+		: content_kind (FEATURE)
+		, duration (0)
+	{}
+
+	std::string id;
+	boost::filesystem::path file;
+	std::string annotation_text;
+	std::string content_title_text;
+	ContentKind content_kind;
+	/** duration in frames */
+	int64_t duration;
+	/** IDs of the assets that the CPL's reels use, in order */
+	std::list<std::string> asset_ids;
+};
+
+/** @brief Details of a DCP found by a Library scan */
+struct LibraryDCP
+{
+	boost::filesystem::path directory;
+	boost::optional<Standard> standard;
+	/** the names and modification times of the ASSETMAP and the other XML files
+	 *  in the directory when it was read
+	 */
+	std::map<boost::filesystem::path, std::time_t> xml_files;
+	std::list<LibraryCPL> cpls;
+	std::list<LibraryAsset> assets;
+};
+
+/** @class Library
+ *  @brief An index of all the DCPs under some directories, kept in a file on disk.
+ *
+ *  scan() walks a directory tree on several threads and reads each DCP that it finds
+ *  (lazily, so that MXFs are not opened).  A DCP which is already in the index is only
+ *  read again if its ASSETMAP, PKL, CPLs or other XML files have been added, removed
+ *  or modified since it was last read.
+ */
+class Library : public boost::noncopyable
+{
+public:
+	explicit Library (boost::filesystem::path file);
+
+	void scan (boost::filesystem::path root, int threads = 1);
+	void write () const;
+
+	std::list<LibraryDCP> dcps () const;
+
+	/** @return errors from the last scan, indexed by the directory which caused them */
+	std::map<boost::filesystem::path, std::string> errors () const {
+		return _errors;
+	}
+
+private:
+	/** file that the index is kept in */
+	boost::filesystem::path _file;
+	/** DCPs, indexed by their directory */
+	std::map<boost::filesystem::path, LibraryDCP> _dcps;
+	std::map<boost::filesystem::path, std::string> _errors;
+};
+
+}
+
+#endif
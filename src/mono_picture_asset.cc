@@ -37,6 +37,8 @@
 #include "exceptions.h"
 #include "dcp_assert.h"
 #include "mono_picture_frame.h"
+#include "decode_pipeline.h"
+#include "openjpeg_image.h"
 #include "compose.hpp"
 #include <asdcp/AS_DCP.h>
 #include <asdcp/KM_fileio.h>
@@ -45,6 +47,7 @@ using std::string;
 using std::vector;
 using std::list;
 using std::pair;
+using std::min;
 using boost::shared_ptr;
 using boost::dynamic_pointer_cast;
 using namespace dcp;
@@ -122,45 +125,50 @@ MonoPictureAsset::equals (shared_ptr<const Asset> other, EqualityOptions opt, No
 	shared_ptr<const MonoPictureAsset> other_picture = dynamic_pointer_cast<const MonoPictureAsset> (other);
 	DCP_ASSERT (other_picture);
 
-	bool result = true;
+	bool result = frames_equal (
+		min (_intrinsic_duration, other_picture->intrinsic_duration()),
+		boost::bind (&MonoPictureAsset::frame_comparer, this, other_picture, opt),
+		opt,
+		note
+		);
 
-#ifdef LIBDCP_OPENMP
-#pragma omp parallel for
-#endif
+	if (other_picture->intrinsic_duration() != _intrinsic_duration) {
+		result = false;
+	}
 
-	shared_ptr<MonoPictureAssetReader> reader = start_read ();
-	shared_ptr<MonoPictureAssetReader> other_reader = other_picture->start_read ();
-
-	for (int i = 0; i < _intrinsic_duration; ++i) {
-		if (i >= other_picture->intrinsic_duration()) {
-			result = false;
-		}
-
-		if (result || opt.keep_going) {
-
-			shared_ptr<const MonoPictureFrame> frame_A = reader->get_frame (i);
-			shared_ptr<const MonoPictureFrame> frame_B = other_reader->get_frame (i);
-
-			list<pair<NoteType, string> > notes;
-
-			if (!frame_buffer_equals (
-				    i, opt, bind (&storing_note_handler, boost::ref(notes), _1, _2),
-				    frame_A->j2k_data(), frame_A->j2k_size(),
-				    frame_B->j2k_data(), frame_B->j2k_size()
-				    )) {
-				result = false;
-			}
-
-#ifdef LIBDCP_OPENMP
-#pragma omp critical
-#endif
-			{
-				note (DCP_PROGRESS, String::compose ("Compared video frame %1 of %2", i, _intrinsic_duration));
-				for (list<pair<NoteType, string> >::const_iterator i = notes.begin(); i != notes.end(); ++i) {
-					note (i->first, i->second);
-				}
-			}
-		}
+	return result;
+}
+
+/** @return a FrameComparer, with its own readers, for comparing frames of this asset with frames of another */
+PictureAsset::FrameComparer
+MonoPictureAsset::frame_comparer (shared_ptr<const MonoPictureAsset> other, EqualityOptions opt) const
+{
+	return boost::bind (&MonoPictureAsset::frame_equals, this, start_read(), other->start_read(), opt, _1, _2);
+}
+
+bool
+MonoPictureAsset::frame_equals (
+	shared_ptr<MonoPictureAssetReader> reader,
+	shared_ptr<MonoPictureAssetReader> other_reader,
+	EqualityOptions opt,
+	int64_t frame,
+	NoteHandler note
+	) const
+{
+	shared_ptr<const MonoPictureFrame> frame_A = reader->get_frame (frame);
+	shared_ptr<const MonoPictureFrame> frame_B = other_reader->get_frame (frame);
+
+	list<pair<NoteType, string> > notes;
+
+	bool const result = frame_buffer_equals (
+		frame, opt, bind (&storing_note_handler, boost::ref(notes), _1, _2),
+		frame_A->j2k_data(), frame_A->j2k_size(),
+		frame_B->j2k_data(), frame_B->j2k_size()
+		);
+
+	note (DCP_PROGRESS, String::compose ("Compared video frame %1 of %2", frame, _intrinsic_duration));
+	for (list<pair<NoteType, string> >::const_iterator i = notes.begin(); i != notes.end(); ++i) {
+		note (i->first, i->second);
 	}
 
 	return result;
@@ -179,6 +187,31 @@ MonoPictureAsset::start_read () const
 	return shared_ptr<MonoPictureAssetReader> (new MonoPictureAssetReader (this, key(), standard()));
 }
 
+static shared_ptr<OpenJPEGImage>
+decode_frame (shared_ptr<const MonoPictureFrame> frame, int reduce)
+{
+	return frame->xyz_image (reduce);
+}
+
+/** Decode some frames of this asset using several threads.
+ *  @param from First frame to decode.
+ *  @param to One more than the last frame to decode.
+ *  @param handler Function which will be called, on the calling thread and in order, with each frame index and its image.
+ *  @param threads Number of threads to decode with.
+ *  @param reduce Power of two by which to reduce the resolution of the images, as for MonoPictureFrame::xyz_image.
+ */
+void
+MonoPictureAsset::decode (
+	int64_t from, int64_t to, boost::function<void (int64_t, shared_ptr<OpenJPEGImage>)> handler, int threads, int reduce
+	) const
+{
+	shared_ptr<MonoPictureAssetReader> reader = start_read ();
+	reader->set_pooled (true);
+	decode_frames<ASDCP::JP2K::MXFReader, MonoPictureFrame, shared_ptr<OpenJPEGImage> > (
+		reader, from, to, boost::bind (&decode_frame, _1, reduce), handler, threads
+		);
+}
+
 string
 MonoPictureAsset::cpl_node_name () const
 {
@@ -36,10 +36,12 @@
 
 #include "picture_asset.h"
 #include "mono_picture_asset_reader.h"
+#include <boost/function.hpp>
 
 namespace dcp {
 
 class MonoPictureAssetWriter;
+class OpenJPEGImage;
 
 /** @class MonoPictureAsset
  *  @brief A 2D (monoscopic) picture asset.
@@ -62,6 +64,14 @@ public:
 	boost::shared_ptr<PictureAssetWriter> start_write (boost::filesystem::path, bool);
 	boost::shared_ptr<MonoPictureAssetReader> start_read () const;
 
+	void decode (
+		int64_t from,
+		int64_t to,
+		boost::function<void (int64_t, boost::shared_ptr<OpenJPEGImage>)> handler,
+		int threads,
+		int reduce = 0
+		) const;
+
 	bool equals (
 		boost::shared_ptr<const Asset> other,
 		EqualityOptions opt,
@@ -70,6 +80,15 @@ public:
 
 private:
 	std::string cpl_node_name () const;
+
+	FrameComparer frame_comparer (boost::shared_ptr<const MonoPictureAsset> other, EqualityOptions opt) const;
+	bool frame_equals (
+		boost::shared_ptr<MonoPictureAssetReader> reader,
+		boost::shared_ptr<MonoPictureAssetReader> other_reader,
+		EqualityOptions opt,
+		int64_t frame,
+		NoteHandler note
+		) const;
 };
 
 }
@@ -43,6 +43,7 @@
 #include "compose.hpp"
 #include "j2k.h"
 #include "crypto_context.h"
+#include "frame_pool.h"
 #include <asdcp/KM_fileio.h>
 #include <asdcp/AS_DCP.h>
 
@@ -77,13 +78,29 @@ MonoPictureFrame::MonoPictureFrame (boost::filesystem::path path)
  *  @param reader Reader for the asset's MXF file.
  *  @param n Frame within the asset, not taking EntryPoint into account.
  *  @param c Context for decryption, or 0.
+ *  @param buffer_size Size of buffer to allocate; if it turns out to be too small it will be grown.
+ *  XXX: the default is unfortunate guesswork.
  */
-MonoPictureFrame::MonoPictureFrame (ASDCP::JP2K::MXFReader* reader, int n, shared_ptr<DecryptionContext> c)
+MonoPictureFrame::MonoPictureFrame (ASDCP::JP2K::MXFReader* reader, int n, shared_ptr<DecryptionContext> c, int buffer_size)
 {
-	/* XXX: unfortunate guesswork on this buffer size */
-	_buffer = new ASDCP::JP2K::FrameBuffer (4 * Kumu::Megabyte);
+	_buffer = new ASDCP::JP2K::FrameBuffer (buffer_size);
+	read (reader, n, c);
+}
 
-	ASDCP::Result_t const r = reader->ReadFrame (n, *_buffer, c->context(), c->hmac());
+/** Read a frame from a 2D (monoscopic) asset into this frame's existing buffer,
+ *  replacing whatever was there.
+ *  @param reader Reader for the asset's MXF file.
+ *  @param n Frame within the asset, not taking EntryPoint into account.
+ *  @param c Context for decryption, or 0.
+ */
+void
+MonoPictureFrame::read (ASDCP::JP2K::MXFReader* reader, int n, shared_ptr<DecryptionContext> c)
+{
+	ASDCP::Result_t r = reader->ReadFrame (n, *_buffer, c->context(), c->hmac());
+	while (r == ASDCP::RESULT_SMALLBUF && int (_buffer->Capacity()) < MAX_FRAME_BUFFER_SIZE) {
+		_buffer->Capacity (_buffer->Capacity() * 2);
+		r = reader->ReadFrame (n, *_buffer, c->context(), c->hmac());
+	}
 
 	if (ASDCP_FAILURE (r)) {
 		boost::throw_exception (DCPReadError (String::compose ("could not read video frame %1 (%2)", n, static_cast<int>(r))));
@@ -131,5 +148,5 @@ MonoPictureFrame::j2k_size () const
 shared_ptr<OpenJPEGImage>
 MonoPictureFrame::xyz_image (int reduce) const
 {
-	return decompress_j2k (const_cast<uint8_t*> (_buffer->RoData()), _buffer->Size(), reduce);
+	return decompress_j2k (_buffer->RoData(), _buffer->Size(), reduce);
 }
@@ -40,6 +40,7 @@
 
 #include "types.h"
 #include "asset_reader.h"
+#include <asdcp/KM_fileio.h>
 #include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/filesystem.hpp>
@@ -81,7 +82,8 @@ private:
 	*/
 	friend class AssetReader<ASDCP::JP2K::MXFReader, MonoPictureFrame>;
 
-	MonoPictureFrame (ASDCP::JP2K::MXFReader* reader, int n, boost::shared_ptr<DecryptionContext>);
+	MonoPictureFrame (ASDCP::JP2K::MXFReader* reader, int n, boost::shared_ptr<DecryptionContext>, int buffer_size = 4 * Kumu::Megabyte);
+	void read (ASDCP::JP2K::MXFReader* reader, int n, boost::shared_ptr<DecryptionContext>);
 
 	ASDCP::JP2K::FrameBuffer* _buffer;
 };
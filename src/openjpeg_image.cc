@@ -38,6 +38,7 @@
 #include "openjpeg_image.h"
 #include "dcp_assert.h"
 #include <openjpeg.h>
+#include <boost/throw_exception.hpp>
 #include <stdexcept>
 
 using namespace dcp;
@@ -128,7 +129,7 @@ OpenJPEGImage::create (Size size)
 	/* XXX: is this _SRGB right? */
 	_opj_image = opj_image_create (3, &cmptparm[0], OPJ_CLRSPC_SRGB);
 	if (_opj_image == 0) {
-		throw std::runtime_error ("could not create libopenjpeg image");
+		boost::throw_exception (std::runtime_error ("could not create libopenjpeg image"));
 	}
 
 	_opj_image->x0 = 0;
@@ -0,0 +1,276 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/pcm_simd.cc
+ *  @brief Kernels to pack planar samples into interleaved 24-bit little-endian PCM,
+ *  with SSE2 and AVX2 versions chosen at run time.
+ *
+ *  Samples are first converted to 24-bit values in a block of interleaved int32_ts,
+ *  and that block is then packed to 3 bytes per sample.  The vector versions clip
+ *  and truncate in the same way as the scalar version, so all give identical output.
+ */
+
+#include "pcm_simd.h"
+#include "rgb_xyz_simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LIBDCP_X86_SIMD
+#include <immintrin.h>
+#endif
+
+using std::min;
+using std::max;
+using std::vector;
+using namespace dcp;
+using namespace dcp::simd;
+
+/** Number of sample frames to convert and pack at a time */
+static int const block_frames = 64;
+
+/** Largest float sample that can be represented in 24 bits */
+static float const clip = 1.0f - (1.0f / pow (2, 23));
+
+static void
+convert_float_scalar (float const * const * data, int channels, int offset, int frames, int32_t* out)
+{
+	for (int i = 0; i < frames; ++i) {
+		for (int j = 0; j < channels; ++j) {
+			float x = data[j][offset + i];
+			if (x > clip) {
+				x = clip;
+			} else if (x < -clip) {
+				x = -clip;
+			}
+			*out++ = x * (1 << 23);
+		}
+	}
+}
+
+static void
+convert_int_scalar (int32_t const * const * data, int channels, int offset, int frames, int32_t* out)
+{
+	for (int i = 0; i < frames; ++i) {
+		for (int j = 0; j < channels; ++j) {
+			*out++ = min (max (data[j][offset + i], -(1 << 23)), (1 << 23) - 1);
+		}
+	}
+}
+
+static void
+pack_scalar (int32_t const * in, int samples, uint8_t* out)
+{
+	for (int i = 0; i < samples; ++i) {
+		int32_t const s = in[i];
+		*out++ = (s & 0xff);
+		*out++ = (s & 0xff00) >> 8;
+		*out++ = (s & 0xff0000) >> 16;
+	}
+}
+
+#ifdef LIBDCP_X86_SIMD
+
+/* The minps / maxps operand order here means that a NaN sample passes through both,
+   as it does through the comparisons in the scalar version.
+*/
+
+__attribute__((target("sse2")))
+static void
+convert_float_sse2 (float const * const * data, int channels, int offset, int frames, int32_t* out)
+{
+	__m128 const top = _mm_set1_ps (clip);
+	__m128 const bottom = _mm_set1_ps (-clip);
+	__m128 const scale = _mm_set1_ps (1 << 23);
+
+	int i = 0;
+	for (; i + 4 <= frames; i += 4) {
+		for (int j = 0; j < channels; ++j) {
+			__m128 x = _mm_loadu_ps (data[j] + offset + i);
+			x = _mm_max_ps (bottom, _mm_min_ps (top, x));
+			int32_t s[4];
+			_mm_storeu_si128 (reinterpret_cast<__m128i*> (s), _mm_cvttps_epi32 (_mm_mul_ps (x, scale)));
+			for (int k = 0; k < 4; ++k) {
+				out[(i + k) * channels + j] = s[k];
+			}
+		}
+	}
+
+	convert_float_scalar (data, channels, offset + i, frames - i, out + i * channels);
+}
+
+/** Pack samples 4 at a time by building 3 32-bit words from each 4 samples; x86 is
+ *  little-endian so the words can be stored directly.
+ */
+static void
+pack_words (int32_t const * in, int samples, uint8_t* out)
+{
+	int i = 0;
+	for (; i + 4 <= samples; i += 4) {
+		uint32_t const w[3] = {
+			(uint32_t (in[i]) & 0xffffff) | (uint32_t (in[i + 1]) << 24),
+			((uint32_t (in[i + 1]) >> 8) & 0xffff) | (uint32_t (in[i + 2]) << 16),
+			((uint32_t (in[i + 2]) >> 16) & 0xff) | (uint32_t (in[i + 3]) << 8)
+		};
+		memcpy (out, w, 12);
+		out += 12;
+	}
+
+	pack_scalar (in + i, samples - i, out);
+}
+
+__attribute__((target("avx2")))
+static void
+convert_float_avx2 (float const * const * data, int channels, int offset, int frames, int32_t* out)
+{
+	__m256 const top = _mm256_set1_ps (clip);
+	__m256 const bottom = _mm256_set1_ps (-clip);
+	__m256 const scale = _mm256_set1_ps (1 << 23);
+
+	int i = 0;
+	for (; i + 8 <= frames; i += 8) {
+		for (int j = 0; j < channels; ++j) {
+			__m256 x = _mm256_loadu_ps (data[j] + offset + i);
+			x = _mm256_max_ps (bottom, _mm256_min_ps (top, x));
+			int32_t s[8];
+			_mm256_storeu_si256 (reinterpret_cast<__m256i*> (s), _mm256_cvttps_epi32 (_mm256_mul_ps (x, scale)));
+			for (int k = 0; k < 8; ++k) {
+				out[(i + k) * channels + j] = s[k];
+			}
+		}
+	}
+
+	convert_float_scalar (data, channels, offset + i, frames - i, out + i * channels);
+}
+
+/** Pack samples 8 at a time: a byte shuffle drops the top byte of each sample within
+ *  each 128-bit lane, then a permute moves the two 12-byte results together.
+ */
+__attribute__((target("avx2")))
+static void
+pack_avx2 (int32_t const * in, int samples, uint8_t* out)
+{
+	__m256i const shuffle = _mm256_setr_epi8 (
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+		);
+	__m256i const permute = _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 3, 7);
+
+	int i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		__m256i const s = _mm256_loadu_si256 (reinterpret_cast<__m256i const *> (in + i));
+		__m256i const p = _mm256_permutevar8x32_epi32 (_mm256_shuffle_epi8 (s, shuffle), permute);
+		_mm_storeu_si128 (reinterpret_cast<__m128i*> (out), _mm256_castsi256_si128 (p));
+		_mm_storel_epi64 (reinterpret_cast<__m128i*> (out + 16), _mm256_extracti128_si256 (p, 1));
+		out += 24;
+	}
+
+	pack_scalar (in + i, samples - i, out);
+}
+
+#endif
+
+static void
+pack (int32_t const * in, int samples, uint8_t* out)
+{
+	switch (level ()) {
+#ifdef LIBDCP_X86_SIMD
+	case LEVEL_AVX2:
+		pack_avx2 (in, samples, out);
+		break;
+	case LEVEL_SSE2:
+		pack_words (in, samples, out);
+		break;
+#endif
+	default:
+		pack_scalar (in, samples, out);
+		break;
+	}
+}
+
+/** Convert planar float samples to interleaved 24-bit little-endian PCM.  Samples are
+ *  clipped to just under +/-1.0 and then truncated to 24 bits.
+ *  @param data Samples, indexed by channel and then by sample frame.
+ *  @param channels Number of channels.
+ *  @param offset Index of the first sample frame to convert.
+ *  @param frames Number of sample frames to convert.
+ *  @param out Output buffer, which must have space for 3 * channels * frames bytes.
+ */
+void
+simd::pack_pcm_24 (float const * const * data, int channels, int offset, int frames, uint8_t* out)
+{
+	vector<int32_t> block (block_frames * channels);
+
+	for (int i = 0; i < frames; i += block_frames) {
+		int const n = min (block_frames, frames - i);
+		switch (level ()) {
+#ifdef LIBDCP_X86_SIMD
+		case LEVEL_AVX2:
+			convert_float_avx2 (data, channels, offset + i, n, &block[0]);
+			break;
+		case LEVEL_SSE2:
+			convert_float_sse2 (data, channels, offset + i, n, &block[0]);
+			break;
+#endif
+		default:
+			convert_float_scalar (data, channels, offset + i, n, &block[0]);
+			break;
+		}
+		pack (&block[0], n * channels, out);
+		out += n * channels * 3;
+	}
+}
+
+/** Convert planar 24-bit samples, held in int32_ts, to interleaved 24-bit little-endian PCM.
+ *  Samples outside the 24-bit range are clipped.
+ *  @param data Samples, indexed by channel and then by sample frame.
+ *  @param channels Number of channels.
+ *  @param offset Index of the first sample frame to convert.
+ *  @param frames Number of sample frames to convert.
+ *  @param out Output buffer, which must have space for 3 * channels * frames bytes.
+ */
+void
+simd::pack_pcm_24 (int32_t const * const * data, int channels, int offset, int frames, uint8_t* out)
+{
+	vector<int32_t> block (block_frames * channels);
+
+	for (int i = 0; i < frames; i += block_frames) {
+		int const n = min (block_frames, frames - i);
+		convert_int_scalar (data, channels, offset + i, n, &block[0]);
+		pack (&block[0], n * channels, out);
+		out += n * channels * 3;
+	}
+}
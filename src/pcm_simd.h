@@ -0,0 +1,56 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/pcm_simd.h
+ *  @brief Kernels to pack planar samples into interleaved 24-bit little-endian PCM,
+ *  with SSE2 and AVX2 versions chosen at run time.
+ */
+
+#ifndef LIBDCP_PCM_SIMD_H
+#define LIBDCP_PCM_SIMD_H
+
+#include <stdint.h>
+
+namespace dcp {
+
+namespace simd {
+
+extern void pack_pcm_24 (float const * const * data, int channels, int offset, int frames, uint8_t* out);
+extern void pack_pcm_24 (int32_t const * const * data, int channels, int offset, int frames, uint8_t* out);
+
+}
+
+}
+
+#endif
@@ -39,22 +39,34 @@
 #include "dcp_assert.h"
 #include "compose.hpp"
 #include "j2k.h"
+#include "j2k_codestream.h"
+#include "pixel_diff.h"
 #include <asdcp/AS_DCP.h>
 #include <asdcp/KM_fileio.h>
 #include <libxml++/nodes/element.h>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/exception_ptr.hpp>
 #include <list>
+#include <map>
 #include <stdexcept>
 
 using std::string;
 using std::list;
 using std::vector;
+using std::min;
 using std::max;
 using std::pair;
 using std::make_pair;
+using std::map;
 using boost::shared_ptr;
+using boost::function;
 using namespace dcp;
 
+/** End of the note given for a frame which is accepted after comparing it at reduced resolution */
+static string const reduced_resolution_note = " at reduced resolution";
+
 /** Load a PictureAsset from a file */
 PictureAsset::PictureAsset (boost::filesystem::path file)
 	: Asset (file)
@@ -125,6 +137,31 @@ PictureAsset::descriptor_equals (
 	return true;
 }
 
+/** Decode two JPEG2000 frames and find the differences between their samples.
+ *  @param reduce Power of two by which to reduce the resolution of the decoded images.
+ *  @return false if the images are not the same size.
+ */
+static bool
+image_difference (
+	uint8_t const * data_A, unsigned int size_A, uint8_t const * data_B, unsigned int size_B, int reduce, simd::DiffStats& stats
+	)
+{
+	shared_ptr<OpenJPEGImage> image_A = decompress_j2k (const_cast<uint8_t*> (data_A), size_A, reduce);
+	shared_ptr<OpenJPEGImage> image_B = decompress_j2k (const_cast<uint8_t*> (data_B), size_B, reduce);
+
+	if (image_A->size() != image_B->size()) {
+		return false;
+	}
+
+	/* Compare them in one pass over each component */
+	int const pixels = image_A->size().width * image_A->size().height;
+	for (int c = 0; c < 3; ++c) {
+		simd::accumulate_difference (image_A->data(c), image_B->data(c), pixels, stats);
+	}
+
+	return true;
+}
+
 bool
 PictureAsset::frame_buffer_equals (
 	int frame, EqualityOptions opt, NoteHandler note,
@@ -137,44 +174,57 @@ PictureAsset::frame_buffer_equals (
 		return true;
 	}
 
-	/* Decompress the images to bitmaps */
-	shared_ptr<OpenJPEGImage> image_A = decompress_j2k (const_cast<uint8_t*> (data_A), size_A, 0);
-	shared_ptr<OpenJPEGImage> image_B = decompress_j2k (const_cast<uint8_t*> (data_B), size_B, 0);
-
-	/* Compare them */
-
-	vector<int> abs_diffs (image_A->size().width * image_A->size().height * 3);
-	int d = 0;
-	int max_diff = 0;
+	J2KCodestream const codestream_A (data_A, size_A);
+	J2KCodestream const codestream_B (data_B, size_B);
+	if (codestream_A.valid() && codestream_B.valid()) {
+		vector<int> const tiles = codestream_A.different_tiles (codestream_B);
+		if (tiles.empty ()) {
+			/* Nearly as easy; only markers which don't affect the image (e.g. comments) are different */
+			note (DCP_NOTE, "J2K codestreams differ only in markers which do not affect the image");
+			return true;
+		}
+		note (DCP_NOTE, String::compose ("J2K data differs in %1 tile(s)", tiles.size()));
+	}
 
-	for (int c = 0; c < 3; ++c) {
+	if (opt.reduce > 0) {
+		/* Try a quick comparison at reduced resolution first, with limits which are at
+		   least as strict as the full ones since the reduction hides detail.
+		*/
+		simd::DiffStats stats;
+		bool decoded = false;
+		/* If the frames can't be decoded at this resolution (e.g. reduce is more than the
+		   number of decomposition levels) fall through to full resolution.
+		*/
+		try {
+			decoded = image_difference (data_A, size_A, data_B, size_B, opt.reduce, stats);
+		} catch (DCPReadError &) {
+
+		} catch (MiscError &) {
 
-		if (image_A->size() != image_B->size()) {
-			note (DCP_ERROR, String::compose ("image sizes for frame %1 differ", frame));
-			return false;
 		}
 
-		int const pixels = image_A->size().width * image_A->size().height;
-		for (int j = 0; j < pixels; ++j) {
-			int const t = abs (image_A->data(c)[j] - image_B->data(c)[j]);
-			abs_diffs[d++] = t;
-			max_diff = max (max_diff, t);
+		if (
+			decoded &&
+			stats.mean() <= min (opt.max_reduced_mean_pixel_error, opt.max_mean_pixel_error) &&
+			stats.standard_deviation() <= min (opt.max_reduced_std_dev_pixel_error, opt.max_std_dev_pixel_error)
+			) {
+			/* frames_equal looks for this note to say that the comparison was approximate */
+			note (
+				DCP_NOTE,
+				String::compose ("mean difference %1 deviation %2", stats.mean(), stats.standard_deviation()) + reduced_resolution_note
+				);
+			return true;
 		}
 	}
 
-	uint64_t total = 0;
-	for (vector<int>::iterator j = abs_diffs.begin(); j != abs_diffs.end(); ++j) {
-		total += *j;
-	}
-
-	double const mean = double (total) / abs_diffs.size ();
-
-	uint64_t total_squared_deviation = 0;
-	for (vector<int>::iterator j = abs_diffs.begin(); j != abs_diffs.end(); ++j) {
-		total_squared_deviation += pow (*j - mean, 2);
+	simd::DiffStats stats;
+	if (!image_difference (data_A, size_A, data_B, size_B, 0, stats)) {
+		note (DCP_ERROR, String::compose ("image sizes for frame %1 differ", frame));
+		return false;
 	}
 
-	double const std_dev = sqrt (double (total_squared_deviation) / abs_diffs.size());
+	double const mean = stats.mean ();
+	double const std_dev = stats.standard_deviation ();
 
 	note (DCP_NOTE, String::compose ("mean difference %1 deviation %2", mean, std_dev));
 
@@ -199,6 +249,216 @@ PictureAsset::frame_buffer_equals (
 	return true;
 }
 
+/** The result of comparing one frame in PictureAsset::frames_equal */
+struct FrameResult
+{
+	FrameResult ()
+		: equal (true)
+	{}
+
+	bool equal;
+	list<pair<NoteType, string> > notes;
+	boost::exception_ptr error;
+};
+
+/** State shared between the threads of PictureAsset::frames_equal */
+struct CompareJobs
+{
+	CompareJobs (int64_t frames_, int64_t window_)
+		: frames (frames_)
+		, window (window_)
+		, next (0)
+		, delivered (0)
+		, stop (false)
+	{}
+
+	int64_t const frames;
+	/** maximum number of frames to compare ahead of the first one whose result has not been delivered */
+	int64_t const window;
+
+	/** mutex for everything below */
+	boost::mutex mutex;
+	boost::condition_variable condition;
+	/** next frame to compare */
+	int64_t next;
+	/** number of frames whose results have been delivered */
+	int64_t delivered;
+	/** true to make the threads stop taking new frames */
+	bool stop;
+	/** results which have not yet been delivered, indexed by frame */
+	map<int64_t, FrameResult> done;
+};
+
+static void
+store_note (list<pair<NoteType, string> >* notes, NoteType type, string text)
+{
+	notes->push_back (make_pair (type, text));
+}
+
+/** Note handler for PictureAsset::frames_equal which passes notes on, adding one to say
+ *  that the comparison is approximate before those of the first frame which was accepted
+ *  at reduced resolution.
+ */
+class ApproximateNoteHandler
+{
+public:
+	explicit ApproximateNoteHandler (NoteHandler note)
+		: _note (note)
+		, _noted (false)
+	{}
+
+	void note (NoteType type, string text)
+	{
+		if (
+			!_noted &&
+			text.size() >= reduced_resolution_note.size() &&
+			text.compare (text.size() - reduced_resolution_note.size(), string::npos, reduced_resolution_note) == 0
+			) {
+			_note (DCP_NOTE, "some frames were accepted after comparing them at reduced resolution, so the comparison is approximate");
+			_noted = true;
+		}
+		_note (type, text);
+	}
+
+private:
+	NoteHandler _note;
+	bool _noted;
+};
+
+static void
+compare_thread (CompareJobs* jobs, function<bool (int64_t, NoteHandler)> compare)
+{
+	boost::mutex::scoped_lock lm (jobs->mutex);
+
+	while (true) {
+		while (!jobs->stop && jobs->next < jobs->frames && (jobs->next - jobs->delivered) >= jobs->window) {
+			jobs->condition.wait (lm);
+		}
+
+		if (jobs->stop || jobs->next >= jobs->frames) {
+			return;
+		}
+
+		int64_t const n = jobs->next++;
+		lm.unlock ();
+
+		FrameResult r;
+		try {
+			r.equal = compare (n, boost::bind (&store_note, &r.notes, _1, _2));
+		} catch (...) {
+			r.error = boost::current_exception ();
+		}
+
+		lm.lock ();
+		jobs->done[n] = r;
+		jobs->condition.notify_all ();
+	}
+}
+
+/** Compare some frames of this asset with those of another, using opt.threads threads.
+ *  The notes from each frame are given to the handler on the calling thread, and in
+ *  frame order, so the notes are the same as they would be for a comparison on one thread.
+ *  Unless opt.keep_going is set, the comparison stops at the first frame which differs.
+ *  If any frame is accepted after comparing it at reduced resolution (see EqualityOptions::reduce)
+ *  there is a note to say that the comparison is approximate.
+ *
+ *  @param frames Number of frames to compare, starting from the first.
+ *  @param make_comparer Function to make a FrameComparer; it is called once for each thread,
+ *  on the calling thread, so that each thread can have its own readers.
+ *  @param opt Comparison options.
+ *  @param note Handler for notes.
+ *  @return true if all the frames that were compared are equal.
+ */
+bool
+PictureAsset::frames_equal (
+	int64_t frames, function<FrameComparer ()> make_comparer, EqualityOptions opt, NoteHandler note
+	) const
+{
+	int const threads = std::min (int64_t (max (1, opt.threads)), max (int64_t (1), frames));
+
+	ApproximateNoteHandler approximate (note);
+	note = boost::bind (&ApproximateNoteHandler::note, &approximate, _1, _2);
+
+	if (threads == 1) {
+		FrameComparer compare = make_comparer ();
+		bool result = true;
+		for (int64_t i = 0; i < frames; ++i) {
+			if (!compare (i, note)) {
+				result = false;
+				if (!opt.keep_going) {
+					break;
+				}
+			}
+		}
+		return result;
+	}
+
+	vector<FrameComparer> comparers;
+	for (int i = 0; i < threads; ++i) {
+		comparers.push_back (make_comparer ());
+	}
+
+	CompareJobs jobs (frames, threads * 4);
+
+	boost::thread_group group;
+	for (int i = 0; i < threads; ++i) {
+		group.create_thread (boost::bind (&compare_thread, &jobs, comparers[i]));
+	}
+
+	bool result = true;
+	boost::exception_ptr error;
+
+	try {
+		for (int64_t n = 0; n < frames; ++n) {
+			FrameResult r;
+			{
+				boost::mutex::scoped_lock lm (jobs.mutex);
+				map<int64_t, FrameResult>::iterator i = jobs.done.find (n);
+				while (i == jobs.done.end ()) {
+					jobs.condition.wait (lm);
+					i = jobs.done.find (n);
+				}
+				r = i->second;
+				jobs.done.erase (i);
+				jobs.delivered = n + 1;
+				jobs.condition.notify_all ();
+			}
+
+			for (list<pair<NoteType, string> >::const_iterator i = r.notes.begin(); i != r.notes.end(); ++i) {
+				note (i->first, i->second);
+			}
+
+			if (r.error) {
+				error = r.error;
+				break;
+			}
+
+			if (!r.equal) {
+				result = false;
+				if (!opt.keep_going) {
+					break;
+				}
+			}
+		}
+	} catch (...) {
+		/* The note handler threw */
+		error = boost::current_exception ();
+	}
+
+	{
+		boost::mutex::scoped_lock lm (jobs.mutex);
+		jobs.stop = true;
+		jobs.condition.notify_all ();
+	}
+	group.join_all ();
+
+	if (error) {
+		boost::rethrow_exception (error);
+	}
+
+	return result;
+}
+
 string
 PictureAsset::static_pkl_type (Standard standard)
 {
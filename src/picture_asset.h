@@ -41,6 +41,7 @@
 #include "mxf.h"
 #include "util.h"
 #include "metadata.h"
+#include <boost/function.hpp>
 
 namespace ASDCP {
 	namespace JP2K {
@@ -107,6 +108,18 @@ protected:
 	friend class MonoPictureAssetWriter;
 	friend class StereoPictureAssetWriter;
 
+	/** Function which compares frame n of one asset with frame n of another and
+	 *  gives any notes to a handler.  It returns true if the frames are equal.
+	 */
+	typedef boost::function<bool (int64_t, NoteHandler)> FrameComparer;
+
+	bool frames_equal (
+		int64_t frames,
+		boost::function<FrameComparer ()> make_comparer,
+		EqualityOptions opt,
+		NoteHandler note
+		) const;
+
 	bool frame_buffer_equals (
 		int frame, EqualityOptions opt, NoteHandler note,
 		uint8_t const * data_A, unsigned int size_A, uint8_t const * data_B, unsigned int size_B
@@ -0,0 +1,209 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/pixel_diff.cc
+ *  @brief Statistics of the differences between two images' samples, with SSE2
+ *  and AVX2 versions chosen at run time.
+ *
+ *  Samples are expected to be JPEG2000 decoder output, so the differences
+ *  between them are assumed to fit in 31 bits.  All versions accumulate in
+ *  64-bit integers and so give identical results.
+ */
+
+#include "pixel_diff.h"
+#include "rgb_xyz_simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LIBDCP_X86_SIMD
+#include <immintrin.h>
+#endif
+
+using std::max;
+using namespace dcp;
+using namespace dcp::simd;
+
+/** @return mean of the absolute differences */
+double
+DiffStats::mean () const
+{
+	if (count == 0) {
+		return 0;
+	}
+
+	return double (sum) / count;
+}
+
+/** @return standard deviation of the absolute differences */
+double
+DiffStats::standard_deviation () const
+{
+	if (count == 0) {
+		return 0;
+	}
+
+	double const m = mean ();
+	return sqrt (std::max (0.0, double (sum_of_squares) / count - m * m));
+}
+
+static void
+accumulate_difference_scalar (int const * a, int const * b, int n, DiffStats& stats)
+{
+	for (int i = 0; i < n; ++i) {
+		int const d = abs (a[i] - b[i]);
+		stats.max = max (stats.max, d);
+		stats.sum += d;
+		stats.sum_of_squares += uint64_t (d) * d;
+	}
+
+	stats.count += n;
+}
+
+#ifdef LIBDCP_X86_SIMD
+
+/* SSE2: 4 samples per iteration.  There is no 32-bit abs or max, so those are
+   done with shifts and compares; the squares come from _mm_mul_epu32, which
+   multiplies the even 32-bit lanes into 64-bit results, so the odd lanes are
+   shifted down and multiplied separately.
+*/
+
+__attribute__((target("sse2")))
+static void
+accumulate_difference_sse2 (int const * a, int const * b, int n, DiffStats& stats)
+{
+	__m128i const low = _mm_set_epi32 (0, -1, 0, -1);
+	__m128i max_diff = _mm_setzero_si128 ();
+	__m128i sum = _mm_setzero_si128 ();
+	__m128i squares = _mm_setzero_si128 ();
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i const d = _mm_sub_epi32 (
+			_mm_loadu_si128 (reinterpret_cast<__m128i const *> (a + i)),
+			_mm_loadu_si128 (reinterpret_cast<__m128i const *> (b + i))
+			);
+		__m128i const sign = _mm_srai_epi32 (d, 31);
+		__m128i const abs_d = _mm_sub_epi32 (_mm_xor_si128 (d, sign), sign);
+		__m128i const greater = _mm_cmpgt_epi32 (abs_d, max_diff);
+		max_diff = _mm_or_si128 (_mm_and_si128 (greater, abs_d), _mm_andnot_si128 (greater, max_diff));
+		__m128i const odd = _mm_srli_epi64 (abs_d, 32);
+		sum = _mm_add_epi64 (sum, _mm_add_epi64 (_mm_and_si128 (abs_d, low), odd));
+		squares = _mm_add_epi64 (squares, _mm_add_epi64 (_mm_mul_epu32 (abs_d, abs_d), _mm_mul_epu32 (odd, odd)));
+	}
+
+	int m[4];
+	uint64_t s[2];
+	uint64_t q[2];
+	_mm_storeu_si128 (reinterpret_cast<__m128i*> (m), max_diff);
+	_mm_storeu_si128 (reinterpret_cast<__m128i*> (s), sum);
+	_mm_storeu_si128 (reinterpret_cast<__m128i*> (q), squares);
+
+	stats.max = max (max (stats.max, max (m[0], m[1])), max (m[2], m[3]));
+	stats.sum += s[0] + s[1];
+	stats.sum_of_squares += q[0] + q[1];
+	stats.count += i;
+
+	accumulate_difference_scalar (a + i, b + i, n - i, stats);
+}
+
+/* AVX2: 8 samples per iteration */
+
+__attribute__((target("avx2")))
+static void
+accumulate_difference_avx2 (int const * a, int const * b, int n, DiffStats& stats)
+{
+	__m256i const low = _mm256_set1_epi64x (0xffffffff);
+	__m256i max_diff = _mm256_setzero_si256 ();
+	__m256i sum = _mm256_setzero_si256 ();
+	__m256i squares = _mm256_setzero_si256 ();
+
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i const abs_d = _mm256_abs_epi32 (
+			_mm256_sub_epi32 (
+				_mm256_loadu_si256 (reinterpret_cast<__m256i const *> (a + i)),
+				_mm256_loadu_si256 (reinterpret_cast<__m256i const *> (b + i))
+				)
+			);
+		max_diff = _mm256_max_epi32 (max_diff, abs_d);
+		__m256i const odd = _mm256_srli_epi64 (abs_d, 32);
+		sum = _mm256_add_epi64 (sum, _mm256_add_epi64 (_mm256_and_si256 (abs_d, low), odd));
+		squares = _mm256_add_epi64 (squares, _mm256_add_epi64 (_mm256_mul_epu32 (abs_d, abs_d), _mm256_mul_epu32 (odd, odd)));
+	}
+
+	int m[8];
+	uint64_t s[4];
+	uint64_t q[4];
+	_mm256_storeu_si256 (reinterpret_cast<__m256i*> (m), max_diff);
+	_mm256_storeu_si256 (reinterpret_cast<__m256i*> (s), sum);
+	_mm256_storeu_si256 (reinterpret_cast<__m256i*> (q), squares);
+
+	for (int j = 0; j < 8; ++j) {
+		stats.max = max (stats.max, m[j]);
+	}
+	stats.sum += s[0] + s[1] + s[2] + s[3];
+	stats.sum_of_squares += q[0] + q[1] + q[2] + q[3];
+	stats.count += i;
+
+	accumulate_difference_scalar (a + i, b + i, n - i, stats);
+}
+
+#endif
+
+/** Add the absolute differences between two runs of samples to some statistics,
+ *  in one pass and without any intermediate buffer.
+ *  @param a First samples.
+ *  @param b Second samples.
+ *  @param n Number of samples in each of a and b.
+ *  @param stats Statistics to add to.
+ */
+void
+simd::accumulate_difference (int const * a, int const * b, int n, DiffStats& stats)
+{
+	switch (level ()) {
+#ifdef LIBDCP_X86_SIMD
+	case LEVEL_AVX2:
+		accumulate_difference_avx2 (a, b, n, stats);
+		break;
+	case LEVEL_SSE2:
+		accumulate_difference_sse2 (a, b, n, stats);
+		break;
+#endif
+	default:
+		accumulate_difference_scalar (a, b, n, stats);
+		break;
+	}
+}
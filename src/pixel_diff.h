@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/pixel_diff.h
+ *  @brief Statistics of the differences between two images' samples, with SSE2
+ *  and AVX2 versions chosen at run time.
+ */
+
+#ifndef LIBDCP_PIXEL_DIFF_H
+#define LIBDCP_PIXEL_DIFF_H
+
+#include <stdint.h>
+
+namespace dcp {
+
+namespace simd {
+
+/** @class DiffStats
+ *  @brief Running totals of the absolute differences between pairs of samples.
+ *
+ *  The totals are exact integers, so the result does not depend on the order
+ *  in which samples are added nor on which version of the kernel is used.
+ */
+class DiffStats
+{
+public:
+	DiffStats ()
+		: count (0)
+		, sum (0)
+		, sum_of_squares (0)
+		, max (0)
+	{}
+
+	double mean () const;
+	double standard_deviation () const;
+
+	/** number of pairs of samples */
+	uint64_t count;
+	/** sum of the absolute differences */
+	uint64_t sum;
+	/** sum of the squares of the differences */
+	uint64_t sum_of_squares;
+	/** largest absolute difference */
+	int max;
+};
+
+extern void accumulate_difference (int const * a, int const * b, int n, DiffStats& stats);
+
+}
+
+}
+
+#endif
@@ -41,6 +41,7 @@
 #include <iostream>
 
 using std::string;
+using std::make_pair;
 using boost::shared_ptr;
 using namespace dcp;
 
@@ -67,14 +68,30 @@ PKL::PKL (boost::filesystem::path file)
 	_creator = pkl.string_child ("Creator");
 
 	BOOST_FOREACH (cxml::ConstNodePtr i, pkl.node_child("AssetList")->node_children("Asset")) {
-		_asset_list.push_back (shared_ptr<Asset> (new Asset (i)));
+		add (shared_ptr<Asset> (new Asset (i)));
 	}
 }
 
 void
 PKL::add_asset (std::string id, boost::optional<std::string> annotation_text, std::string hash, int64_t size, std::string type)
 {
-	_asset_list.push_back (shared_ptr<Asset> (new Asset (id, annotation_text, hash, size, type)));
+	add (shared_ptr<Asset> (new Asset (id, annotation_text, hash, size, type)));
+}
+
+void
+PKL::add (shared_ptr<Asset> asset)
+{
+	_asset_list.push_back (asset);
+	/* As with a search of _asset_list, the first asset with a given ID is the one that is found */
+	_asset_index.insert (make_pair (asset->id(), asset));
+}
+
+shared_ptr<PKL::Asset>
+PKL::find (string id) const
+{
+	boost::unordered_map<string, shared_ptr<Asset> >::const_iterator i = _asset_index.find (id);
+	DCP_ASSERT (i != _asset_index.end ());
+	return i->second;
 }
 
 void
@@ -118,23 +135,11 @@ PKL::write (boost::filesystem::path file, shared_ptr<const CertificateChain> sig
 string
 PKL::hash (string id) const
 {
-	BOOST_FOREACH (shared_ptr<Asset> i, _asset_list) {
-		if (i->id() == id) {
-			return i->hash;
-		}
-	}
-
-	DCP_ASSERT (false);
+	return find(id)->hash;
 }
 
 string
 PKL::type (string id) const
 {
-	BOOST_FOREACH (shared_ptr<Asset> i, _asset_list) {
-		if (i->id() == id) {
-			return i->type;
-		}
-	}
-
-	DCP_ASSERT (false);
+	return find(id)->type;
 }
@@ -40,6 +40,7 @@
 #include "certificate_chain.h"
 #include <libcxml/cxml.h>
 #include <boost/filesystem.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace dcp {
 
@@ -93,12 +94,17 @@ private:
 		std::string type;
 	};
 
+	void add (boost::shared_ptr<Asset> asset);
+	boost::shared_ptr<Asset> find (std::string id) const;
+
 	Standard _standard;
 	boost::optional<std::string> _annotation_text;
 	std::string _issue_date;
 	std::string _issuer;
 	std::string _creator;
 	std::list<boost::shared_ptr<Asset> > _asset_list;
+	/** The assets in _asset_list, indexed by ID */
+	boost::unordered_map<std::string, boost::shared_ptr<Asset> > _asset_index;
 };
 
 }
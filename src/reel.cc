@@ -267,6 +267,12 @@ Reel::add (shared_ptr<ReelAsset> asset)
 
 void
 Reel::resolve_refs (list<shared_ptr<Asset> > assets)
+{
+	resolve_refs (AssetIndex (assets));
+}
+
+void
+Reel::resolve_refs (AssetIndex const & assets)
 {
 	if (_main_picture) {
 		_main_picture->asset_ref().resolve (assets);
@@ -279,11 +285,13 @@ Reel::resolve_refs (list<shared_ptr<Asset> > assets)
 	if (_main_subtitle) {
 		_main_subtitle->asset_ref().resolve (assets);
 
-		/* Interop subtitle handling is all special cases */
-		if (_main_subtitle->asset_ref().resolved()) {
+		/* Interop subtitle handling is all special cases.  Interop subtitles are XML so
+		   they are never loaded lazily; don't load SMPTE MXFs just to find that out.
+		*/
+		if (_main_subtitle->asset_ref().has_asset()) {
 			shared_ptr<InteropSubtitleAsset> iop = dynamic_pointer_cast<InteropSubtitleAsset> (_main_subtitle->asset_ref().asset());
 			if (iop) {
-				iop->resolve_fonts (assets);
+				iop->resolve_fonts (assets.fonts ());
 			}
 		}
 	}
@@ -291,11 +299,11 @@ Reel::resolve_refs (list<shared_ptr<Asset> > assets)
 	BOOST_FOREACH (shared_ptr<ReelClosedCaptionAsset> i, _closed_captions) {
 		i->asset_ref().resolve(assets);
 
-		/* Interop subtitle handling is all special cases */
-		if (i->asset_ref().resolved()) {
+		/* As above */
+		if (i->asset_ref().has_asset()) {
 			shared_ptr<InteropSubtitleAsset> iop = dynamic_pointer_cast<InteropSubtitleAsset> (i->asset_ref().asset());
 			if (iop) {
-				iop->resolve_fonts (assets);
+				iop->resolve_fonts (assets.fonts ());
 			}
 		}
 	}
@@ -113,6 +113,7 @@ public:
 	void add (DecryptedKDM const &);
 
 	void resolve_refs (std::list<boost::shared_ptr<Asset> >);
+	void resolve_refs (AssetIndex const & assets);
 
 private:
 	boost::shared_ptr<ReelPictureAsset> _main_picture;
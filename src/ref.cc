@@ -41,14 +41,34 @@ using namespace dcp;
  *  which matches the ID of this one.
  */
 void
-Ref::resolve (list<shared_ptr<Asset> > assets)
+Ref::resolve (list<shared_ptr<Asset> > const & assets)
 {
-	list<shared_ptr<Asset> >::iterator i = assets.begin();
+	list<shared_ptr<Asset> >::const_iterator i = assets.begin();
 	while (i != assets.end() && !ids_equal ((*i)->id(), _id)) {
 		++i;
 	}
 
 	if (i != assets.end ()) {
 		_asset = *i;
+		_loader = AssetIndex::Loader ();
+	}
+}
+
+/** Look up the ID of this asset in an index and copy a shared_ptr to
+ *  the matching asset, or the function which will load it, if there is one.
+ */
+void
+Ref::resolve (AssetIndex const & assets)
+{
+	shared_ptr<Asset> a = assets.find (_id);
+	if (a) {
+		_asset = a;
+		_loader = AssetIndex::Loader ();
+		return;
+	}
+
+	AssetIndex::Loader l = assets.find_loader (_id);
+	if (l) {
+		_loader = l;
 	}
 }
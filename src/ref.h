@@ -41,7 +41,9 @@
 #include "exceptions.h"
 #include "asset.h"
 #include "util.h"
+#include "asset_index.h"
 #include <boost/shared_ptr.hpp>
+#include <boost/throw_exception.hpp>
 #include <string>
 
 namespace dcp {
@@ -77,7 +79,8 @@ public:
 		_id = id;
 	}
 
-	void resolve (std::list<boost::shared_ptr<Asset> > assets);
+	void resolve (std::list<boost::shared_ptr<Asset> > const & assets);
+	void resolve (AssetIndex const & assets);
 
 	/** @return the ID of the thing that we are pointing to */
 	std::string id () const {
@@ -85,35 +88,48 @@ public:
 	}
 
 	/** @return a shared_ptr to the thing; an UnresolvedRefError is thrown
-	 *  if the shared_ptr is not known.
+	 *  if the shared_ptr is not known.  If the thing has been resolved to a
+	 *  loader it will be loaded now, if it has not been already, and any
+	 *  error in loading it will be thrown.
 	 */
 	boost::shared_ptr<Asset> asset () const {
-		if (!_asset) {
-			throw UnresolvedRefError (_id);
+		if (_asset) {
+			return _asset;
+		}
+
+		if (!_loader) {
+			boost::throw_exception (UnresolvedRefError (_id));
 		}
 
-		return _asset;
+		return _loader ();
 	}
 
 	/** operator-> to access the shared_ptr; an UnresolvedRefError is thrown
 	 *  if the shared_ptr is not known.
 	 */
 	Asset * operator->() const {
-		if (!_asset) {
-			throw UnresolvedRefError (_id);
-		}
-
-		return _asset.get ();
+		return asset().get ();
 	}
 
-	/** @return true if a shared_ptr is known for this Ref */
+	/** @return true if a shared_ptr, or a way to load one, is known for this Ref */
 	bool resolved () const {
-		return static_cast<bool>(_asset);
+		return _asset || _loader;
+	}
+
+	/** @return true if a shared_ptr is known for this Ref, so that asset() will not
+	 *  need to load anything.
+	 */
+	bool has_asset () const {
+		return static_cast<bool> (_asset);
 	}
 
 private:
 	std::string _id;             ///< ID; will always be known
 	boost::shared_ptr<Asset> _asset; ///< shared_ptr to the thing, may be null.
+	/** function to load the thing if _asset is null, which must keep the thing alive once it has
+	 *  been loaded; may be empty.
+	 */
+	AssetIndex::Loader _loader;
 };
 
 }
@@ -32,22 +32,27 @@
 */
 
 #include "rgb_xyz.h"
+#include "rgb_xyz_simd.h"
 #include "openjpeg_image.h"
 #include "colour_conversion.h"
+#include "colour_conversion_plan.h"
 #include "transfer_function.h"
 #include "dcp_assert.h"
 #include "compose.hpp"
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 #include <cmath>
+#include <numeric>
 
 using std::min;
 using std::max;
 using std::cout;
+using std::vector;
+using std::accumulate;
 using boost::shared_ptr;
 using boost::optional;
 using namespace dcp;
 
-#define DCI_COEFFICIENT (48.0 / 52.37)
-
 /** Convert an XYZ image to RGBA.
  *  @param xyz_image Image in XYZ.
  *  @param conversion Colour conversion to use.
@@ -71,71 +76,129 @@ dcp::xyz_to_rgba (
 	int stride
 	)
 {
-	int const max_colour = pow (2, 16) - 1;
+	xyz_to_rgba (xyz_image, conversion, argb, stride, 1);
+}
 
-	struct {
-		double x, y, z;
-	} s;
+static void
+run_band (boost::function<int (int, int)> band, int y_start, int y_end, int* count)
+{
+	*count = band (y_start, y_end);
+}
 
-	struct {
-		double r, g, b;
-	} d;
+/** Run a function over horizontal bands of an image, one band per thread.
+ *  The first band is done by the calling thread.
+ *  @param height Image height in pixels.
+ *  @param threads Number of threads to use.
+ *  @param band Function taking the first and one-past-the-last row of a band, and returning
+ *  a count (of clamped values, or similar).
+ *  @return Sum of the counts returned by band.
+ */
+static int
+in_bands (int height, int threads, boost::function<int (int, int)> band)
+{
+	int const bands = max (1, min (threads, height));
+	vector<int> counts (bands, 0);
 
-	int* xyz_x = xyz_image->data (0);
-	int* xyz_y = xyz_image->data (1);
-	int* xyz_z = xyz_image->data (2);
+	boost::thread_group group;
+	for (int i = 1; i < bands; ++i) {
+		group.create_thread (boost::bind (&run_band, band, i * height / bands, (i + 1) * height / bands, &counts[i]));
+	}
 
-	double const * lut_in = conversion.out()->lut (12, false);
-	double const * lut_out = conversion.in()->lut (16, true);
-	boost::numeric::ublas::matrix<double> const matrix = conversion.xyz_to_rgb ();
+	run_band (band, 0, height / bands, &counts[0]);
+	group.join_all ();
 
-	double fast_matrix[9] = {
-		matrix (0, 0), matrix (0, 1), matrix (0, 2),
-		matrix (1, 0), matrix (1, 1), matrix (1, 2),
-		matrix (2, 0), matrix (2, 1), matrix (2, 2)
-	};
+	return accumulate (counts.begin(), counts.end(), 0);
+}
 
-	int const height = xyz_image->size().height;
+static int
+xyz_to_rgba_band (
+	simd::XYZToRGBTables const & tables, OpenJPEGImage const * xyz_image, uint8_t* argb, int stride, int y_start, int y_end
+	)
+{
 	int const width = xyz_image->size().width;
+	int const offset = y_start * width;
+	int* xyz_x = xyz_image->data (0) + offset;
+	int* xyz_y = xyz_image->data (1) + offset;
+	int* xyz_z = xyz_image->data (2) + offset;
+	argb += y_start * stride;
+
+	int out_of_range = 0;
+	for (int y = y_start; y < y_end; ++y) {
+		out_of_range += simd::xyz_to_rgba_row (tables, xyz_x, xyz_y, xyz_z, width, argb);
+		xyz_x += width;
+		xyz_y += width;
+		xyz_z += width;
+		argb += stride;
+	}
 
-	for (int y = 0; y < height; ++y) {
-		uint8_t* argb_line = argb;
-		for (int x = 0; x < width; ++x) {
-
-			DCP_ASSERT (*xyz_x >= 0 && *xyz_y >= 0 && *xyz_z >= 0 && *xyz_x < 4096 && *xyz_y < 4096 && *xyz_z < 4096);
-
-			/* In gamma LUT */
-			s.x = lut_in[*xyz_x++];
-			s.y = lut_in[*xyz_y++];
-			s.z = lut_in[*xyz_z++];
-
-			/* DCI companding */
-			s.x /= DCI_COEFFICIENT;
-			s.y /= DCI_COEFFICIENT;
-			s.z /= DCI_COEFFICIENT;
+	return out_of_range;
+}
 
-			/* XYZ to RGB */
-			d.r = ((s.x * fast_matrix[0]) + (s.y * fast_matrix[1]) + (s.z * fast_matrix[2]));
-			d.g = ((s.x * fast_matrix[3]) + (s.y * fast_matrix[4]) + (s.z * fast_matrix[5]));
-			d.b = ((s.x * fast_matrix[6]) + (s.y * fast_matrix[7]) + (s.z * fast_matrix[8]));
+static void
+xyz_to_rgba (
+	shared_ptr<const OpenJPEGImage> xyz_image, simd::XYZToRGBTables const & tables, uint8_t* argb, int stride, int threads
+	)
+{
+	int const out_of_range = in_bands (
+		xyz_image->size().height, threads,
+		boost::bind (&xyz_to_rgba_band, boost::cref (tables), xyz_image.get(), argb, stride, _1, _2)
+		);
 
-			d.r = min (d.r, 1.0);
-			d.r = max (d.r, 0.0);
+	/* All XYZ values should be 12-bit */
+	DCP_ASSERT (out_of_range == 0);
+}
 
-			d.g = min (d.g, 1.0);
-			d.g = max (d.g, 0.0);
+/** Convert an XYZ image to RGBA, using multiple threads.  Parameters are as
+ *  for the single-threaded version, except:
+ *  @param threads Number of threads to use; the image is split into this many horizontal bands.
+ */
+void
+dcp::xyz_to_rgba (
+	boost::shared_ptr<const OpenJPEGImage> xyz_image,
+	ColourConversion const & conversion,
+	uint8_t* argb,
+	int stride,
+	int threads
+	)
+{
+	::xyz_to_rgba (xyz_image, simd::XYZToRGBTables (conversion, simd::XYZToRGBTables::BGRA), argb, stride, threads);
+}
 
-			d.b = min (d.b, 1.0);
-			d.b = max (d.b, 0.0);
+/** Convert an XYZ image to RGBA using a pre-built plan; parameters are otherwise as
+ *  for the version which takes a ColourConversion.
+ */
+void
+dcp::xyz_to_rgba (
+	boost::shared_ptr<const OpenJPEGImage> xyz_image,
+	ColourConversionPlan const & plan,
+	uint8_t* argb,
+	int stride
+	)
+{
+	::xyz_to_rgba (xyz_image, plan.xyz_to_rgba (), argb, stride, 1);
+}
 
-			/* Out gamma LUT */
-			*argb_line++ = lut_out[lrint(d.b * max_colour)] * 0xff;
-			*argb_line++ = lut_out[lrint(d.g * max_colour)] * 0xff;
-			*argb_line++ = lut_out[lrint(d.r * max_colour)] * 0xff;
-			*argb_line++ = 0xff;
-		}
+/** Convert an XYZ image to RGBA using a pre-built plan and multiple threads; parameters are otherwise as
+ *  for the version which takes a ColourConversion.
+ */
+void
+dcp::xyz_to_rgba (
+	boost::shared_ptr<const OpenJPEGImage> xyz_image,
+	ColourConversionPlan const & plan,
+	uint8_t* argb,
+	int stride,
+	int threads
+	)
+{
+	::xyz_to_rgba (xyz_image, plan.xyz_to_rgba (), argb, stride, threads);
+}
 
-		argb += stride;
+/** Note any XYZ sample which is outside the 12-bit range */
+static void
+note_if_out_of_range (int v, NoteHandler note)
+{
+	if (v < 0 || v > 4095) {
+		note (DCP_NOTE, String::compose ("XYZ value %1 out of range", v));
 	}
 }
 
@@ -157,90 +220,120 @@ dcp::xyz_to_rgb (
 	optional<NoteHandler> note
 	)
 {
-	struct {
-		double x, y, z;
-	} s;
-
-	struct {
-		double r, g, b;
-	} d;
+	xyz_to_rgb (xyz_image, conversion, rgb, stride, 1, note);
+}
 
+/** @param rows_clamped Filled in with 1 for each row in which values were clamped */
+static int
+xyz_to_rgb_band (
+	simd::XYZToRGBTables const & tables, OpenJPEGImage const * xyz_image, uint8_t* rgb, int stride, uint8_t* rows_clamped, int y_start, int y_end
+	)
+{
+	int const width = xyz_image->size().width;
+	int const offset = y_start * width;
 	/* These should be 12-bit values from 0-4095 */
-	int* xyz_x = xyz_image->data (0);
-	int* xyz_y = xyz_image->data (1);
-	int* xyz_z = xyz_image->data (2);
+	int* xyz_x = xyz_image->data (0) + offset;
+	int* xyz_y = xyz_image->data (1) + offset;
+	int* xyz_z = xyz_image->data (2) + offset;
 
-	double const * lut_in = conversion.out()->lut (12, false);
-	double const * lut_out = conversion.in()->lut (16, true);
-	boost::numeric::ublas::matrix<double> const matrix = conversion.xyz_to_rgb ();
+	int out_of_range = 0;
+	for (int y = y_start; y < y_end; ++y) {
+		uint16_t* rgb_line = reinterpret_cast<uint16_t*> (rgb + y * stride);
+		int const n = simd::xyz_to_rgb_row (tables, xyz_x, xyz_y, xyz_z, width, rgb_line);
+		rows_clamped[y] = n > 0;
+		out_of_range += n;
+		xyz_x += width;
+		xyz_y += width;
+		xyz_z += width;
+	}
 
-	double fast_matrix[9] = {
-		matrix (0, 0), matrix (0, 1), matrix (0, 2),
-		matrix (1, 0), matrix (1, 1), matrix (1, 2),
-		matrix (2, 0), matrix (2, 1), matrix (2, 2)
-	};
+	return out_of_range;
+}
 
+static void
+xyz_to_rgb (
+	shared_ptr<const OpenJPEGImage> xyz_image,
+	simd::XYZToRGBTables const & tables,
+	uint8_t* rgb,
+	int stride,
+	int threads,
+	optional<NoteHandler> note
+	)
+{
 	int const height = xyz_image->size().height;
 	int const width = xyz_image->size().width;
 
-	for (int y = 0; y < height; ++y) {
-		uint16_t* rgb_line = reinterpret_cast<uint16_t*> (rgb + y * stride);
-		for (int x = 0; x < width; ++x) {
-
-			int cx = *xyz_x++;
-			int cy = *xyz_y++;
-			int cz = *xyz_z++;
-
-			if (cx < 0 || cx > 4095) {
-				if (note) {
-					note.get() (DCP_NOTE, String::compose ("XYZ value %1 out of range", cx));
-				}
-				cx = max (min (cx, 4095), 0);
-			}
-
-			if (cy < 0 || cy > 4095) {
-				if (note) {
-					note.get() (DCP_NOTE, String::compose ("XYZ value %1 out of range", cy));
-				}
-				cy = max (min (cy, 4095), 0);
-			}
-
-			if (cz < 0 || cz > 4095) {
-				if (note) {
-					note.get() (DCP_NOTE, String::compose ("XYZ value %1 out of range", cz));
-				}
-				cz = max (min (cz, 4095), 0);
-			}
-
-			/* In gamma LUT */
-			s.x = lut_in[cx];
-			s.y = lut_in[cy];
-			s.z = lut_in[cz];
-
-			/* DCI companding */
-			s.x /= DCI_COEFFICIENT;
-			s.y /= DCI_COEFFICIENT;
-			s.z /= DCI_COEFFICIENT;
+	vector<uint8_t> rows_clamped (height);
+	int const out_of_range = in_bands (
+		height, threads,
+		boost::bind (&xyz_to_rgb_band, boost::cref (tables), xyz_image.get(), rgb, stride, &rows_clamped[0], _1, _2)
+		);
 
-			/* XYZ to RGB */
-			d.r = ((s.x * fast_matrix[0]) + (s.y * fast_matrix[1]) + (s.z * fast_matrix[2]));
-			d.g = ((s.x * fast_matrix[3]) + (s.y * fast_matrix[4]) + (s.z * fast_matrix[5]));
-			d.b = ((s.x * fast_matrix[6]) + (s.y * fast_matrix[7]) + (s.z * fast_matrix[8]));
+	if (!out_of_range || !note) {
+		return;
+	}
 
-			d.r = min (d.r, 1.0);
-			d.r = max (d.r, 0.0);
+	/* Some values were clamped; go back and find them so that we can report them in order */
+	for (int y = 0; y < height; ++y) {
+		if (!rows_clamped[y]) {
+			continue;
+		}
+		int const offset = y * width;
+		for (int x = offset; x < offset + width; ++x) {
+			note_if_out_of_range (xyz_image->data(0)[x], note.get ());
+			note_if_out_of_range (xyz_image->data(1)[x], note.get ());
+			note_if_out_of_range (xyz_image->data(2)[x], note.get ());
+		}
+	}
+}
 
-			d.g = min (d.g, 1.0);
-			d.g = max (d.g, 0.0);
+/** Convert an XYZ image to 48bpp RGB, using multiple threads.  Parameters are as
+ *  for the single-threaded version, except:
+ *  @param threads Number of threads to use; the image is split into this many horizontal bands.
+ *  Any notes are made from the calling thread.
+ */
+void
+dcp::xyz_to_rgb (
+	shared_ptr<const OpenJPEGImage> xyz_image,
+	ColourConversion const & conversion,
+	uint8_t* rgb,
+	int stride,
+	int threads,
+	optional<NoteHandler> note
+	)
+{
+	::xyz_to_rgb (xyz_image, simd::XYZToRGBTables (conversion, simd::XYZToRGBTables::RGB48), rgb, stride, threads, note);
+}
 
-			d.b = min (d.b, 1.0);
-			d.b = max (d.b, 0.0);
+/** Convert an XYZ image to 48bpp RGB using a pre-built plan; parameters are otherwise as
+ *  for the version which takes a ColourConversion.
+ */
+void
+dcp::xyz_to_rgb (
+	shared_ptr<const OpenJPEGImage> xyz_image,
+	ColourConversionPlan const & plan,
+	uint8_t* rgb,
+	int stride,
+	optional<NoteHandler> note
+	)
+{
+	::xyz_to_rgb (xyz_image, plan.xyz_to_rgb (), rgb, stride, 1, note);
+}
 
-			*rgb_line++ = lrint(lut_out[lrint(d.r * 65535)] * 65535);
-			*rgb_line++ = lrint(lut_out[lrint(d.g * 65535)] * 65535);
-			*rgb_line++ = lrint(lut_out[lrint(d.b * 65535)] * 65535);
-		}
-	}
+/** Convert an XYZ image to 48bpp RGB using a pre-built plan and multiple threads; parameters
+ *  are otherwise as for the version which takes a ColourConversion.
+ */
+void
+dcp::xyz_to_rgb (
+	shared_ptr<const OpenJPEGImage> xyz_image,
+	ColourConversionPlan const & plan,
+	uint8_t* rgb,
+	int stride,
+	int threads,
+	optional<NoteHandler> note
+	)
+{
+	::xyz_to_rgb (xyz_image, plan.xyz_to_rgb (), rgb, stride, threads, note);
 }
 
 /** @param conversion Colour conversion.
@@ -272,23 +365,9 @@ dcp::combined_rgb_to_xyz (ColourConversion const & conversion, double* matrix)
 		* DCI_COEFFICIENT * 65535;
 }
 
-/** @param rgb RGB data; packed RGB 16:16:16, 48bpp, 16R, 16G, 16B,
- *  with the 2-byte value for each R/G/B component stored as
- *  little-endian; i.e. AV_PIX_FMT_RGB48LE.
- *  @param size size of RGB image in pixels.
- *  @param size stride of RGB data in pixels.
- */
-shared_ptr<dcp::OpenJPEGImage>
-dcp::rgb_to_xyz (
-	uint8_t const * rgb,
-	dcp::Size size,
-	int stride,
-	ColourConversion const & conversion,
-	optional<NoteHandler> note
-	)
+static int
+rgb_to_xyz_band (uint8_t const * rgb, int stride, simd::RGBToXYZTables const & tables, OpenJPEGImage* xyz, int y_start, int y_end)
 {
-	shared_ptr<OpenJPEGImage> xyz (new OpenJPEGImage (size));
-
 	struct {
 		double r, g, b;
 	} s;
@@ -297,20 +376,19 @@ dcp::rgb_to_xyz (
 		double x, y, z;
 	} d;
 
-	double const * lut_in = conversion.in()->lut (12, false);
-	double const * lut_out = conversion.out()->lut (16, true);
+	double const * lut_in = &tables.lut_in[0];
+	uint16_t const * lut_out = &tables.lut_out[0];
+	double const * fast_matrix = tables.matrix;
 
-	/* This is is the product of the RGB to XYZ matrix, the Bradford transform and the DCI companding */
-	double fast_matrix[9];
-	combined_rgb_to_xyz (conversion, fast_matrix);
+	int const width = xyz->size().width;
 
 	int clamped = 0;
-	int* xyz_x = xyz->data (0);
-	int* xyz_y = xyz->data (1);
-	int* xyz_z = xyz->data (2);
-	for (int y = 0; y < size.height; ++y) {
+	int* xyz_x = xyz->data (0) + y_start * width;
+	int* xyz_y = xyz->data (1) + y_start * width;
+	int* xyz_z = xyz->data (2) + y_start * width;
+	for (int y = y_start; y < y_end; ++y) {
 		uint16_t const * p = reinterpret_cast<uint16_t const *> (rgb + y * stride);
-		for (int x = 0; x < size.width; ++x) {
+		for (int x = 0; x < width; ++x) {
 
 			/* In gamma LUT (converting 16-bit to 12-bit) */
 			s.r = lut_in[*p++ >> 4];
@@ -336,15 +414,102 @@ dcp::rgb_to_xyz (
 			d.z = min (65535.0, d.z);
 
 			/* Out gamma LUT */
-			*xyz_x++ = lrint (lut_out[lrint(d.x)] * 4095);
-			*xyz_y++ = lrint (lut_out[lrint(d.y)] * 4095);
-			*xyz_z++ = lrint (lut_out[lrint(d.z)] * 4095);
+			*xyz_x++ = lut_out[lrint(d.x)];
+			*xyz_y++ = lut_out[lrint(d.y)];
+			*xyz_z++ = lut_out[lrint(d.z)];
 		}
 	}
 
+	return clamped;
+}
+
+static shared_ptr<OpenJPEGImage>
+rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	simd::RGBToXYZTables const & tables,
+	int threads,
+	optional<NoteHandler> note
+	)
+{
+	shared_ptr<OpenJPEGImage> xyz (new OpenJPEGImage (size));
+
+	int const clamped = in_bands (
+		size.height, threads,
+		boost::bind (&rgb_to_xyz_band, rgb, stride, boost::cref (tables), xyz.get(), _1, _2)
+		);
+
 	if (clamped && note) {
 		note.get() (DCP_NOTE, String::compose ("%1 XYZ value(s) clamped", clamped));
 	}
 
 	return xyz;
 }
+
+/** @param rgb RGB data; packed RGB 16:16:16, 48bpp, 16R, 16G, 16B,
+ *  with the 2-byte value for each R/G/B component stored as
+ *  little-endian; i.e. AV_PIX_FMT_RGB48LE.
+ *  @param size size of RGB image in pixels.
+ *  @param size stride of RGB data in pixels.
+ */
+shared_ptr<dcp::OpenJPEGImage>
+dcp::rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	ColourConversion const & conversion,
+	optional<NoteHandler> note
+	)
+{
+	return rgb_to_xyz (rgb, size, stride, conversion, 1, note);
+}
+
+/** Convert an RGB image to XYZ, using multiple threads.  Parameters are as
+ *  for the single-threaded version, except:
+ *  @param threads Number of threads to use; the image is split into this many horizontal bands.
+ *  Any note is made from the calling thread, with the number of clamped values from all bands.
+ */
+shared_ptr<dcp::OpenJPEGImage>
+dcp::rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	ColourConversion const & conversion,
+	int threads,
+	optional<NoteHandler> note
+	)
+{
+	return ::rgb_to_xyz (rgb, size, stride, simd::RGBToXYZTables (conversion), threads, note);
+}
+
+/** Convert an RGB image to XYZ using a pre-built plan; parameters are otherwise as
+ *  for the version which takes a ColourConversion.
+ */
+shared_ptr<dcp::OpenJPEGImage>
+dcp::rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	ColourConversionPlan const & plan,
+	optional<NoteHandler> note
+	)
+{
+	return ::rgb_to_xyz (rgb, size, stride, plan.rgb_to_xyz (), 1, note);
+}
+
+/** Convert an RGB image to XYZ using a pre-built plan and multiple threads; parameters
+ *  are otherwise as for the version which takes a ColourConversion.
+ */
+shared_ptr<dcp::OpenJPEGImage>
+dcp::rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	ColourConversionPlan const & plan,
+	int threads,
+	optional<NoteHandler> note
+	)
+{
+	return ::rgb_to_xyz (rgb, size, stride, plan.rgb_to_xyz (), threads, note);
+}
@@ -31,6 +31,9 @@
     files in the program, then also delete it here.
 */
 
+#ifndef LIBDCP_RGB_XYZ_H
+#define LIBDCP_RGB_XYZ_H
+
 #include "types.h"
 #include <boost/shared_ptr.hpp>
 #include <boost/optional.hpp>
@@ -41,6 +44,7 @@ namespace dcp {
 class OpenJPEGImage;
 class Image;
 class ColourConversion;
+class ColourConversionPlan;
 
 extern void xyz_to_rgba (
 	boost::shared_ptr<const OpenJPEGImage>,
@@ -49,11 +53,68 @@ extern void xyz_to_rgba (
 	int stride
 	);
 
+extern void xyz_to_rgba (
+	boost::shared_ptr<const OpenJPEGImage>,
+	ColourConversion const & conversion,
+	uint8_t* rgba,
+	int stride,
+	int threads
+	);
+
+extern void xyz_to_rgba (
+	boost::shared_ptr<const OpenJPEGImage>,
+	ColourConversionPlan const & plan,
+	uint8_t* rgba,
+	int stride
+	);
+
+extern void xyz_to_rgba (
+	boost::shared_ptr<const OpenJPEGImage>,
+	ColourConversionPlan const & plan,
+	uint8_t* rgba,
+	int stride,
+	int threads
+	);
+
+extern void xyz_to_rgb (
+	boost::shared_ptr<const OpenJPEGImage>,
+	ColourConversion const & conversion,
+	uint8_t* rgb,
+	int stride,
+	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
+	);
+
 extern void xyz_to_rgb (
 	boost::shared_ptr<const OpenJPEGImage>,
 	ColourConversion const & conversion,
 	uint8_t* rgb,
 	int stride,
+	int threads,
+	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
+	);
+
+extern void xyz_to_rgb (
+	boost::shared_ptr<const OpenJPEGImage>,
+	ColourConversionPlan const & plan,
+	uint8_t* rgb,
+	int stride,
+	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
+	);
+
+extern void xyz_to_rgb (
+	boost::shared_ptr<const OpenJPEGImage>,
+	ColourConversionPlan const & plan,
+	uint8_t* rgb,
+	int stride,
+	int threads,
+	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
+	);
+
+extern boost::shared_ptr<OpenJPEGImage> rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	ColourConversion const & conversion,
 	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
 	);
 
@@ -62,9 +123,29 @@ extern boost::shared_ptr<OpenJPEGImage> rgb_to_xyz (
 	dcp::Size size,
 	int stride,
 	ColourConversion const & conversion,
+	int threads,
+	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
+	);
+
+extern boost::shared_ptr<OpenJPEGImage> rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	ColourConversionPlan const & plan,
+	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
+	);
+
+extern boost::shared_ptr<OpenJPEGImage> rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	ColourConversionPlan const & plan,
+	int threads,
 	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
 	);
 
 extern void combined_rgb_to_xyz (ColourConversion const & conversion, double* matrix);
 
 }
+
+#endif
@@ -0,0 +1,484 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/rgb_xyz_simd.cc
+ *  @brief Row kernels for XYZ to RGB conversion, with SSE2 and AVX2 versions
+ *  chosen at run time.
+ *
+ *  The vector versions work in double precision, with the same order of operations
+ *  as the scalar version, and use the CPU's default round-to-nearest-even mode
+ *  for their float to integer conversions; this is what lrint() does, so all
+ *  three versions give bit-identical results.
+ */
+
+#include "rgb_xyz_simd.h"
+#include "rgb_xyz.h"
+#include "colour_conversion.h"
+#include "transfer_function.h"
+#include <boost/numeric/ublas/matrix.hpp>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LIBDCP_X86_SIMD
+#include <immintrin.h>
+#endif
+
+using std::min;
+using std::max;
+using namespace dcp;
+using namespace dcp::simd;
+
+simd::XYZToRGBTables::XYZToRGBTables (ColourConversion const & conversion, Output output)
+	: lut_in (4096)
+{
+	double const * in = conversion.out()->lut (12, false);
+	for (int i = 0; i < 4096; ++i) {
+		lut_in[i] = in[i] / DCI_COEFFICIENT;
+	}
+
+	boost::numeric::ublas::matrix<double> const m = conversion.xyz_to_rgb ();
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			matrix[i * 3 + j] = m (i, j);
+		}
+	}
+
+	double const * out = conversion.in()->lut (16, true);
+	switch (output) {
+	case RGB48:
+		lut_out_16.resize (65536 + 1);
+		for (int i = 0; i < 65536; ++i) {
+			lut_out_16[i] = lrint (out[i] * 65535);
+		}
+		break;
+	case BGRA:
+		lut_out_8.resize (65536 + 3);
+		for (int i = 0; i < 65536; ++i) {
+			lut_out_8[i] = out[i] * 0xff;
+		}
+		break;
+	}
+}
+
+simd::RGBToXYZTables::RGBToXYZTables (ColourConversion const & conversion)
+	: lut_in (4096)
+	, lut_out (65536)
+{
+	double const * in = conversion.in()->lut (12, false);
+	std::copy (in, in + 4096, lut_in.begin ());
+
+	combined_rgb_to_xyz (conversion, matrix);
+
+	double const * out = conversion.out()->lut (16, true);
+	for (int i = 0; i < 65536; ++i) {
+		lut_out[i] = lrint (out[i] * 4095);
+	}
+}
+
+/** Clamp a sample to the 12-bit range, counting it if it was outside */
+static inline int
+clamp_12 (int v, int& out_of_range)
+{
+	if (v < 0 || v > 4095) {
+		++out_of_range;
+		return max (min (v, 4095), 0);
+	}
+
+	return v;
+}
+
+/** Convert one pixel to indices into the output LUTs */
+static inline void
+pixel_indices (XYZToRGBTables const & t, int cx, int cy, int cz, long* r, long* g, long* b)
+{
+	/* In gamma LUT and DCI companding */
+	double const sx = t.lut_in[cx];
+	double const sy = t.lut_in[cy];
+	double const sz = t.lut_in[cz];
+
+	/* XYZ to RGB */
+	double dr = ((sx * t.matrix[0]) + (sy * t.matrix[1]) + (sz * t.matrix[2]));
+	double dg = ((sx * t.matrix[3]) + (sy * t.matrix[4]) + (sz * t.matrix[5]));
+	double db = ((sx * t.matrix[6]) + (sy * t.matrix[7]) + (sz * t.matrix[8]));
+
+	dr = max (min (dr, 1.0), 0.0);
+	dg = max (min (dg, 1.0), 0.0);
+	db = max (min (db, 1.0), 0.0);
+
+	*r = lrint (dr * 65535);
+	*g = lrint (dg * 65535);
+	*b = lrint (db * 65535);
+}
+
+static int
+xyz_to_rgb_row_scalar (XYZToRGBTables const & t, int const * xs, int const * ys, int const * zs, int width, uint16_t* rgb)
+{
+	int out_of_range = 0;
+	uint16_t const * lut_out = &t.lut_out_16[0];
+
+	for (int x = 0; x < width; ++x) {
+		long r, g, b;
+		pixel_indices (t, clamp_12 (xs[x], out_of_range), clamp_12 (ys[x], out_of_range), clamp_12 (zs[x], out_of_range), &r, &g, &b);
+		*rgb++ = lut_out[r];
+		*rgb++ = lut_out[g];
+		*rgb++ = lut_out[b];
+	}
+
+	return out_of_range;
+}
+
+static int
+xyz_to_rgba_row_scalar (XYZToRGBTables const & t, int const * xs, int const * ys, int const * zs, int width, uint8_t* bgra)
+{
+	int out_of_range = 0;
+	uint8_t const * lut_out = &t.lut_out_8[0];
+
+	for (int x = 0; x < width; ++x) {
+		long r, g, b;
+		pixel_indices (t, clamp_12 (xs[x], out_of_range), clamp_12 (ys[x], out_of_range), clamp_12 (zs[x], out_of_range), &r, &g, &b);
+		*bgra++ = lut_out[b];
+		*bgra++ = lut_out[g];
+		*bgra++ = lut_out[r];
+		*bgra++ = 0xff;
+	}
+
+	return out_of_range;
+}
+
+#ifdef LIBDCP_X86_SIMD
+
+/* SSE2: 4 pixels per iteration.  There are no gathers, so table look-ups are done
+   one at a time, but the range checks, matrix and output rounding are vectorised.
+*/
+
+__attribute__((target("sse2")))
+static inline __m128i
+clamp_12_sse2 (__m128i v, int& out_of_range)
+{
+	__m128i const zero = _mm_setzero_si128 ();
+	__m128i const top = _mm_set1_epi32 (4095);
+	__m128i const low = _mm_cmplt_epi32 (v, zero);
+	__m128i const high = _mm_cmpgt_epi32 (v, top);
+	out_of_range += __builtin_popcount (_mm_movemask_ps (_mm_castsi128_ps (_mm_or_si128 (low, high))));
+	__m128i const c = _mm_andnot_si128 (low, v);
+	return _mm_or_si128 (_mm_and_si128 (high, top), _mm_andnot_si128 (high, c));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i
+to_index_sse2 (__m128d a, __m128d b)
+{
+	__m128d const zero = _mm_setzero_pd ();
+	__m128d const one = _mm_set1_pd (1.0);
+	__m128d const scale = _mm_set1_pd (65535);
+	a = _mm_max_pd (_mm_min_pd (a, one), zero);
+	b = _mm_max_pd (_mm_min_pd (b, one), zero);
+	return _mm_unpacklo_epi64 (_mm_cvtpd_epi32 (_mm_mul_pd (a, scale)), _mm_cvtpd_epi32 (_mm_mul_pd (b, scale)));
+}
+
+__attribute__((target("sse2")))
+static inline __m128d
+transform_sse2 (__m128d x, __m128d y, __m128d z, double const * m)
+{
+	return _mm_add_pd (_mm_add_pd (_mm_mul_pd (x, _mm_set1_pd (m[0])), _mm_mul_pd (y, _mm_set1_pd (m[1]))), _mm_mul_pd (z, _mm_set1_pd (m[2])));
+}
+
+/** Compute LUT indices for 4 pixels */
+__attribute__((target("sse2")))
+static inline void
+indices_sse2 (XYZToRGBTables const & t, int const * xs, int const * ys, int const * zs, int* r, int* g, int* b, int& out_of_range)
+{
+	int cx[4];
+	int cy[4];
+	int cz[4];
+	_mm_storeu_si128 (reinterpret_cast<__m128i*> (cx), clamp_12_sse2 (_mm_loadu_si128 (reinterpret_cast<__m128i const *> (xs)), out_of_range));
+	_mm_storeu_si128 (reinterpret_cast<__m128i*> (cy), clamp_12_sse2 (_mm_loadu_si128 (reinterpret_cast<__m128i const *> (ys)), out_of_range));
+	_mm_storeu_si128 (reinterpret_cast<__m128i*> (cz), clamp_12_sse2 (_mm_loadu_si128 (reinterpret_cast<__m128i const *> (zs)), out_of_range));
+
+	double const * lut_in = &t.lut_in[0];
+	__m128d const sx0 = _mm_set_pd (lut_in[cx[1]], lut_in[cx[0]]);
+	__m128d const sx1 = _mm_set_pd (lut_in[cx[3]], lut_in[cx[2]]);
+	__m128d const sy0 = _mm_set_pd (lut_in[cy[1]], lut_in[cy[0]]);
+	__m128d const sy1 = _mm_set_pd (lut_in[cy[3]], lut_in[cy[2]]);
+	__m128d const sz0 = _mm_set_pd (lut_in[cz[1]], lut_in[cz[0]]);
+	__m128d const sz1 = _mm_set_pd (lut_in[cz[3]], lut_in[cz[2]]);
+
+	_mm_storeu_si128 (reinterpret_cast<__m128i*> (r), to_index_sse2 (transform_sse2 (sx0, sy0, sz0, t.matrix + 0), transform_sse2 (sx1, sy1, sz1, t.matrix + 0)));
+	_mm_storeu_si128 (reinterpret_cast<__m128i*> (g), to_index_sse2 (transform_sse2 (sx0, sy0, sz0, t.matrix + 3), transform_sse2 (sx1, sy1, sz1, t.matrix + 3)));
+	_mm_storeu_si128 (reinterpret_cast<__m128i*> (b), to_index_sse2 (transform_sse2 (sx0, sy0, sz0, t.matrix + 6), transform_sse2 (sx1, sy1, sz1, t.matrix + 6)));
+}
+
+__attribute__((target("sse2")))
+static int
+xyz_to_rgb_row_sse2 (XYZToRGBTables const & t, int const * xs, int const * ys, int const * zs, int width, uint16_t* rgb)
+{
+	int out_of_range = 0;
+	uint16_t const * lut_out = &t.lut_out_16[0];
+
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		int r[4];
+		int g[4];
+		int b[4];
+		indices_sse2 (t, xs + x, ys + x, zs + x, r, g, b, out_of_range);
+		for (int i = 0; i < 4; ++i) {
+			*rgb++ = lut_out[r[i]];
+			*rgb++ = lut_out[g[i]];
+			*rgb++ = lut_out[b[i]];
+		}
+	}
+
+	return out_of_range + xyz_to_rgb_row_scalar (t, xs + x, ys + x, zs + x, width - x, rgb);
+}
+
+__attribute__((target("sse2")))
+static int
+xyz_to_rgba_row_sse2 (XYZToRGBTables const & t, int const * xs, int const * ys, int const * zs, int width, uint8_t* bgra)
+{
+	int out_of_range = 0;
+	uint8_t const * lut_out = &t.lut_out_8[0];
+
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		int r[4];
+		int g[4];
+		int b[4];
+		indices_sse2 (t, xs + x, ys + x, zs + x, r, g, b, out_of_range);
+		for (int i = 0; i < 4; ++i) {
+			*bgra++ = lut_out[b[i]];
+			*bgra++ = lut_out[g[i]];
+			*bgra++ = lut_out[r[i]];
+			*bgra++ = 0xff;
+		}
+	}
+
+	return out_of_range + xyz_to_rgba_row_scalar (t, xs + x, ys + x, zs + x, width - x, bgra);
+}
+
+/* AVX2: 8 pixels per iteration, with gathers for all the table look-ups */
+
+__attribute__((target("avx2")))
+static inline __m256i
+clamp_12_avx2 (__m256i v, int& out_of_range)
+{
+	__m256i const c = _mm256_min_epi32 (_mm256_max_epi32 (v, _mm256_setzero_si256 ()), _mm256_set1_epi32 (4095));
+	out_of_range += 8 - __builtin_popcount (_mm256_movemask_ps (_mm256_castsi256_ps (_mm256_cmpeq_epi32 (v, c))));
+	return c;
+}
+
+__attribute__((target("avx2")))
+static inline __m256d
+transform_avx2 (__m256d x, __m256d y, __m256d z, double const * m)
+{
+	return _mm256_add_pd (
+		_mm256_add_pd (_mm256_mul_pd (x, _mm256_set1_pd (m[0])), _mm256_mul_pd (y, _mm256_set1_pd (m[1]))),
+		_mm256_mul_pd (z, _mm256_set1_pd (m[2]))
+		);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+to_index_avx2 (__m256d a, __m256d b)
+{
+	__m256d const zero = _mm256_setzero_pd ();
+	__m256d const one = _mm256_set1_pd (1.0);
+	__m256d const scale = _mm256_set1_pd (65535);
+	a = _mm256_max_pd (_mm256_min_pd (a, one), zero);
+	b = _mm256_max_pd (_mm256_min_pd (b, one), zero);
+	return _mm256_inserti128_si256 (
+		_mm256_castsi128_si256 (_mm256_cvtpd_epi32 (_mm256_mul_pd (a, scale))), _mm256_cvtpd_epi32 (_mm256_mul_pd (b, scale)), 1
+		);
+}
+
+/** Gather 4 doubles; this is _mm256_i32gather_pd but without reading an undefined source operand */
+__attribute__((target("avx2")))
+static inline __m256d
+gather_avx2 (double const * base, __m128i indices)
+{
+	return _mm256_mask_i32gather_pd (_mm256_setzero_pd (), base, indices, _mm256_castsi256_pd (_mm256_set1_epi64x (-1)), 8);
+}
+
+/** Compute LUT indices for 8 pixels */
+__attribute__((target("avx2")))
+static inline void
+indices_avx2 (XYZToRGBTables const & t, int const * xs, int const * ys, int const * zs, __m256i* r, __m256i* g, __m256i* b, int& out_of_range)
+{
+	__m256i const cx = clamp_12_avx2 (_mm256_loadu_si256 (reinterpret_cast<__m256i const *> (xs)), out_of_range);
+	__m256i const cy = clamp_12_avx2 (_mm256_loadu_si256 (reinterpret_cast<__m256i const *> (ys)), out_of_range);
+	__m256i const cz = clamp_12_avx2 (_mm256_loadu_si256 (reinterpret_cast<__m256i const *> (zs)), out_of_range);
+
+	double const * lut_in = &t.lut_in[0];
+	__m256d const sx0 = gather_avx2 (lut_in, _mm256_castsi256_si128 (cx));
+	__m256d const sx1 = gather_avx2 (lut_in, _mm256_extracti128_si256 (cx, 1));
+	__m256d const sy0 = gather_avx2 (lut_in, _mm256_castsi256_si128 (cy));
+	__m256d const sy1 = gather_avx2 (lut_in, _mm256_extracti128_si256 (cy, 1));
+	__m256d const sz0 = gather_avx2 (lut_in, _mm256_castsi256_si128 (cz));
+	__m256d const sz1 = gather_avx2 (lut_in, _mm256_extracti128_si256 (cz, 1));
+
+	*r = to_index_avx2 (transform_avx2 (sx0, sy0, sz0, t.matrix + 0), transform_avx2 (sx1, sy1, sz1, t.matrix + 0));
+	*g = to_index_avx2 (transform_avx2 (sx0, sy0, sz0, t.matrix + 3), transform_avx2 (sx1, sy1, sz1, t.matrix + 3));
+	*b = to_index_avx2 (transform_avx2 (sx0, sy0, sz0, t.matrix + 6), transform_avx2 (sx1, sy1, sz1, t.matrix + 6));
+}
+
+__attribute__((target("avx2")))
+static int
+xyz_to_rgb_row_avx2 (XYZToRGBTables const & t, int const * xs, int const * ys, int const * zs, int width, uint16_t* rgb)
+{
+	int out_of_range = 0;
+	int const * lut_out = reinterpret_cast<int const *> (&t.lut_out_16[0]);
+	__m256i const mask = _mm256_set1_epi32 (0xffff);
+
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i r, g, b;
+		indices_avx2 (t, xs + x, ys + x, zs + x, &r, &g, &b, out_of_range);
+
+		int rv[8];
+		int gv[8];
+		int bv[8];
+		_mm256_storeu_si256 (reinterpret_cast<__m256i*> (rv), _mm256_and_si256 (_mm256_i32gather_epi32 (lut_out, r, 2), mask));
+		_mm256_storeu_si256 (reinterpret_cast<__m256i*> (gv), _mm256_and_si256 (_mm256_i32gather_epi32 (lut_out, g, 2), mask));
+		_mm256_storeu_si256 (reinterpret_cast<__m256i*> (bv), _mm256_and_si256 (_mm256_i32gather_epi32 (lut_out, b, 2), mask));
+		for (int i = 0; i < 8; ++i) {
+			*rgb++ = rv[i];
+			*rgb++ = gv[i];
+			*rgb++ = bv[i];
+		}
+	}
+
+	return out_of_range + xyz_to_rgb_row_scalar (t, xs + x, ys + x, zs + x, width - x, rgb);
+}
+
+__attribute__((target("avx2")))
+static int
+xyz_to_rgba_row_avx2 (XYZToRGBTables const & t, int const * xs, int const * ys, int const * zs, int width, uint8_t* bgra)
+{
+	int out_of_range = 0;
+	int const * lut_out = reinterpret_cast<int const *> (&t.lut_out_8[0]);
+	__m256i const mask = _mm256_set1_epi32 (0xff);
+	__m256i const alpha = _mm256_set1_epi32 (0xff000000);
+
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i r, g, b;
+		indices_avx2 (t, xs + x, ys + x, zs + x, &r, &g, &b, out_of_range);
+
+		r = _mm256_and_si256 (_mm256_i32gather_epi32 (lut_out, r, 1), mask);
+		g = _mm256_and_si256 (_mm256_i32gather_epi32 (lut_out, g, 1), mask);
+		b = _mm256_and_si256 (_mm256_i32gather_epi32 (lut_out, b, 1), mask);
+
+		/* Little-endian 32-bit words of 0xAARRGGBB are B, G, R, A in memory */
+		__m256i const p = _mm256_or_si256 (
+			_mm256_or_si256 (b, _mm256_slli_epi32 (g, 8)),
+			_mm256_or_si256 (_mm256_slli_epi32 (r, 16), alpha)
+			);
+		_mm256_storeu_si256 (reinterpret_cast<__m256i*> (bgra), p);
+		bgra += 32;
+	}
+
+	return out_of_range + xyz_to_rgba_row_scalar (t, xs + x, ys + x, zs + x, width - x, bgra);
+}
+
+#endif
+
+Level
+simd::best_level ()
+{
+#ifdef LIBDCP_X86_SIMD
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("avx2")) {
+		return LEVEL_AVX2;
+	} else if (__builtin_cpu_supports ("sse2")) {
+		return LEVEL_SSE2;
+	}
+#endif
+	return LEVEL_SCALAR;
+}
+
+static Level current_level = best_level ();
+
+/** @return The level of SIMD support that is currently being used */
+Level
+simd::level ()
+{
+	return current_level;
+}
+
+/** Set the level of SIMD support to use; this is clamped to the best that the CPU offers.
+ *  It is intended for testing, and should not be called while conversions are running.
+ */
+void
+simd::set_level (Level l)
+{
+	current_level = min (l, best_level ());
+}
+
+/** Convert a row of 12-bit XYZ to 16-bit RGB (AV_PIX_FMT_RGB48LE).
+ *  Samples outside the range 0-4095 are clamped.
+ *  @return Number of samples that were clamped.
+ */
+int
+simd::xyz_to_rgb_row (XYZToRGBTables const & tables, int const * x, int const * y, int const * z, int width, uint16_t* rgb)
+{
+	switch (current_level) {
+#ifdef LIBDCP_X86_SIMD
+	case LEVEL_AVX2:
+		return xyz_to_rgb_row_avx2 (tables, x, y, z, width, rgb);
+	case LEVEL_SSE2:
+		return xyz_to_rgb_row_sse2 (tables, x, y, z, width, rgb);
+#endif
+	default:
+		return xyz_to_rgb_row_scalar (tables, x, y, z, width, rgb);
+	}
+}
+
+/** Convert a row of 12-bit XYZ to 8-bit BGRA with an opaque alpha.
+ *  Samples outside the range 0-4095 are clamped.
+ *  @return Number of samples that were clamped.
+ */
+int
+simd::xyz_to_rgba_row (XYZToRGBTables const & tables, int const * x, int const * y, int const * z, int width, uint8_t* bgra)
+{
+	switch (current_level) {
+#ifdef LIBDCP_X86_SIMD
+	case LEVEL_AVX2:
+		return xyz_to_rgba_row_avx2 (tables, x, y, z, width, bgra);
+	case LEVEL_SSE2:
+		return xyz_to_rgba_row_sse2 (tables, x, y, z, width, bgra);
+#endif
+	default:
+		return xyz_to_rgba_row_scalar (tables, x, y, z, width, bgra);
+	}
+}
@@ -0,0 +1,75 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+/** @file  src/rgb_xyz_simd.h
+ *  @brief Row kernels for XYZ to RGB conversion with SSE2 and AVX2 versions
+ *  chosen at run time.
+ */
+
+#ifndef LIBDCP_RGB_XYZ_SIMD_H
+#define LIBDCP_RGB_XYZ_SIMD_H
+
+#include "colour_conversion_plan.h"
+#include <stdint.h>
+
+namespace dcp {
+
+static double const DCI_COEFFICIENT = 48.0 / 52.37;
+
+namespace simd {
+
+enum Level
+{
+	LEVEL_SCALAR,
+	LEVEL_SSE2,
+	LEVEL_AVX2
+};
+
+extern Level best_level ();
+extern Level level ();
+extern void set_level (Level level);
+
+extern int xyz_to_rgb_row (
+	XYZToRGBTables const & tables, int const * x, int const * y, int const * z, int width, uint16_t* rgb
+	);
+
+extern int xyz_to_rgba_row (
+	XYZToRGBTables const & tables, int const * x, int const * y, int const * z, int width, uint8_t* bgra
+	);
+
+}
+
+}
+
+#endif
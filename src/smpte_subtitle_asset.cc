@@ -50,6 +50,7 @@
 #include <libxml++/libxml++.h>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/throw_exception.hpp>
 
 using std::string;
 using std::list;
@@ -137,7 +138,7 @@ SMPTESubtitleAsset::parse_xml (shared_ptr<cxml::Document> xml)
 	} else if (er_parts.size() == 2) {
 		_edit_rate = Fraction (raw_convert<int> (er_parts[0]), raw_convert<int> (er_parts[1]));
 	} else {
-		throw XMLError ("malformed EditRate " + er);
+		boost::throw_exception (XMLError ("malformed EditRate " + er));
 	}
 
 	_time_code_rate = xml->number_child<int> ("TimeCodeRate");
@@ -37,6 +37,7 @@
 #include "dcp_assert.h"
 #include "compose.hpp"
 #include "crypto_context.h"
+#include "pcm_simd.h"
 #include <asdcp/AS_DCP.h>
 #include <iostream>
 
@@ -89,53 +90,70 @@ SoundAssetWriter::SoundAssetWriter (SoundAsset* asset, boost::filesystem::path f
 	_asset->fill_writer_info (&_state->writer_info, _asset->id());
 }
 
+void
+SoundAssetWriter::start ()
+{
+	Kumu::Result_t r = _state->mxf_writer.OpenWrite (_file.string().c_str(), _state->writer_info, _state->desc);
+	if (ASDCP_FAILURE (r)) {
+		boost::throw_exception (FileError ("could not open audio MXF for writing", _file.string(), r));
+	}
+
+	_asset->set_file (_file);
+	_started = true;
+}
+
+/** Write some samples.
+ *  @param data Floating-point samples, indexed by channel and then by sample frame.
+ *  Samples are clipped to just under +/-1.0.
+ *  @param frames Number of sample frames to write.
+ */
 void
 SoundAssetWriter::write (float const * const * data, int frames)
+{
+	write_samples (data, frames);
+}
+
+/** Write some samples.
+ *  @param data 24-bit samples, held in int32_ts, indexed by channel and then by sample frame.
+ *  Samples outside the 24-bit range are clipped.
+ *  @param frames Number of sample frames to write.
+ */
+void
+SoundAssetWriter::write (int32_t const * const * data, int frames)
+{
+	write_samples (data, frames);
+}
+
+template <class T>
+void
+SoundAssetWriter::write_samples (T const * const * data, int frames)
 {
 	DCP_ASSERT (!_finalized);
 	DCP_ASSERT (frames > 0);
 
-	static float const clip = 1.0f - (1.0f / pow (2, 23));
-
 	if (!_started) {
-		Kumu::Result_t r = _state->mxf_writer.OpenWrite (_file.string().c_str(), _state->writer_info, _state->desc);
-		if (ASDCP_FAILURE (r)) {
-			boost::throw_exception (FileError ("could not open audio MXF for writing", _file.string(), r));
-		}
-
-		_asset->set_file (_file);
-		_started = true;
+		start ();
 	}
 
 	int const ch = _asset->channels ();
+	int const capacity = _state->frame_buffer.Capacity ();
 
-	for (int i = 0; i < frames; ++i) {
-
-		byte_t* out = _state->frame_buffer.Data() + _frame_buffer_offset;
-
-		/* Write one sample per channel */
-		for (int j = 0; j < ch; ++j) {
-			/* Convert sample to 24-bit int, clipping if necessary. */
-			float x = data[j][i];
-			if (x > clip) {
-				x = clip;
-			} else if (x < -clip) {
-				x = -clip;
-			}
-			int32_t const s = x * (1 << 23);
-			*out++ = (s & 0xff);
-			*out++ = (s & 0xff00) >> 8;
-			*out++ = (s & 0xff0000) >> 16;
-		}
-		_frame_buffer_offset += 3 * ch;
+	int done = 0;
+	while (done < frames) {
+		/* Pack as many sample frames as will fit into the current MXF frame */
+		int const n = min (frames - done, (capacity - _frame_buffer_offset) / (3 * ch));
+		DCP_ASSERT (n > 0);
 
-		DCP_ASSERT (_frame_buffer_offset <= int (_state->frame_buffer.Capacity()));
+		simd::pack_pcm_24 (data, ch, done, n, _state->frame_buffer.Data() + _frame_buffer_offset);
+		_frame_buffer_offset += n * 3 * ch;
+		done += n;
 
-		/* Finish the MXF frame if required */
-		if (_frame_buffer_offset == int (_state->frame_buffer.Capacity())) {
+		/* Finish the MXF frame if required; the next one will overwrite the whole
+		   buffer, so there is no need to clear it.
+		*/
+		if (_frame_buffer_offset == capacity) {
 			write_current_frame ();
 			_frame_buffer_offset = 0;
-			memset (_state->frame_buffer.Data(), 0, _state->frame_buffer.Capacity());
 		}
 	}
 }
@@ -155,6 +173,8 @@ bool
 SoundAssetWriter::finalize ()
 {
 	if (_frame_buffer_offset > 0) {
+		/* Pad the final partial MXF frame with silence */
+		memset (_state->frame_buffer.Data() + _frame_buffer_offset, 0, _state->frame_buffer.Capacity() - _frame_buffer_offset);
 		write_current_frame ();
 	}
 
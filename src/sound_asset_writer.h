@@ -40,6 +40,7 @@
 #include "sound_frame.h"
 #include <boost/shared_ptr.hpp>
 #include <boost/filesystem.hpp>
+#include <stdint.h>
 
 namespace dcp {
 
@@ -51,13 +52,14 @@ class SoundAsset;
  *  Objects of this class can only be created with SoundAsset::start_write().
  *
  *  Sound samples can be written to the SoundAsset by calling write() with
- *  a buffer of float values.  finalize() must be called after the last samples
+ *  a buffer of float values or of 24-bit int32_t values.  finalize() must be called after the last samples
  *  have been written.
  */
 class SoundAssetWriter : public AssetWriter
 {
 public:
 	void write (float const * const *, int);
+	void write (int32_t const * const *, int);
 	bool finalize ();
 
 private:
@@ -65,6 +67,9 @@ private:
 
 	SoundAssetWriter (SoundAsset *, boost::filesystem::path);
 
+	void start ();
+	template <class T>
+	void write_samples (T const * const * data, int frames);
 	void write_current_frame ();
 
 	/* do this with an opaque pointer so we don't have to include
@@ -37,11 +37,14 @@
 #include "stereo_picture_asset_writer.h"
 #include "stereo_picture_asset_reader.h"
 #include "dcp_assert.h"
+#include "decode_pipeline.h"
+#include "openjpeg_image.h"
 #include <asdcp/AS_DCP.h>
 
 using std::string;
 using std::pair;
 using std::make_pair;
+using std::min;
 using boost::shared_ptr;
 using boost::dynamic_pointer_cast;
 using namespace dcp;
@@ -88,6 +91,44 @@ StereoPictureAsset::start_read () const
 	return shared_ptr<StereoPictureAssetReader> (new StereoPictureAssetReader (this, key(), standard()));
 }
 
+typedef pair<shared_ptr<OpenJPEGImage>, shared_ptr<OpenJPEGImage> > ImagePair;
+
+static ImagePair
+decode_frame (shared_ptr<const StereoPictureFrame> frame, int reduce)
+{
+	return make_pair (frame->xyz_image (LEFT, reduce), frame->xyz_image (RIGHT, reduce));
+}
+
+static void
+handle_frame (int64_t n, ImagePair images, boost::function<void (int64_t, shared_ptr<OpenJPEGImage>, shared_ptr<OpenJPEGImage>)> handler)
+{
+	handler (n, images.first, images.second);
+}
+
+/** Decode some frames of this asset using several threads.
+ *  @param from First frame to decode.
+ *  @param to One more than the last frame to decode.
+ *  @param handler Function which will be called, on the calling thread and in order, with each frame index and
+ *  its left and right images.
+ *  @param threads Number of threads to decode with.
+ *  @param reduce Power of two by which to reduce the resolution of the images, as for StereoPictureFrame::xyz_image.
+ */
+void
+StereoPictureAsset::decode (
+	int64_t from,
+	int64_t to,
+	boost::function<void (int64_t, shared_ptr<OpenJPEGImage>, shared_ptr<OpenJPEGImage>)> handler,
+	int threads,
+	int reduce
+	) const
+{
+	shared_ptr<StereoPictureAssetReader> reader = start_read ();
+	reader->set_pooled (true);
+	decode_frames<ASDCP::JP2K::MXFSReader, StereoPictureFrame, ImagePair> (
+		reader, from, to, boost::bind (&decode_frame, _1, reduce), boost::bind (&handle_frame, _1, _2, handler), threads
+		);
+}
+
 bool
 StereoPictureAsset::equals (shared_ptr<const Asset> other, EqualityOptions opt, NoteHandler note) const
 {
@@ -121,47 +162,63 @@ StereoPictureAsset::equals (shared_ptr<const Asset> other, EqualityOptions opt,
 	shared_ptr<const StereoPictureAsset> other_picture = dynamic_pointer_cast<const StereoPictureAsset> (other);
 	DCP_ASSERT (other_picture);
 
-	shared_ptr<const StereoPictureAssetReader> reader = start_read ();
-	shared_ptr<const StereoPictureAssetReader> other_reader = other_picture->start_read ();
-
 	bool result = true;
+	try {
+		result = frames_equal (
+			min (_intrinsic_duration, other_picture->intrinsic_duration()),
+			boost::bind (&StereoPictureAsset::frame_comparer, this, other_picture, opt),
+			opt,
+			note
+			);
+	} catch (DCPReadError& e) {
+		/* If there was a problem reading the frame data we'll just assume
+		   the two frames are not equal.
+		*/
+		note (DCP_ERROR, e.what ());
+		return false;
+	}
 
-	for (int i = 0; i < _intrinsic_duration; ++i) {
-		shared_ptr<const StereoPictureFrame> frame_A;
-		shared_ptr<const StereoPictureFrame> frame_B;
-		try {
-			frame_A = reader->get_frame (i);
-			frame_B = other_reader->get_frame (i);
-		} catch (DCPReadError& e) {
-			/* If there was a problem reading the frame data we'll just assume
-			   the two frames are not equal.
-			*/
-			note (DCP_ERROR, e.what ());
-			return false;
-		}
-
-		if (!frame_buffer_equals (
-			    i, opt, note,
-			    frame_A->left_j2k_data(), frame_A->left_j2k_size(),
-			    frame_B->left_j2k_data(), frame_B->left_j2k_size()
-			    )) {
-			result = false;
-			if (!opt.keep_going) {
-				return result;
-			}
-		}
-
-		if (!frame_buffer_equals (
-			    i, opt, note,
-			    frame_A->right_j2k_data(), frame_A->right_j2k_size(),
-			    frame_B->right_j2k_data(), frame_B->right_j2k_size()
-			    )) {
-			result = false;
-			if (!opt.keep_going) {
-				return result;
-			}
-		}
+	if (other_picture->intrinsic_duration() != _intrinsic_duration) {
+		result = false;
 	}
 
 	return result;
 }
+
+/** @return a FrameComparer, with its own readers, for comparing frames of this asset with frames of another */
+PictureAsset::FrameComparer
+StereoPictureAsset::frame_comparer (shared_ptr<const StereoPictureAsset> other, EqualityOptions opt) const
+{
+	return boost::bind (&StereoPictureAsset::frame_equals, this, start_read(), other->start_read(), opt, _1, _2);
+}
+
+bool
+StereoPictureAsset::frame_equals (
+	shared_ptr<StereoPictureAssetReader> reader,
+	shared_ptr<StereoPictureAssetReader> other_reader,
+	EqualityOptions opt,
+	int64_t frame,
+	NoteHandler note
+	) const
+{
+	shared_ptr<const StereoPictureFrame> frame_A = reader->get_frame (frame);
+	shared_ptr<const StereoPictureFrame> frame_B = other_reader->get_frame (frame);
+
+	bool const left = frame_buffer_equals (
+		frame, opt, note,
+		frame_A->left_j2k_data(), frame_A->left_j2k_size(),
+		frame_B->left_j2k_data(), frame_B->left_j2k_size()
+		);
+
+	if (!left && !opt.keep_going) {
+		return false;
+	}
+
+	bool const right = frame_buffer_equals (
+		frame, opt, note,
+		frame_A->right_j2k_data(), frame_A->right_j2k_size(),
+		frame_B->right_j2k_data(), frame_B->right_j2k_size()
+		);
+
+	return left && right;
+}
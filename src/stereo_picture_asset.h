@@ -36,9 +36,12 @@
 
 #include "picture_asset.h"
 #include "stereo_picture_asset_reader.h"
+#include <boost/function.hpp>
 
 namespace dcp {
 
+class OpenJPEGImage;
+
 /** A 3D (stereoscopic) picture asset */
 class StereoPictureAsset : public PictureAsset
 {
@@ -50,11 +53,29 @@ public:
 	boost::shared_ptr<PictureAssetWriter> start_write (boost::filesystem::path file, bool);
 	boost::shared_ptr<StereoPictureAssetReader> start_read () const;
 
+	void decode (
+		int64_t from,
+		int64_t to,
+		boost::function<void (int64_t, boost::shared_ptr<OpenJPEGImage>, boost::shared_ptr<OpenJPEGImage>)> handler,
+		int threads,
+		int reduce = 0
+		) const;
+
 	bool equals (
 		boost::shared_ptr<const Asset> other,
 		EqualityOptions opt,
 		NoteHandler note
 		) const;
+
+private:
+	FrameComparer frame_comparer (boost::shared_ptr<const StereoPictureAsset> other, EqualityOptions opt) const;
+	bool frame_equals (
+		boost::shared_ptr<StereoPictureAssetReader> reader,
+		boost::shared_ptr<StereoPictureAssetReader> other_reader,
+		EqualityOptions opt,
+		int64_t frame,
+		NoteHandler note
+		) const;
 };
 
 }
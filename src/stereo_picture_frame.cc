@@ -39,6 +39,7 @@
 #include "compose.hpp"
 #include "j2k.h"
 #include "crypto_context.h"
+#include "frame_pool.h"
 #include <asdcp/AS_DCP.h>
 #include <asdcp/KM_fileio.h>
 
@@ -49,13 +50,31 @@ using namespace dcp;
 /** Make a picture frame from a 3D (stereoscopic) asset.
  *  @param reader Reader for the MXF file.
  *  @param n Frame within the asset, not taking EntryPoint into account.
+ *  @param buffer_size Size of buffer to allocate for each eye; if it turns out to be too small it will be grown.
+ *  XXX: the default is unfortunate guesswork.
  */
-StereoPictureFrame::StereoPictureFrame (ASDCP::JP2K::MXFSReader* reader, int n, shared_ptr<DecryptionContext> c)
+StereoPictureFrame::StereoPictureFrame (ASDCP::JP2K::MXFSReader* reader, int n, shared_ptr<DecryptionContext> c, int buffer_size)
 {
-	/* XXX: unfortunate guesswork on this buffer size */
-	_buffer = new ASDCP::JP2K::SFrameBuffer (4 * Kumu::Megabyte);
+	_buffer = new ASDCP::JP2K::SFrameBuffer (buffer_size);
+	read (reader, n, c);
+}
+
+/** Read a frame from a 3D (stereoscopic) asset into this frame's existing buffers,
+ *  replacing whatever was there.
+ *  @param reader Reader for the MXF file.
+ *  @param n Frame within the asset, not taking EntryPoint into account.
+ */
+void
+StereoPictureFrame::read (ASDCP::JP2K::MXFSReader* reader, int n, shared_ptr<DecryptionContext> c)
+{
+	ASDCP::Result_t r = reader->ReadFrame (n, *_buffer, c->context(), c->hmac());
+	while (r == ASDCP::RESULT_SMALLBUF && int (_buffer->Left.Capacity()) < MAX_FRAME_BUFFER_SIZE) {
+		_buffer->Left.Capacity (_buffer->Left.Capacity() * 2);
+		_buffer->Right.Capacity (_buffer->Right.Capacity() * 2);
+		r = reader->ReadFrame (n, *_buffer, c->context(), c->hmac());
+	}
 
-	if (ASDCP_FAILURE (reader->ReadFrame (n, *_buffer, c->context(), c->hmac()))) {
+	if (ASDCP_FAILURE (r)) {
 		boost::throw_exception (DCPReadError (String::compose ("could not read video frame %1 of %2", n)));
 	}
 }
@@ -80,9 +99,9 @@ StereoPictureFrame::xyz_image (Eye eye, int reduce) const
 {
 	switch (eye) {
 	case LEFT:
-		return decompress_j2k (const_cast<uint8_t*> (_buffer->Left.RoData()), _buffer->Left.Size(), reduce);
+		return decompress_j2k (_buffer->Left.RoData(), _buffer->Left.Size(), reduce);
 	case RIGHT:
-		return decompress_j2k (const_cast<uint8_t*> (_buffer->Right.RoData()), _buffer->Right.Size(), reduce);
+		return decompress_j2k (_buffer->Right.RoData(), _buffer->Right.Size(), reduce);
 	}
 
 	return shared_ptr<OpenJPEGImage> ();
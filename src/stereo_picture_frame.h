@@ -36,6 +36,7 @@
 
 #include "types.h"
 #include "asset_reader.h"
+#include <asdcp/KM_fileio.h>
 #include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/filesystem.hpp>
@@ -77,7 +78,8 @@ private:
 	*/
 	friend class AssetReader<ASDCP::JP2K::MXFSReader, StereoPictureFrame>;
 
-	StereoPictureFrame (ASDCP::JP2K::MXFSReader* reader, int n, boost::shared_ptr<DecryptionContext>);
+	StereoPictureFrame (ASDCP::JP2K::MXFSReader* reader, int n, boost::shared_ptr<DecryptionContext>, int buffer_size = 4 * Kumu::Megabyte);
+	void read (ASDCP::JP2K::MXFSReader* reader, int n, boost::shared_ptr<DecryptionContext>);
 
 	ASDCP::JP2K::SFrameBuffer* _buffer;
 };
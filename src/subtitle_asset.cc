@@ -47,6 +47,7 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/shared_array.hpp>
 #include <boost/foreach.hpp>
+#include <boost/throw_exception.hpp>
 
 using std::string;
 using std::list;
@@ -77,7 +78,7 @@ string_attribute (xmlpp::Element const * node, string name)
 {
 	xmlpp::Attribute* a = node->get_attribute (name);
 	if (!a) {
-		throw XMLError (String::compose ("missing attribute %1", name));
+		boost::throw_exception (XMLError (String::compose ("missing attribute %1", name)));
 	}
 	return string (a->get_value ());
 }
@@ -264,7 +265,7 @@ SubtitleAsset::parse_subtitles (xmlpp::Element const * node, list<ParseState>& s
 	} else if (node->get_name() == "Image") {
 		state.push_back (image_node_state (node));
 	} else {
-		throw XMLError ("unexpected node " + node->get_name());
+		boost::throw_exception (XMLError ("unexpected node " + node->get_name()));
 	}
 
 	xmlpp::Node::NodeList c = node->get_children ();
@@ -32,36 +32,98 @@
 */
 
 #include "transfer_function.h"
+#include "dcp_assert.h"
+#include <algorithm>
 #include <cmath>
 
 using std::pow;
-using std::map;
-using std::pair;
-using std::make_pair;
 using boost::shared_ptr;
 using namespace dcp;
 
+TransferFunction::TransferFunction ()
+{
+	for (int i = 0; i < LUTS; ++i) {
+		_luts[i].store (0, boost::memory_order_relaxed);
+		_float_luts[i].store (0, boost::memory_order_relaxed);
+		_uint16_luts[i].store (0, boost::memory_order_relaxed);
+	}
+}
+
 TransferFunction::~TransferFunction ()
 {
-	boost::mutex::scoped_lock lm (_mutex);
+	for (int i = 0; i < LUTS; ++i) {
+		delete[] _luts[i].load ();
+		delete[] _float_luts[i].load ();
+		delete[] _uint16_luts[i].load ();
+	}
+}
+
+int
+TransferFunction::index (int bit_depth, bool inverse)
+{
+	DCP_ASSERT (bit_depth >= 0 && bit_depth <= MAX_BIT_DEPTH);
+	return bit_depth * 2 + (inverse ? 1 : 0);
+}
 
-	for (map<pair<int, bool>, double*>::const_iterator i = _luts.begin(); i != _luts.end(); ++i) {
-		delete[] i->second;
+/** Put a newly-made LUT into an empty slot, unless another thread has got there first.
+ *  @param lut LUT allocated by new[]; this function takes ownership of it.
+ *  @return The LUT that is now in the slot.
+ */
+template <class T>
+static T const *
+publish (boost::atomic<T const *>& slot, T* lut)
+{
+	T const * existing = 0;
+	if (slot.compare_exchange_strong (existing, lut, boost::memory_order_acq_rel, boost::memory_order_acquire)) {
+		return lut;
 	}
 
-	_luts.clear ();
+	delete[] lut;
+	return existing;
 }
 
 double const *
 TransferFunction::lut (int bit_depth, bool inverse) const
 {
-	boost::mutex::scoped_lock lm (_mutex);
+	boost::atomic<double const *>& slot = _luts[index (bit_depth, inverse)];
+	double const * l = slot.load (boost::memory_order_acquire);
+	if (l) {
+		return l;
+	}
+
+	return publish (slot, make_lut (bit_depth, inverse));
+}
+
+float const *
+TransferFunction::float_lut (int bit_depth, bool inverse) const
+{
+	boost::atomic<float const *>& slot = _float_luts[index (bit_depth, inverse)];
+	float const * l = slot.load (boost::memory_order_acquire);
+	if (l) {
+		return l;
+	}
+
+	int const size = 1 << bit_depth;
+	double const * d = lut (bit_depth, inverse);
+	float* f = new float[size];
+	std::copy (d, d + size, f);
+	return publish (slot, f);
+}
 
-	map<pair<int, bool>, double*>::const_iterator i = _luts.find (make_pair (bit_depth, inverse));
-	if (i != _luts.end ()) {
-		return i->second;
+uint16_t const *
+TransferFunction::uint16_lut (int bit_depth, bool inverse) const
+{
+	boost::atomic<uint16_t const *>& slot = _uint16_luts[index (bit_depth, inverse)];
+	uint16_t const * l = slot.load (boost::memory_order_acquire);
+	if (l) {
+		return l;
 	}
 
-	_luts[make_pair(bit_depth, inverse)] = make_lut (bit_depth, inverse);
-	return _luts[make_pair(bit_depth, inverse)];
+	int const size = 1 << bit_depth;
+	double const * d = lut (bit_depth, inverse);
+	uint16_t* u = new uint16_t[size];
+	for (int i = 0; i < size; ++i) {
+		u[i] = lrint (d[i] * 65535);
+	}
+	return publish (slot, u);
 }
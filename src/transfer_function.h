@@ -40,21 +40,29 @@
 
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
-#include <boost/thread/mutex.hpp>
-#include <map>
+#include <boost/atomic.hpp>
+#include <stdint.h>
 
 namespace dcp {
 
 /** @class TransferFunction
  *  @brief A transfer function represented by a lookup table.
+ *
+ *  LUTs are made on first use and then never change, so reading them
+ *  from many threads at once needs no locking.
  */
 class TransferFunction : public boost::noncopyable
 {
 public:
+	TransferFunction ();
 	virtual ~TransferFunction ();
 
 	/** @return A look-up table (of size 2^bit_depth) whose values range from 0 to 1 */
 	double const * lut (int bit_depth, bool inverse) const;
+	/** @return lut (bit_depth, inverse) as floats */
+	float const * float_lut (int bit_depth, bool inverse) const;
+	/** @return lut (bit_depth, inverse) scaled to the range 0 to 65535 */
+	uint16_t const * uint16_lut (int bit_depth, bool inverse) const;
 
 	virtual bool about_equal (boost::shared_ptr<const TransferFunction> other, double epsilon) const = 0;
 
@@ -63,9 +71,17 @@ protected:
 	virtual double * make_lut (int bit_depth, bool inverse) const = 0;
 
 private:
-	mutable std::map<std::pair<int, bool>, double*> _luts;
-	/** mutex to protect _luts */
-	mutable boost::mutex _mutex;
+	/** Maximum bit depth of any LUT */
+	static int const MAX_BIT_DEPTH = 16;
+	/** Number of LUTs of each type that we might have: one for each bit depth, each way */
+	static int const LUTS = (MAX_BIT_DEPTH + 1) * 2;
+
+	static int index (int bit_depth, bool inverse);
+
+	/** LUTs indexed by index(); each is published once by compare-and-swap and never changed */
+	mutable boost::atomic<double const *> _luts[LUTS];
+	mutable boost::atomic<float const *> _float_luts[LUTS];
+	mutable boost::atomic<uint16_t const *> _uint16_luts[LUTS];
 };
 
 }
@@ -197,6 +197,10 @@ struct EqualityOptions
 		, reel_hashes_can_differ (false)
 		, issue_dates_can_differ (false)
 		, keep_going (false)
+		, threads (1)
+		, reduce (0)
+		, max_reduced_mean_pixel_error (0)
+		, max_reduced_std_dev_pixel_error (0)
 	{}
 
 	/** The maximum allowable mean difference in pixel value between two images */
@@ -214,6 +218,29 @@ struct EqualityOptions
 	/** true if IssueDate nodes can differ */
 	bool issue_dates_can_differ;
 	bool keep_going;
+	/** Number of threads to use when comparing the frames of picture assets */
+	int threads;
+	/** If this is greater than 0, picture frames whose JPEG2000 data differs are first
+	 *  compared after decoding at 1/2^reduce of their full resolution, which is much
+	 *  quicker.  A frame whose differences at that resolution are within
+	 *  max_reduced_mean_pixel_error and max_reduced_std_dev_pixel_error is accepted
+	 *  without being decoded at full resolution; any other frame is decoded again at full
+	 *  resolution and compared properly.  Frames which cannot be decoded at the reduced
+	 *  resolution are compared at full resolution.
+	 *
+	 *  Note that this is looser than a full comparison: reducing the resolution throws
+	 *  away detail, so some differences which would be out of range at full resolution
+	 *  are not seen.
+	 */
+	int reduce;
+	/** The maximum mean difference in pixel value for a frame to be accepted at reduced
+	 *  resolution (see reduce); max_mean_pixel_error is used if it is smaller.
+	 */
+	double max_reduced_mean_pixel_error;
+	/** The maximum standard deviation of the differences in pixel value for a frame to be
+	 *  accepted at reduced resolution (see reduce); max_std_dev_pixel_error is used if it is smaller.
+	 */
+	double max_reduced_std_dev_pixel_error;
 };
 
 /* I've been unable to make mingw happy with ERROR as a symbol, so
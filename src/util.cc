@@ -42,6 +42,7 @@
 #include "openjpeg_image.h"
 #include "dcp_assert.h"
 #include "compose.hpp"
+#include "hash_cache.h"
 #include <openjpeg.h>
 #include <asdcp/KM_util.h>
 #include <asdcp/KM_fileio.h>
@@ -55,6 +56,9 @@
 #include <openssl/sha.h>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/throw_exception.hpp>
 #include <stdexcept>
 #include <iostream>
 #include <iomanip>
@@ -100,15 +104,108 @@ dcp::make_digest (Data data)
 	return Kumu::base64encode (byte_buffer, SHA_DIGEST_LENGTH, digest, 64);
 }
 
+/** Blocks of a file being read by one thread and hashed by another in make_digest() */
+struct DigestBlocks
+{
+	explicit DigestBlocks (int block_size)
+		: end (false)
+		, stop (false)
+		, error (Kumu::RESULT_OK)
+	{
+		for (int i = 0; i < 2; ++i) {
+			buffer[i].Capacity (block_size);
+			length[i] = 0;
+			full[i] = false;
+		}
+	}
+
+	boost::mutex mutex;
+	boost::condition_variable condition;
+	/** Each buffer belongs to the reading thread when it is not full,
+	 *  and to the hashing thread when it is.
+	 */
+	Kumu::ByteString buffer[2];
+	ui32_t length[2];
+	bool full[2];
+	/** true when the reading thread has reached the end of the file, or failed */
+	bool end;
+	/** true to ask the reading thread to give up */
+	bool stop;
+	Kumu::Result_t error;
+};
+
+static void
+digest_read_thread (Kumu::FileReader* reader, DigestBlocks* blocks)
+{
+	int i = 0;
+	while (true) {
+		{
+			boost::mutex::scoped_lock lm (blocks->mutex);
+			while (blocks->full[i] && !blocks->stop) {
+				blocks->condition.wait (lm);
+			}
+			if (blocks->stop) {
+				return;
+			}
+		}
+
+		ui32_t read = 0;
+		Kumu::Result_t r = reader->Read (blocks->buffer[i].Data(), blocks->buffer[i].Capacity(), &read);
+
+		boost::mutex::scoped_lock lm (blocks->mutex);
+		if (r == Kumu::RESULT_ENDOFFILE || (ASDCP_SUCCESS (r) && read == 0)) {
+			blocks->end = true;
+		} else if (ASDCP_FAILURE (r)) {
+			blocks->error = r;
+			blocks->end = true;
+		} else {
+			blocks->length[i] = read;
+			blocks->full[i] = true;
+		}
+		blocks->condition.notify_all ();
+
+		if (blocks->end) {
+			return;
+		}
+
+		i = 1 - i;
+	}
+}
+
 /** Create a digest for a file.
+ *
+ *  The file is read in blocks of @ref block_size bytes.  Files bigger than one block
+ *  are read on a second thread, so that reading the next block overlaps with hashing
+ *  the previous one.
+ *
+ *  If a cache has been set with set_hash_cache() it is consulted first, and the
+ *  new digest is added to it.
+ *
  *  @param filename File name.
  *  @param progress Optional progress reporting function.  The function will be called
- *  with a progress value between 0 and 1.
+ *  with a progress value between 0 and 1, at most once for each percent of the file.
+ *  @param block_size Size of each read, in bytes.
  *  @return Digest.
  */
 string
-dcp::make_digest (boost::filesystem::path filename, function<void (float)> progress)
+dcp::make_digest (boost::filesystem::path filename, function<void (float)> progress, int block_size)
 {
+	DCP_ASSERT (block_size > 0);
+
+	shared_ptr<HashCache> cache = hash_cache ();
+	if (cache) {
+		optional<string> hash = cache->get (filename);
+		if (hash) {
+			if (progress) {
+				progress (1);
+			}
+			return *hash;
+		}
+	}
+
+	boost::system::error_code ec;
+	std::time_t const mtime = cache ? boost::filesystem::last_write_time (filename, ec) : 0;
+
 	Kumu::FileReader reader;
 	Kumu::Result_t r = reader.OpenRead (filename.string().c_str ());
 	if (ASDCP_FAILURE (r)) {
@@ -118,26 +215,77 @@ dcp::make_digest (boost::filesystem::path filename, function<void (float)> progr
 	SHA_CTX sha;
 	SHA1_Init (&sha);
 
-	int const buffer_size = 65536;
-	Kumu::ByteString read_buffer (buffer_size);
-
-	Kumu::fsize_t done = 0;
 	Kumu::fsize_t const size = reader.Size ();
-	while (1) {
-		ui32_t read = 0;
-		Kumu::Result_t r = reader.Read (read_buffer.Data(), read_buffer.Capacity(), &read);
 
-		if (r == Kumu::RESULT_ENDOFFILE) {
-			break;
-		} else if (ASDCP_FAILURE (r)) {
-			boost::throw_exception (FileError ("could not read file to compute digest", filename, r));
+	if (size <= Kumu::fsize_t (block_size)) {
+		/* Not worth another thread */
+		Kumu::ByteString read_buffer (max (int (size), 1));
+		while (true) {
+			ui32_t read = 0;
+			Kumu::Result_t r = reader.Read (read_buffer.Data(), read_buffer.Capacity(), &read);
+			if (r == Kumu::RESULT_ENDOFFILE || (ASDCP_SUCCESS (r) && read == 0)) {
+				break;
+			} else if (ASDCP_FAILURE (r)) {
+				boost::throw_exception (FileError ("could not read file to compute digest", filename, r));
+			}
+			SHA1_Update (&sha, read_buffer.Data(), read);
 		}
 
-		SHA1_Update (&sha, read_buffer.Data(), read);
-
 		if (progress) {
-			progress (float (done) / size);
-			done += read;
+			progress (1);
+		}
+	} else {
+		DigestBlocks blocks (block_size);
+		boost::thread thread (boost::bind (&digest_read_thread, &reader, &blocks));
+
+		try {
+			Kumu::fsize_t done = 0;
+			int last_percent = -1;
+			int i = 0;
+			while (true) {
+				{
+					boost::mutex::scoped_lock lm (blocks.mutex);
+					while (!blocks.full[i] && !blocks.end) {
+						blocks.condition.wait (lm);
+					}
+					if (!blocks.full[i]) {
+						break;
+					}
+				}
+
+				SHA1_Update (&sha, blocks.buffer[i].Data(), blocks.length[i]);
+				done += blocks.length[i];
+
+				{
+					boost::mutex::scoped_lock lm (blocks.mutex);
+					blocks.full[i] = false;
+					blocks.condition.notify_all ();
+				}
+
+				if (progress) {
+					int const percent = done * 100 / size;
+					if (percent != last_percent) {
+						progress (float (done) / size);
+						last_percent = percent;
+					}
+				}
+
+				i = 1 - i;
+			}
+		} catch (...) {
+			{
+				boost::mutex::scoped_lock lm (blocks.mutex);
+				blocks.stop = true;
+				blocks.condition.notify_all ();
+			}
+			thread.join ();
+			throw;
+		}
+
+		thread.join ();
+
+		if (ASDCP_FAILURE (blocks.error)) {
+			boost::throw_exception (FileError ("could not read file to compute digest", filename, blocks.error));
 		}
 	}
 
@@ -145,7 +293,14 @@ dcp::make_digest (boost::filesystem::path filename, function<void (float)> progr
 	SHA1_Final (byte_buffer, &sha);
 
 	char digest[64];
-	return Kumu::base64encode (byte_buffer, SHA_DIGEST_LENGTH, digest, 64);
+	string const hash = Kumu::base64encode (byte_buffer, SHA_DIGEST_LENGTH, digest, 64);
+
+	/* Only cache the hash if the file was not changed while we were reading it */
+	if (cache && !ec && boost::filesystem::last_write_time (filename, ec) == mtime && !ec) {
+		cache->add (filename, hash);
+	}
+
+	return hash;
 }
 
 /** Convert a content kind to a string which can be used in a
@@ -239,21 +394,21 @@ void
 dcp::init ()
 {
 	if (xmlSecInit() < 0) {
-		throw MiscError ("could not initialise xmlsec");
+		boost::throw_exception (MiscError ("could not initialise xmlsec"));
 	}
 
 #ifdef XMLSEC_CRYPTO_DYNAMIC_LOADING
 	if (xmlSecCryptoDLLoadLibrary(BAD_CAST XMLSEC_CRYPTO) < 0) {
-		throw MiscError ("unable to load default xmlsec-crypto library");
+		boost::throw_exception (MiscError ("unable to load default xmlsec-crypto library"));
 	}
 #endif
 
 	if (xmlSecCryptoAppInit(0) < 0) {
-		throw MiscError ("could not initialise crypto");
+		boost::throw_exception (MiscError ("could not initialise crypto"));
 	}
 
 	if (xmlSecCryptoInit() < 0) {
-		throw MiscError ("could not initialise xmlsec-crypto");
+		boost::throw_exception (MiscError ("could not initialise xmlsec-crypto"));
 	}
 
 	OpenSSL_add_all_algorithms();
@@ -351,12 +506,12 @@ dcp::file_to_string (boost::filesystem::path p, uintmax_t max_length)
 {
 	uintmax_t len = boost::filesystem::file_size (p);
 	if (len > max_length) {
-		throw MiscError (String::compose ("Unexpectedly long file (%1)", p.string()));
+		boost::throw_exception (MiscError (String::compose ("Unexpectedly long file (%1)", p.string())));
 	}
 
 	FILE* f = fopen_boost (p, "r");
 	if (!f) {
-		throw FileError ("could not open file", p, errno);
+		boost::throw_exception (FileError ("could not open file", p, errno));
 	}
 
 	char* c = new char[len];
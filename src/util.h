@@ -59,7 +59,7 @@ class GammaLUT;
 class OpenJPEGImage;
 
 extern std::string make_uuid ();
-extern std::string make_digest (boost::filesystem::path filename, boost::function<void (float)>);
+extern std::string make_digest (boost::filesystem::path filename, boost::function<void (float)>, int block_size = 4 * 1024 * 1024);
 extern std::string make_digest (Data data);
 extern std::string content_kind_to_string (ContentKind kind);
 extern ContentKind content_kind_from_string (std::string kind);
@@ -37,16 +37,28 @@
 #include "reel.h"
 #include "reel_picture_asset.h"
 #include "reel_sound_asset.h"
+#include "reel_subtitle_asset.h"
+#include "reel_closed_caption_asset.h"
+#include "reel_atmos_asset.h"
 #include "exceptions.h"
+#include "compose.hpp"
+#include "util.h"
+#include "hash_cache.h"
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
 #include <list>
 #include <vector>
+#include <map>
+#include <set>
 #include <iostream>
+#include <cctype>
 
 using std::list;
 using std::vector;
 using std::string;
 using std::cout;
+using std::map;
+using std::set;
 using boost::shared_ptr;
 using boost::optional;
 using boost::function;
@@ -60,9 +72,9 @@ enum Result {
 };
 
 static Result
-verify_asset (shared_ptr<DCP> dcp, shared_ptr<ReelAsset> reel_asset, function<void (float)> progress)
+verify_asset (shared_ptr<DCP> dcp, shared_ptr<ReelAsset> reel_asset)
 {
-	string const actual_hash = reel_asset->asset_ref()->hash(progress);
+	string const actual_hash = reel_asset->asset_ref()->hash();
 
 	shared_ptr<PKL> pkl = dcp->pkl();
 	/* We've read this DCP in so it must have a PKL */
@@ -83,8 +95,102 @@ verify_asset (shared_ptr<DCP> dcp, shared_ptr<ReelAsset> reel_asset, function<vo
 	return RESULT_GOOD;
 }
 
+/** An asset whose hash must be checked */
+struct VerifyItem
+{
+	VerifyItem (shared_ptr<DCP> dcp_, shared_ptr<ReelAsset> reel_asset_, string name_)
+		: dcp (dcp_)
+		, reel_asset (reel_asset_)
+		, name (name_)
+	{}
+
+	shared_ptr<DCP> dcp;
+	shared_ptr<ReelAsset> reel_asset;
+	/** Name of the type of asset, e.g. "picture" */
+	string name;
+};
+
+static void
+add_item (list<VerifyItem>& items, shared_ptr<DCP> dcp, shared_ptr<ReelAsset> reel_asset, string name)
+{
+	if (!reel_asset || !reel_asset->asset_ref().resolved()) {
+		return;
+	}
+
+	items.push_back (VerifyItem (dcp, reel_asset, name));
+}
+
+/** Gives the stage and progress of each asset's hash as it is worked on */
+class HashReporter
+{
+public:
+	HashReporter (function<void (string, optional<boost::filesystem::path>)> stage, function<void (float)> progress)
+		: _stage (stage)
+		, _progress (progress)
+	{}
+
+	void add (shared_ptr<Asset> asset, string name)
+	{
+		_names[asset.get()] = name;
+	}
+
+	/** Called with an asset's progress; the first call for each asset gives a stage for it,
+	 *  and then progress is given for the asset whose stage was most recently given.
+	 */
+	void asset_progress (shared_ptr<Asset> asset, float progress)
+	{
+		if (_started.find (asset.get()) == _started.end ()) {
+			_stage (String::compose ("Checking %1 asset hash", _names[asset.get()]), asset->file());
+			_started.insert (asset.get ());
+			_current = asset;
+		}
+
+		if (asset == _current && _progress) {
+			_progress (progress);
+		}
+	}
+
+private:
+	function<void (string, optional<boost::filesystem::path>)> _stage;
+	function<void (float)> _progress;
+	/** name of the type of each asset, e.g. "picture" */
+	map<Asset*, string> _names;
+	set<Asset*> _started;
+	shared_ptr<Asset> _current;
+};
+
+/** Add the hash of an asset to a hash cache */
+static void
+add_to_cache (shared_ptr<HashCache> cache, shared_ptr<Asset> asset)
+{
+	DCP_ASSERT (asset->file ());
+	cache->add (asset->file().get(), asset->hash());
+}
+
+/** Check some DCPs.  The hashes of all the assets in all the DCPs' CPLs are computed
+ *  in parallel, biggest first.
+ *
+ *  @param directories Directories containing the DCPs to check.
+ *  @param stage Function which is called with a description of each stage of the check,
+ *  and the file which that stage concerns, if there is one.  There is a stage for each
+ *  asset as its hash is started.
+ *  @param progress Function which is called with progress through the hash of the asset
+ *  whose stage was given most recently, from 0 to 1.
+ *  @param threads Number of assets to hash at the same time.
+ *  @param hash_cache If specified, a HashCache file in which to store the hashes of assets once
+ *  they have been computed.  Hashes which are already in this file are not computed again,
+ *  unless the asset's file has changed since.  This means that an interrupted verify can be
+ *  resumed without starting again.
+ *  @return Notes about any problems found.
+ */
 list<VerificationNote>
-dcp::verify (vector<boost::filesystem::path> directories, function<void (string, optional<boost::filesystem::path>)> stage, function<void (float)> progress)
+dcp::verify (
+	vector<boost::filesystem::path> directories,
+	function<void (string, optional<boost::filesystem::path>)> stage,
+	function<void (float)> progress,
+	int threads,
+	optional<boost::filesystem::path> hash_cache
+	)
 {
 	list<VerificationNote> notes;
 
@@ -93,6 +199,8 @@ dcp::verify (vector<boost::filesystem::path> directories, function<void (string,
 		dcps.push_back (shared_ptr<DCP> (new DCP (i)));
 	}
 
+	list<VerifyItem> items;
+
 	BOOST_FOREACH (shared_ptr<DCP> dcp, dcps) {
 		stage ("Checking DCP", dcp->directory());
 		DCP::ReadErrors errors;
@@ -108,37 +216,67 @@ dcp::verify (vector<boost::filesystem::path> directories, function<void (string,
 			stage ("Checking CPL", cpl->file());
 			BOOST_FOREACH (shared_ptr<Reel> reel, cpl->reels()) {
 				stage ("Checking reel", optional<boost::filesystem::path>());
-				if (reel->main_picture()) {
-					stage ("Checking picture asset hash", reel->main_picture()->asset()->file());
-					Result const r = verify_asset (dcp, reel->main_picture(), progress);
-					switch (r) {
-					case RESULT_BAD:
-						notes.push_back (VerificationNote (VerificationNote::VERIFY_ERROR, "Picture asset hash is incorrect."));
-						break;
-					case RESULT_CPL_PKL_DIFFER:
-						notes.push_back (VerificationNote (VerificationNote::VERIFY_ERROR, "PKL and CPL hashes differ for picture asset."));
-						break;
-					default:
-						break;
-					}
-				}
-				if (reel->main_sound()) {
-					stage ("Checking sound asset hash", reel->main_sound()->asset()->file());
-					Result const r = verify_asset (dcp, reel->main_sound(), progress);
-					switch (r) {
-					case RESULT_BAD:
-						notes.push_back (VerificationNote (VerificationNote::VERIFY_ERROR, "Sound asset hash is incorrect."));
-						break;
-					case RESULT_CPL_PKL_DIFFER:
-						notes.push_back (VerificationNote (VerificationNote::VERIFY_ERROR, "PKL and CPL hashes differ for sound asset."));
-						break;
-					default:
-						break;
-					}
+				add_item (items, dcp, reel->main_picture(), "picture");
+				add_item (items, dcp, reel->main_sound(), "sound");
+				add_item (items, dcp, reel->main_subtitle(), "subtitle");
+				BOOST_FOREACH (shared_ptr<ReelClosedCaptionAsset> i, reel->closed_captions()) {
+					add_item (items, dcp, i, "closed caption");
 				}
+				add_item (items, dcp, reel->atmos(), "Atmos");
 			}
 		}
 	}
 
+	shared_ptr<HashCache> cache;
+	if (hash_cache) {
+		cache.reset (new HashCache (*hash_cache));
+	}
+
+	HashReporter reporter (stage, progress);
+	BOOST_FOREACH (VerifyItem const & i, items) {
+		reporter.add (i.reel_asset->asset_ref().asset(), i.name);
+	}
+
+	list<shared_ptr<Asset> > to_hash;
+	BOOST_FOREACH (VerifyItem const & i, items) {
+		shared_ptr<Asset> asset = i.reel_asset->asset_ref().asset();
+		if (!asset->file()) {
+			continue;
+		}
+		optional<string> hash;
+		if (cache) {
+			hash = cache->get (asset->file().get());
+		}
+		if (hash) {
+			asset->set_hash (*hash);
+			/* There is nothing more to do for this one */
+			reporter.asset_progress (asset, 1);
+		} else {
+			to_hash.push_back (asset);
+		}
+	}
+
+	function<void (shared_ptr<Asset>)> done;
+	if (cache) {
+		done = boost::bind (&add_to_cache, cache, _1);
+	}
+
+	hash_assets (to_hash, threads, function<void (float)> (), done, boost::bind (&HashReporter::asset_progress, &reporter, _1, _2));
+
+	BOOST_FOREACH (VerifyItem const & i, items) {
+		string name = i.name;
+		name[0] = toupper (name[0]);
+		switch (verify_asset (i.dcp, i.reel_asset)) {
+		case RESULT_BAD:
+			notes.push_back (VerificationNote (VerificationNote::VERIFY_ERROR, String::compose ("%1 asset hash is incorrect.", name)));
+			break;
+		case RESULT_CPL_PKL_DIFFER:
+			notes.push_back (VerificationNote (VerificationNote::VERIFY_ERROR, String::compose ("PKL and CPL hashes differ for %1 asset.", i.name)));
+			break;
+		default:
+			break;
+		}
+	}
+
 	return notes;
 }
@@ -76,7 +76,9 @@ private:
 std::list<VerificationNote> verify (
 	std::vector<boost::filesystem::path> directories,
 	boost::function<void (std::string, boost::optional<boost::filesystem::path>)> stage,
-	boost::function<void (float)> progress
+	boost::function<void (float)> progress,
+	int threads = 1,
+	boost::optional<boost::filesystem::path> hash_cache = boost::optional<boost::filesystem::path> ()
 	);
 
 }
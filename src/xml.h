@@ -36,6 +36,7 @@
 
 #include "exceptions.h"
 #include <libcxml/cxml.h>
+#include <boost/throw_exception.hpp>
 
 namespace dcp
 {
@@ -46,7 +47,7 @@ optional_type_child (cxml::Node const & node, std::string name)
 {
 	std::list<boost::shared_ptr<cxml::Node> > n = node.node_children (name);
 	if (n.size() > 1) {
-		throw XMLError ("duplicate XML tag");
+		boost::throw_exception (XMLError ("duplicate XML tag"));
 	} else if (n.empty ()) {
 		return boost::shared_ptr<T> ();
 	}
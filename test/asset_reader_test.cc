@@ -0,0 +1,134 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mono_picture_asset.h"
+#include "mono_picture_asset_reader.h"
+#include "mono_picture_frame.h"
+#include "openjpeg_image.h"
+#include "exceptions.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+
+using boost::shared_ptr;
+
+/** Check that a frame is the one that write_test_frames wrote at index n */
+static void
+check_frame (shared_ptr<const dcp::MonoPictureFrame> frame, int n)
+{
+	dcp::Data const j2k = test_j2k_frame (n);
+	BOOST_REQUIRE_EQUAL (frame->j2k_size(), j2k.size());
+	BOOST_CHECK_EQUAL (memcmp (frame->j2k_data(), j2k.data().get(), j2k.size()), 0);
+}
+
+/** Check that AssetReader::get_frame re-uses a frame's buffers when it can,
+ *  and gives the same results as reading a new frame.
+ */
+BOOST_AUTO_TEST_CASE (asset_reader_reuse_frame_test)
+{
+	boost::filesystem::path const work_dir = "build/test/asset_reader_reuse_frame_test";
+	boost::filesystem::remove_all (work_dir);
+	boost::filesystem::create_directories (work_dir);
+
+	shared_ptr<dcp::MonoPictureAsset> asset = write_test_frames (work_dir / "video.mxf", 4);
+
+	shared_ptr<dcp::MonoPictureAssetReader> reader = asset->start_read ();
+
+	shared_ptr<const dcp::MonoPictureFrame> frame = reader->get_frame (0);
+	dcp::MonoPictureFrame const * first = frame.get ();
+	for (int i = 1; i < 4; ++i) {
+		/* We hold the only reference, so the frame should be re-used */
+		frame = reader->get_frame (i, frame);
+		BOOST_CHECK (frame.get() == first);
+		check_frame (frame, i);
+	}
+
+	/* If someone else has the frame it must not be overwritten */
+	shared_ptr<const dcp::MonoPictureFrame> other = frame;
+	frame = reader->get_frame (0, frame);
+	BOOST_CHECK (frame.get() != other.get());
+	check_frame (frame, 0);
+	check_frame (other, 3);
+
+	shared_ptr<dcp::OpenJPEGImage> a = frame->xyz_image ();
+	shared_ptr<dcp::OpenJPEGImage> b = reader->get_frame(0)->xyz_image ();
+	BOOST_REQUIRE (a->size() == b->size());
+	for (int c = 0; c < 3; ++c) {
+		BOOST_CHECK_EQUAL (memcmp (a->data(c), b->data(c), a->size().width * a->size().height * sizeof (int)), 0);
+	}
+}
+
+/** Check that a pooled AssetReader recycles frames once they are dropped */
+BOOST_AUTO_TEST_CASE (asset_reader_pool_test)
+{
+	boost::filesystem::path const work_dir = "build/test/asset_reader_pool_test";
+	boost::filesystem::remove_all (work_dir);
+	boost::filesystem::create_directories (work_dir);
+
+	shared_ptr<dcp::MonoPictureAsset> asset = write_test_frames (work_dir / "video.mxf", 4);
+
+	shared_ptr<dcp::MonoPictureAssetReader> reader = asset->start_read ();
+	reader->set_pooled (true);
+
+	shared_ptr<const dcp::MonoPictureFrame> a = reader->get_frame (0);
+	shared_ptr<const dcp::MonoPictureFrame> b = reader->get_frame (1);
+	BOOST_CHECK (a.get() != b.get());
+
+	dcp::MonoPictureFrame const * first = a.get ();
+	a.reset ();
+	a = reader->get_frame (2);
+	BOOST_CHECK (a.get() == first);
+	check_frame (a, 2);
+
+	/* Frames must survive their reader */
+	reader.reset ();
+	check_frame (b, 1);
+}
+
+/** Check that a reader with read-ahead returns the right frames, both in order and after seeks */
+BOOST_AUTO_TEST_CASE (asset_reader_read_ahead_test)
+{
+	boost::filesystem::path const work_dir = "build/test/asset_reader_read_ahead_test";
+	boost::filesystem::remove_all (work_dir);
+	boost::filesystem::create_directories (work_dir);
+
+	shared_ptr<dcp::MonoPictureAsset> asset = write_test_frames (work_dir / "video.mxf", 24);
+
+	shared_ptr<dcp::MonoPictureAssetReader> reader = asset->start_read ();
+	reader->set_pooled (true);
+	reader->set_read_ahead (4);
+
+	for (int i = 0; i < 24; ++i) {
+		check_frame (reader->get_frame (i), i);
+	}
+
+	/* Off the end */
+	BOOST_CHECK_THROW (reader->get_frame (24), dcp::DCPReadError);
+
+	/* Seeks, both explicit and implied */
+	reader->seek (12);
+	check_frame (reader->get_frame (12), 12);
+	check_frame (reader->get_frame (3), 3);
+	check_frame (reader->get_frame (4), 4);
+	check_frame (reader->get_frame (20), 20);
+	check_frame (reader->get_frame (19), 19);
+
+	reader->set_read_ahead (0);
+	check_frame (reader->get_frame (5), 5);
+	check_frame (reader->get_frame (23), 23);
+}
@@ -19,12 +19,39 @@
 
 #include <boost/test/unit_test.hpp>
 #include "asset.h"
+#include "asset_index.h"
+#include "util.h"
+#include "file.h"
+#include "mono_picture_asset.h"
+#include "picture_asset_writer.h"
+#include "openjpeg_image.h"
+#include "j2k.h"
+#include "exceptions.h"
+#include "test.h"
+#include <boost/foreach.hpp>
+#include <algorithm>
+#include <map>
 
 using std::string;
+using std::list;
+using std::pair;
+using std::make_pair;
+using std::map;
 using boost::shared_ptr;
 
 class DummyAsset : public dcp::Asset
 {
+public:
+	DummyAsset () {}
+
+	explicit DummyAsset (boost::filesystem::path file)
+		: dcp::Asset (file)
+	{}
+
+	DummyAsset (string id, boost::filesystem::path file)
+		: dcp::Asset (id, file)
+	{}
+
 protected:
 	std::string pkl_type (dcp::Standard) const {
 		return "none";
@@ -53,3 +80,261 @@ BOOST_AUTO_TEST_CASE (asset_test)
 	b->_file = "foo/bar/baz";
 	BOOST_CHECK (a->equals (b, dcp::EqualityOptions (), boost::bind (&note_handler, _1, _2)));
 }
+
+static void
+progress (float p, float* last)
+{
+	BOOST_CHECK (p >= *last);
+	*last = p;
+}
+
+static void
+asset_progress (shared_ptr<dcp::Asset> asset, float p, map<dcp::Asset*, float>* last)
+{
+	map<dcp::Asset*, float>::const_iterator i = last->find (asset.get ());
+	if (i != last->end ()) {
+		BOOST_CHECK (p >= i->second);
+	}
+	(*last)[asset.get()] = p;
+}
+
+/** Check that hash_assets gives the same hashes as make_digest */
+BOOST_AUTO_TEST_CASE (hash_assets_test)
+{
+	list<shared_ptr<dcp::Asset> > assets;
+	boost::filesystem::directory_iterator end;
+	for (boost::filesystem::directory_iterator i ("test/ref/DCP/dcp_test1"); i != end; ++i) {
+		assets.push_back (shared_ptr<dcp::Asset> (new DummyAsset (i->path())));
+	}
+
+	float last = 0;
+	map<dcp::Asset*, float> last_asset;
+	dcp::hash_assets (assets, 3, boost::bind (&progress, _1, &last), 0, boost::bind (&asset_progress, _1, _2, &last_asset));
+	BOOST_CHECK_CLOSE (last, 1, 0.01);
+
+	/* Every asset's own progress should have been given, finishing at 1 */
+	BOOST_CHECK_EQUAL (last_asset.size(), assets.size());
+	for (map<dcp::Asset*, float>::const_iterator i = last_asset.begin(); i != last_asset.end(); ++i) {
+		BOOST_CHECK_CLOSE (i->second, 1, 0.01);
+	}
+
+	BOOST_FOREACH (shared_ptr<dcp::Asset> i, assets) {
+		BOOST_CHECK_EQUAL (i->hash(), dcp::make_digest (i->file().get(), 0));
+	}
+}
+
+/** Check that AssetIndex finds assets in the same way as ids_equal does */
+BOOST_AUTO_TEST_CASE (asset_index_test)
+{
+	list<shared_ptr<dcp::Asset> > assets;
+	shared_ptr<dcp::Asset> a (new DummyAsset ("b5a9c4a5-8f3e-4e4f-9a7b-3f2a4e0c6d11", "a"));
+	shared_ptr<dcp::Asset> b (new DummyAsset ("0c2ddd5c-3c4b-4b1e-8c19-9d0ef3b4a7a2", "b"));
+	shared_ptr<dcp::Asset> c (new DummyAsset ("B5A9C4A5-8F3E-4E4F-9A7B-3F2A4E0C6D11", "c"));
+	assets.push_back (a);
+	assets.push_back (b);
+	assets.push_back (c);
+
+	dcp::AssetIndex index (assets);
+	BOOST_CHECK (index.find ("0c2ddd5c-3c4b-4b1e-8c19-9d0ef3b4a7a2") == b);
+	BOOST_CHECK (index.find (" 0C2DDD5C-3C4B-4B1E-8C19-9D0EF3B4A7A2 ") == b);
+	/* The first of two assets with the same ID is the one that is found */
+	BOOST_CHECK (index.find ("b5a9c4a5-8f3e-4e4f-9a7b-3f2a4e0c6d11") == a);
+	BOOST_CHECK (!index.find ("e9b1e6a5-0a8e-4f5c-9f0c-6e0b2f1b5d3e"));
+	BOOST_CHECK (index.fonts().empty ());
+}
+
+static void
+store_note (list<pair<dcp::NoteType, string> >* notes, dcp::NoteType type, string text)
+{
+	notes->push_back (make_pair (type, text));
+}
+
+/** Write 48 frames of the red square to a MXF, with `different' at frame `odd' if it is not negative */
+static shared_ptr<dcp::MonoPictureAsset>
+write_squares (boost::filesystem::path file, int odd, dcp::Data different)
+{
+	shared_ptr<dcp::MonoPictureAsset> mp (new dcp::MonoPictureAsset (dcp::Fraction (24, 1), dcp::SMPTE));
+	shared_ptr<dcp::PictureAssetWriter> writer = mp->start_write (file, false);
+	dcp::File j2c ("test/data/32x32_red_square.j2c");
+	for (int i = 0; i < 48; ++i) {
+		if (i == odd) {
+			writer->write (different.data().get(), different.size());
+		} else {
+			writer->write (j2c.data (), j2c.size ());
+		}
+	}
+	writer->finalize ();
+	return mp;
+}
+
+/** Write 48 frames of the red square to a MXF, with a very different frame at `odd' if it is not negative */
+static shared_ptr<dcp::MonoPictureAsset>
+write_squares (boost::filesystem::path file, int odd)
+{
+	return write_squares (file, odd, test_j2k_frame (0));
+}
+
+static bool
+picture_equals (shared_ptr<dcp::MonoPictureAsset> a, shared_ptr<dcp::MonoPictureAsset> b, int threads, bool keep_going, list<pair<dcp::NoteType, string> >& notes)
+{
+	dcp::EqualityOptions opt;
+	opt.threads = threads;
+	opt.keep_going = keep_going;
+	notes.clear ();
+	return a->equals (b, opt, boost::bind (&store_note, &notes, _1, _2));
+}
+
+/** Check that comparing picture assets on several threads gives the same result and notes as on one */
+BOOST_AUTO_TEST_CASE (picture_asset_equals_threads_test)
+{
+	boost::filesystem::create_directories ("build/test");
+	shared_ptr<dcp::MonoPictureAsset> a = write_squares ("build/test/picture_asset_equals_threads_test_a.mxf", -1);
+	shared_ptr<dcp::MonoPictureAsset> b = write_squares ("build/test/picture_asset_equals_threads_test_b.mxf", -1);
+	shared_ptr<dcp::MonoPictureAsset> c = write_squares ("build/test/picture_asset_equals_threads_test_c.mxf", 30);
+
+	list<pair<dcp::NoteType, string> > serial;
+	list<pair<dcp::NoteType, string> > parallel;
+
+	BOOST_CHECK (picture_equals (a, b, 1, false, serial));
+	BOOST_CHECK (picture_equals (a, b, 4, false, parallel));
+	BOOST_CHECK (serial == parallel);
+
+	/* Without keep_going the comparison should stop at the odd frame */
+	BOOST_CHECK (!picture_equals (a, c, 1, false, serial));
+	BOOST_CHECK (!picture_equals (a, c, 4, false, parallel));
+	BOOST_CHECK (serial == parallel);
+	int progress = 0;
+	for (list<pair<dcp::NoteType, string> >::const_iterator i = parallel.begin(); i != parallel.end(); ++i) {
+		if (i->first == dcp::DCP_PROGRESS) {
+			++progress;
+		}
+	}
+	BOOST_CHECK_EQUAL (progress, 31);
+
+	/* With keep_going every frame should be compared */
+	BOOST_CHECK (!picture_equals (a, c, 1, true, serial));
+	BOOST_CHECK (!picture_equals (a, c, 4, true, parallel));
+	BOOST_CHECK (serial == parallel);
+	progress = 0;
+	for (list<pair<dcp::NoteType, string> >::const_iterator i = parallel.begin(); i != parallel.end(); ++i) {
+		if (i->first == dcp::DCP_PROGRESS) {
+			++progress;
+		}
+	}
+	BOOST_CHECK_EQUAL (progress, 48);
+}
+
+/** Check that a reduced-resolution comparison still finds a frame which differs,
+ *  and that it then compares that frame at full resolution.
+ */
+BOOST_AUTO_TEST_CASE (picture_asset_equals_reduce_test)
+{
+	boost::filesystem::create_directories ("build/test");
+	shared_ptr<dcp::MonoPictureAsset> a = write_squares ("build/test/picture_asset_equals_reduce_test_a.mxf", -1);
+	shared_ptr<dcp::MonoPictureAsset> c = write_squares ("build/test/picture_asset_equals_reduce_test_c.mxf", 12);
+
+	dcp::EqualityOptions opt;
+	opt.reduce = 2;
+	opt.keep_going = true;
+	list<pair<dcp::NoteType, string> > notes;
+	BOOST_CHECK (!a->equals (c, opt, boost::bind (&store_note, &notes, _1, _2)));
+
+	list<pair<dcp::NoteType, string> > errors;
+	for (list<pair<dcp::NoteType, string> >::const_iterator i = notes.begin(); i != notes.end(); ++i) {
+		if (i->first == dcp::DCP_ERROR) {
+			errors.push_back (*i);
+		}
+	}
+
+	BOOST_REQUIRE_EQUAL (errors.size(), 1);
+	BOOST_CHECK (errors.front().second.find ("in frame 12") != string::npos);
+}
+
+/** Check that a reduced-resolution comparison which cannot be done falls back to full resolution */
+BOOST_AUTO_TEST_CASE (picture_asset_equals_reduce_too_far_test)
+{
+	boost::filesystem::create_directories ("build/test");
+	shared_ptr<dcp::MonoPictureAsset> a = write_squares ("build/test/picture_asset_equals_reduce_too_far_test_a.mxf", -1);
+	shared_ptr<dcp::MonoPictureAsset> c = write_squares ("build/test/picture_asset_equals_reduce_too_far_test_c.mxf", 12);
+
+	/* Much more than the number of decomposition levels in our frames */
+	dcp::EqualityOptions opt;
+	opt.reduce = 16;
+	list<pair<dcp::NoteType, string> > notes;
+	BOOST_CHECK (!a->equals (c, opt, boost::bind (&store_note, &notes, _1, _2)));
+
+	int errors = 0;
+	for (list<pair<dcp::NoteType, string> >::const_iterator i = notes.begin(); i != notes.end(); ++i) {
+		if (i->first == dcp::DCP_ERROR) {
+			++errors;
+			BOOST_CHECK (i->second.find ("in frame 12") != string::npos);
+		}
+	}
+	BOOST_CHECK_EQUAL (errors, 1);
+}
+
+/** Check that a frame whose differences are within the reduced-resolution limits is
+ *  accepted without being compared at full resolution.
+ */
+BOOST_AUTO_TEST_CASE (picture_asset_equals_reduce_accept_test)
+{
+	shared_ptr<dcp::OpenJPEGImage> xyz = test_xyz_image (0);
+	/* Change a 4x4 block slightly */
+	for (int y = 8; y < 12; ++y) {
+		for (int x = 8; x < 12; ++x) {
+			xyz->data(0)[y * 32 + x] += 8;
+		}
+	}
+	dcp::Data const slightly_different = dcp::compress_j2k (xyz, 100000000, 24, false, false);
+
+	boost::filesystem::create_directories ("build/test");
+	shared_ptr<dcp::MonoPictureAsset> a = write_squares ("build/test/picture_asset_equals_reduce_accept_test_a.mxf", 12, test_j2k_frame (0));
+	shared_ptr<dcp::MonoPictureAsset> b = write_squares ("build/test/picture_asset_equals_reduce_accept_test_b.mxf", 12, slightly_different);
+
+	dcp::EqualityOptions opt;
+	opt.max_mean_pixel_error = 5;
+	opt.max_std_dev_pixel_error = 5;
+	opt.reduce = 2;
+	opt.max_reduced_mean_pixel_error = 1;
+	opt.max_reduced_std_dev_pixel_error = 2;
+	list<pair<dcp::NoteType, string> > notes;
+	BOOST_CHECK (a->equals (b, opt, boost::bind (&store_note, &notes, _1, _2)));
+
+	bool reduced = false;
+	int approximate = 0;
+	for (list<pair<dcp::NoteType, string> >::const_iterator i = notes.begin(); i != notes.end(); ++i) {
+		BOOST_CHECK (i->first != dcp::DCP_ERROR);
+		if (i->second.find ("at reduced resolution") != string::npos) {
+			reduced = true;
+		}
+		if (i->second.find ("approximate") != string::npos) {
+			++approximate;
+		}
+	}
+	BOOST_CHECK (reduced);
+	/* The result should be flagged as approximate, but only once */
+	BOOST_CHECK_EQUAL (approximate, 1);
+}
+
+/** Check that an error in decoding a frame is thrown with its original type
+ *  whatever the number of threads that compare frames.
+ */
+BOOST_AUTO_TEST_CASE (picture_asset_equals_error_test)
+{
+	uint8_t const cod_marker[] = { 0xff, 0x52 };
+	/* Give the frame more decomposition levels in its COD marker than JPEG2000 allows;
+	   the MXF writer does not check this, but the decoder will refuse the frame.
+	*/
+	dcp::Data spoiled (boost::filesystem::path ("test/data/32x32_red_square.j2c"));
+	uint8_t* cod = std::search (spoiled.data().get(), spoiled.data().get() + spoiled.size(), cod_marker, cod_marker + 2);
+	BOOST_REQUIRE (cod != spoiled.data().get() + spoiled.size());
+	cod[9] = 40;
+
+	boost::filesystem::create_directories ("build/test");
+	shared_ptr<dcp::MonoPictureAsset> a = write_squares ("build/test/picture_asset_equals_error_test_a.mxf", -1);
+	shared_ptr<dcp::MonoPictureAsset> b = write_squares ("build/test/picture_asset_equals_error_test_b.mxf", 30, spoiled);
+
+	list<pair<dcp::NoteType, string> > notes;
+	BOOST_CHECK_THROW (picture_equals (a, b, 1, true, notes), dcp::MiscError);
+	BOOST_CHECK_THROW (picture_equals (a, b, 4, true, notes), dcp::MiscError);
+}
@@ -0,0 +1,130 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mono_picture_asset.h"
+#include "mono_picture_asset_reader.h"
+#include "mono_picture_frame.h"
+#include "openjpeg_image.h"
+#include "decode_pipeline.h"
+#include "j2k.h"
+#include "exceptions.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+#include <vector>
+
+using std::vector;
+using boost::shared_ptr;
+
+static void
+check_frame (int64_t n, shared_ptr<dcp::OpenJPEGImage> image, vector<shared_ptr<dcp::OpenJPEGImage> > const * references, vector<int64_t>* frames)
+{
+	frames->push_back (n);
+	shared_ptr<dcp::OpenJPEGImage> reference = (*references)[n];
+	BOOST_REQUIRE (image->size() == reference->size());
+	for (int c = 0; c < 3; ++c) {
+		BOOST_CHECK_EQUAL (memcmp (image->data(c), reference->data(c), image->size().width * image->size().height * sizeof (int)), 0);
+	}
+}
+
+static int
+j2k_size (shared_ptr<const dcp::MonoPictureFrame> frame)
+{
+	return frame->j2k_size ();
+}
+
+static void
+check_size (int64_t n, int size, vector<int> const * references, vector<int64_t>* frames)
+{
+	frames->push_back (n);
+	BOOST_CHECK_EQUAL (size, (*references)[n]);
+}
+
+/** Check that MonoPictureAsset::decode and decode_frames give the right frames in the right order */
+BOOST_AUTO_TEST_CASE (decode_pipeline_test)
+{
+	boost::filesystem::path const work_dir = "build/test/decode_pipeline_test";
+	boost::filesystem::remove_all (work_dir);
+	boost::filesystem::create_directories (work_dir);
+
+	shared_ptr<dcp::MonoPictureAsset> asset = write_test_frames (work_dir / "video.mxf", 24);
+
+	vector<shared_ptr<dcp::OpenJPEGImage> > images;
+	vector<int> sizes;
+	for (int i = 0; i < 24; ++i) {
+		dcp::Data const j2k = test_j2k_frame (i);
+		images.push_back (dcp::decompress_j2k (j2k, 0));
+		sizes.push_back (j2k.size ());
+	}
+
+	vector<int64_t> frames;
+	asset->decode (2, 20, boost::bind (&check_frame, _1, _2, &images, &frames), 4);
+	BOOST_REQUIRE_EQUAL (frames.size(), 18);
+	for (size_t i = 0; i < frames.size(); ++i) {
+		BOOST_CHECK_EQUAL (frames[i], i + 2);
+	}
+
+	/* Some other per-frame job, with a short queue */
+	frames.clear ();
+	dcp::decode_frames<ASDCP::JP2K::MXFReader, dcp::MonoPictureFrame, int> (
+		asset->start_read(), 0, 24, &j2k_size, boost::bind (&check_size, _1, _2, &sizes, &frames), 3, 1
+		);
+	BOOST_REQUIRE_EQUAL (frames.size(), 24);
+	for (size_t i = 0; i < frames.size(); ++i) {
+		BOOST_CHECK_EQUAL (frames[i], i);
+	}
+}
+
+/** Decode a copy of a frame's JPEG2000 data which has had its start-of-codestream marker spoiled */
+static int
+decode_spoiled (shared_ptr<const dcp::MonoPictureFrame> frame)
+{
+	vector<uint8_t> data (frame->j2k_data(), frame->j2k_data() + frame->j2k_size());
+	data[0] = data[1] = 0;
+	dcp::decompress_j2k (&data[0], data.size(), 0);
+	return 0;
+}
+
+static void
+ignore_frame (int64_t, int)
+{
+
+}
+
+/** Check that an error in decoding is thrown from decode_frames with its original type */
+BOOST_AUTO_TEST_CASE (decode_pipeline_error_test)
+{
+	boost::filesystem::path const work_dir = "build/test/decode_pipeline_error_test";
+	boost::filesystem::remove_all (work_dir);
+	boost::filesystem::create_directories (work_dir);
+
+	shared_ptr<dcp::MonoPictureAsset> asset = write_test_frames (work_dir / "video.mxf", 8);
+
+	/* This is what a serial decode throws */
+	BOOST_CHECK_THROW (decode_spoiled (asset->start_read()->get_frame (0)), dcp::MiscError);
+
+	for (int threads = 1; threads <= 4; threads += 3) {
+		BOOST_CHECK_THROW (
+			(dcp::decode_frames<ASDCP::JP2K::MXFReader, dcp::MonoPictureFrame, int> (
+				asset->start_read(), 0, 8, &decode_spoiled, &ignore_frame, threads
+				)),
+			dcp::MiscError
+			);
+	}
+}
@@ -0,0 +1,142 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "encode_pipeline.h"
+#include "mono_picture_asset.h"
+#include "mono_picture_asset_reader.h"
+#include "mono_picture_frame.h"
+#include "picture_asset_writer.h"
+#include "openjpeg_image.h"
+#include "colour_conversion.h"
+#include "rgb_xyz.h"
+#include "j2k.h"
+#include "exceptions.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+using std::vector;
+using boost::shared_ptr;
+
+static void
+check_frames (shared_ptr<dcp::MonoPictureAsset> asset, vector<dcp::Data> const & references)
+{
+	BOOST_REQUIRE_EQUAL (asset->intrinsic_duration(), int64_t (references.size()));
+
+	shared_ptr<dcp::MonoPictureAssetReader> reader = asset->start_read ();
+	for (size_t i = 0; i < references.size(); ++i) {
+		shared_ptr<const dcp::MonoPictureFrame> frame = reader->get_frame (i);
+		BOOST_REQUIRE_EQUAL (frame->j2k_size(), references[i].size());
+		BOOST_CHECK_EQUAL (memcmp (frame->j2k_data(), references[i].data().get(), references[i].size()), 0);
+	}
+}
+
+/** Write an asset of XYZ frames through an EncodePipeline and check that each frame is the
+ *  same as the one compress_j2k makes, in the same order.
+ */
+BOOST_AUTO_TEST_CASE (encode_pipeline_test)
+{
+	boost::filesystem::path const work_dir = "build/test/encode_pipeline_test";
+	boost::filesystem::remove_all (work_dir);
+	boost::filesystem::create_directories (work_dir);
+
+	shared_ptr<dcp::MonoPictureAsset> asset (new dcp::MonoPictureAsset (dcp::Fraction (24, 1), dcp::SMPTE));
+	shared_ptr<dcp::PictureAssetWriter> writer = asset->start_write (work_dir / "video.mxf", false);
+
+	dcp::EncodePipeline pipeline (writer, 100000000, 24, false, false, 4);
+	vector<dcp::Data> references;
+	for (int i = 0; i < 24; ++i) {
+		pipeline.encode (test_xyz_image (i));
+		references.push_back (test_j2k_frame (i));
+	}
+	pipeline.finish ();
+	writer->finalize ();
+
+	BOOST_CHECK_EQUAL (pipeline.timings().frames, 24);
+	check_frames (asset, references);
+
+	/* The pipeline's threads have gone, so it cannot take any more frames */
+	BOOST_CHECK_THROW (pipeline.encode (test_xyz_image (0)), dcp::ProgrammingError);
+}
+
+/** As encode_pipeline_test but with RGB frames, which the pipeline must convert to XYZ */
+BOOST_AUTO_TEST_CASE (encode_pipeline_rgb_test)
+{
+	boost::filesystem::path const work_dir = "build/test/encode_pipeline_rgb_test";
+	boost::filesystem::remove_all (work_dir);
+	boost::filesystem::create_directories (work_dir);
+
+	shared_ptr<dcp::MonoPictureAsset> asset (new dcp::MonoPictureAsset (dcp::Fraction (24, 1), dcp::SMPTE));
+	shared_ptr<dcp::PictureAssetWriter> writer = asset->start_write (work_dir / "video.mxf", false);
+
+	dcp::Size const size (32, 32);
+	/* Padded rows, to check that the stride is used */
+	int const stride = size.width * 6 + 16;
+
+	dcp::EncodePipeline pipeline (writer, 100000000, 24, false, false, 4, dcp::ColourConversion::srgb_to_xyz ());
+	vector<dcp::Data> references;
+	vector<uint8_t> rgb (size.height * stride);
+	for (int i = 0; i < 24; ++i) {
+		for (int y = 0; y < size.height; ++y) {
+			uint16_t* p = reinterpret_cast<uint16_t*> (&rgb[y * stride]);
+			for (int x = 0; x < size.width * 3; ++x) {
+				*p++ = (x * 1024 + y * 512 + i * 2731) & 0xffff;
+			}
+		}
+		pipeline.encode (&rgb[0], size, stride);
+		references.push_back (
+			dcp::compress_j2k (dcp::rgb_to_xyz (&rgb[0], size, stride, dcp::ColourConversion::srgb_to_xyz ()), 100000000, 24, false, false)
+			);
+	}
+	pipeline.finish ();
+	writer->finalize ();
+
+	BOOST_CHECK_EQUAL (pipeline.timings().frames, 24);
+	check_frames (asset, references);
+}
+
+static void
+encode_too_small (dcp::EncodePipeline* pipeline)
+{
+	for (int i = 0; i < 8; ++i) {
+		pipeline->encode (test_xyz_image (i));
+	}
+	/* Too small for the number of resolutions which compress_j2k asks for */
+	pipeline->encode (shared_ptr<dcp::OpenJPEGImage> (new dcp::OpenJPEGImage (dcp::Size (16, 16))));
+	pipeline->finish ();
+}
+
+/** Check that an error in compression is thrown from the pipeline with its original type */
+BOOST_AUTO_TEST_CASE (encode_pipeline_error_test)
+{
+	boost::filesystem::path const work_dir = "build/test/encode_pipeline_error_test";
+	boost::filesystem::remove_all (work_dir);
+	boost::filesystem::create_directories (work_dir);
+
+	/* This is what a serial compress throws */
+	BOOST_CHECK_THROW (
+		dcp::compress_j2k (shared_ptr<dcp::OpenJPEGImage> (new dcp::OpenJPEGImage (dcp::Size (16, 16))), 100000000, 24, false, false),
+		dcp::MiscError
+		);
+
+	shared_ptr<dcp::MonoPictureAsset> asset (new dcp::MonoPictureAsset (dcp::Fraction (24, 1), dcp::SMPTE));
+	shared_ptr<dcp::PictureAssetWriter> writer = asset->start_write (work_dir / "video.mxf", false);
+	dcp::EncodePipeline pipeline (writer, 100000000, 24, false, false, 4);
+	BOOST_CHECK_THROW (encode_too_small (&pipeline), dcp::MiscError);
+}
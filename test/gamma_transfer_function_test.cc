@@ -20,6 +20,7 @@
 #include "gamma_transfer_function.h"
 #include "modified_gamma_transfer_function.h"
 #include <boost/test/unit_test.hpp>
+#include <cmath>
 
 using boost::shared_ptr;
 
@@ -38,3 +39,22 @@ BOOST_AUTO_TEST_CASE (gamma_transfer_function_test)
 	shared_ptr<dcp::ModifiedGammaTransferFunction> c (new dcp::ModifiedGammaTransferFunction (2.4, 0.05, 1, 2));
 	BOOST_CHECK (!a->about_equal (c, 1));
 }
+
+/** Check that the float and uint16 LUTs match the double one, and that LUTs are only made once */
+BOOST_AUTO_TEST_CASE (gamma_transfer_function_lut_test)
+{
+	shared_ptr<dcp::GammaTransferFunction> a (new dcp::GammaTransferFunction (2.6));
+
+	double const * d = a->lut (12, true);
+	float const * f = a->float_lut (12, true);
+	uint16_t const * u = a->uint16_lut (12, true);
+	for (int i = 0; i < 4096; ++i) {
+		BOOST_CHECK_EQUAL (f[i], float (d[i]));
+		BOOST_CHECK_EQUAL (u[i], lrint (d[i] * 65535));
+	}
+
+	BOOST_CHECK_EQUAL (a->lut (12, true), d);
+	BOOST_CHECK_EQUAL (a->float_lut (12, true), f);
+	BOOST_CHECK_EQUAL (a->uint16_lut (12, true), u);
+	BOOST_CHECK (a->lut (12, false) != d);
+}
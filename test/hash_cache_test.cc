@@ -0,0 +1,149 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "hash_cache.h"
+#include "util.h"
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+
+using std::string;
+using boost::shared_ptr;
+
+static void
+write_file (boost::filesystem::path file, string content)
+{
+	FILE* f = fopen (file.string().c_str(), "w");
+	BOOST_REQUIRE (f);
+	fwrite (content.c_str(), content.length(), 1, f);
+	fclose (f);
+}
+
+/** Check that HashCache stores hashes, forgets them when files change, and persists them */
+BOOST_AUTO_TEST_CASE (hash_cache_test)
+{
+	boost::filesystem::path const dir = "build/test/hash_cache_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+	boost::filesystem::path const cache_file = dir / "cache";
+	boost::filesystem::path const data = dir / "data with spaces";
+	write_file (data, "Hello world");
+
+	{
+		dcp::HashCache cache (cache_file);
+		BOOST_CHECK (!cache.get (data));
+		cache.add (data, "abc");
+		BOOST_REQUIRE (cache.get (data));
+		BOOST_CHECK_EQUAL (cache.get(data).get(), "abc");
+		/* A different path to the same file should work too */
+		BOOST_CHECK (cache.get (dir / ".." / "hash_cache_test" / "data with spaces"));
+	}
+
+	{
+		dcp::HashCache cache (cache_file);
+		BOOST_REQUIRE (cache.get (data));
+		BOOST_CHECK_EQUAL (cache.get(data).get(), "abc");
+
+		/* Changing the file should invalidate the entry */
+		write_file (data, "Hello worlds");
+		BOOST_CHECK (!cache.get (data));
+
+		cache.add (data, "def");
+		BOOST_CHECK_EQUAL (cache.get(data).get(), "def");
+		cache.clear ();
+		BOOST_CHECK (!cache.get (data));
+	}
+
+	BOOST_CHECK (!boost::filesystem::exists (cache_file));
+}
+
+static int
+count_lines (boost::filesystem::path file)
+{
+	FILE* f = fopen (file.string().c_str(), "r");
+	BOOST_REQUIRE (f);
+	int lines = 0;
+	int c;
+	while ((c = fgetc (f)) != EOF) {
+		if (c == '\n') {
+			++lines;
+		}
+	}
+	fclose (f);
+	return lines;
+}
+
+/** Check that a HashCache's file is compacted when it is opened */
+BOOST_AUTO_TEST_CASE (hash_cache_compact_test)
+{
+	boost::filesystem::path const dir = "build/test/hash_cache_compact_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+	boost::filesystem::path const cache_file = dir / "cache";
+	write_file (dir / "a", "Hello world");
+	write_file (dir / "b", "Hello world");
+
+	{
+		dcp::HashCache cache (cache_file);
+		cache.add (dir / "a", "abc");
+		cache.add (dir / "a", "def");
+		cache.add (dir / "b", "ghi");
+	}
+	BOOST_CHECK_EQUAL (count_lines (cache_file), 3);
+
+	/* The superseded entry for a should go */
+	{
+		dcp::HashCache cache (cache_file);
+		BOOST_CHECK_EQUAL (cache.get(dir / "a").get(), "def");
+		BOOST_CHECK_EQUAL (cache.get(dir / "b").get(), "ghi");
+	}
+	BOOST_CHECK_EQUAL (count_lines (cache_file), 2);
+
+	/* and so should the one for a file which no longer exists */
+	boost::filesystem::remove (dir / "b");
+	{
+		dcp::HashCache cache (cache_file);
+		BOOST_CHECK_EQUAL (cache.get(dir / "a").get(), "def");
+	}
+	BOOST_CHECK_EQUAL (count_lines (cache_file), 1);
+}
+
+/** Check that make_digest uses and fills the global hash cache */
+BOOST_AUTO_TEST_CASE (hash_cache_make_digest_test)
+{
+	boost::filesystem::path const dir = "build/test/hash_cache_make_digest_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+	boost::filesystem::path const data = dir / "data";
+	write_file (data, "Hello world");
+
+	string const digest = dcp::make_digest (data, 0);
+
+	shared_ptr<dcp::HashCache> cache (new dcp::HashCache (dir / "cache"));
+	dcp::set_hash_cache (cache);
+	BOOST_CHECK_EQUAL (dcp::make_digest (data, 0), digest);
+	BOOST_REQUIRE (cache->get (data));
+	BOOST_CHECK_EQUAL (cache->get(data).get(), digest);
+
+	/* A primed hash should be used by make_digest */
+	cache->add (data, "primed");
+	BOOST_CHECK_EQUAL (dcp::make_digest (data, 0), "primed");
+
+	dcp::set_hash_cache (shared_ptr<dcp::HashCache> ());
+	BOOST_CHECK_EQUAL (dcp::make_digest (data, 0), digest);
+}
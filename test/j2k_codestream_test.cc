@@ -0,0 +1,100 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "j2k_codestream.h"
+#include "file.h"
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+using std::vector;
+
+static vector<uint8_t>
+red_square ()
+{
+	dcp::File f ("test/data/32x32_red_square.j2c");
+	return vector<uint8_t> (f.data(), f.data() + f.size());
+}
+
+/** Find a marker segment in a codestream's main header and return its offset, or -1 */
+static int
+find_marker (vector<uint8_t> const & data, int marker)
+{
+	for (size_t p = 2; p + 4 <= data.size(); p += 2 + ((data[p + 2] << 8) | data[p + 3])) {
+		int const m = (data[p] << 8) | data[p + 1];
+		if (m == marker) {
+			return p;
+		} else if (m == 0xff90) {
+			break;
+		}
+	}
+	return -1;
+}
+
+static vector<int>
+different_tiles (vector<uint8_t> const & a, vector<uint8_t> const & b)
+{
+	dcp::J2KCodestream A (&a[0], a.size());
+	dcp::J2KCodestream B (&b[0], b.size());
+	BOOST_REQUIRE (A.valid ());
+	BOOST_REQUIRE (B.valid ());
+	return A.different_tiles (B);
+}
+
+/** Check that J2KCodestream ignores comments and packet length markers but not image data */
+BOOST_AUTO_TEST_CASE (j2k_codestream_test)
+{
+	vector<uint8_t> const ref = red_square ();
+
+	dcp::J2KCodestream codestream (&ref[0], ref.size());
+	BOOST_REQUIRE (codestream.valid ());
+	BOOST_CHECK_EQUAL (codestream.tiles(), 1);
+	BOOST_CHECK (different_tiles (ref, ref).empty ());
+
+	/* Change the comment */
+	vector<uint8_t> comment = ref;
+	int const com = find_marker (comment, 0xff64);
+	BOOST_REQUIRE (com > 0);
+	comment[com + 8] ^= 0x20;
+	BOOST_CHECK (different_tiles (ref, comment).empty ());
+
+	/* Remove the TLM */
+	vector<uint8_t> tlm = ref;
+	int const t = find_marker (tlm, 0xff55);
+	BOOST_REQUIRE (t > 0);
+	tlm.erase (tlm.begin() + t, tlm.begin() + t + 2 + ((tlm[t + 2] << 8) | tlm[t + 3]));
+	BOOST_CHECK (different_tiles (ref, tlm).empty ());
+
+	/* Change the quantization */
+	vector<uint8_t> qcd = ref;
+	int const q = find_marker (qcd, 0xff5c);
+	BOOST_REQUIRE (q > 0);
+	qcd[q + 6] ^= 0x01;
+	BOOST_CHECK_EQUAL (different_tiles (ref, qcd).size(), 1);
+
+	/* Change the last byte of packet data, before the EOC */
+	vector<uint8_t> packet = ref;
+	packet[packet.size() - 3] ^= 0x01;
+	vector<int> const d = different_tiles (ref, packet);
+	BOOST_REQUIRE_EQUAL (d.size(), 1);
+	BOOST_CHECK_EQUAL (d.front(), 0);
+
+	/* Truncated codestreams cannot be parsed */
+	BOOST_CHECK (!dcp::J2KCodestream (&ref[0], ref.size() - 20).valid ());
+	BOOST_CHECK (!dcp::J2KCodestream (&ref[0], 3).valid ());
+}
@@ -0,0 +1,52 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "j2k.h"
+#include "openjpeg_image.h"
+#include "data.h"
+#include "file.h"
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+using std::vector;
+using boost::shared_ptr;
+
+/** Check that compressing into a caller's vector gives the same result as compressing
+ *  into a new Data, and that re-using the vector does not re-allocate it.
+ */
+BOOST_AUTO_TEST_CASE (compress_j2k_reuse_buffer_test)
+{
+	dcp::File j2c ("test/data/32x32_red_square.j2c");
+
+	/* Images are overwritten by compress_j2k so we need a new one each time */
+	dcp::Data const reference = dcp::compress_j2k (dcp::decompress_j2k (j2c.data(), j2c.size(), 0), 100000000, 24, false, false);
+
+	vector<uint8_t> buffer;
+	dcp::compress_j2k (dcp::decompress_j2k (j2c.data(), j2c.size(), 0), 100000000, 24, false, false, buffer);
+	BOOST_REQUIRE_EQUAL (int (buffer.size()), reference.size());
+	BOOST_CHECK_EQUAL (memcmp (&buffer[0], reference.data().get(), reference.size()), 0);
+
+	uint8_t const * first = &buffer[0];
+	for (int i = 0; i < 4; ++i) {
+		dcp::compress_j2k (dcp::decompress_j2k (j2c.data(), j2c.size(), 0), 100000000, 24, false, false, buffer);
+		BOOST_CHECK (&buffer[0] == first);
+		BOOST_REQUIRE_EQUAL (int (buffer.size()), reference.size());
+		BOOST_CHECK_EQUAL (memcmp (&buffer[0], reference.data().get(), reference.size()), 0);
+	}
+}
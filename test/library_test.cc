@@ -0,0 +1,114 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "library.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/algorithm/string.hpp>
+#include <fstream>
+#include <iterator>
+
+using std::string;
+using std::list;
+
+static void
+copy_dcp (boost::filesystem::path from, boost::filesystem::path to)
+{
+	boost::filesystem::create_directories (to);
+	for (boost::filesystem::directory_iterator i(from); i != boost::filesystem::directory_iterator(); ++i) {
+		boost::filesystem::copy_file (i->path(), to / i->path().filename());
+	}
+}
+
+static list<string>
+titles (dcp::Library const & library)
+{
+	list<string> t;
+	list<dcp::LibraryDCP> dcps = library.dcps ();
+	for (list<dcp::LibraryDCP>::const_iterator i = dcps.begin(); i != dcps.end(); ++i) {
+		BOOST_REQUIRE_EQUAL (i->cpls.size(), 1);
+		t.push_back (i->cpls.front().content_title_text);
+	}
+	return t;
+}
+
+/** Scan a tree containing two DCPs, reload the index, then check that rescans only read DCPs which have changed */
+BOOST_AUTO_TEST_CASE (library_test)
+{
+	boost::filesystem::path const dir = "build/test/library_test";
+	boost::filesystem::remove_all (dir);
+	copy_dcp ("test/ref/DCP/dcp_test1", dir / "tree" / "a" / "one");
+	copy_dcp ("test/ref/DCP/dcp_test3", dir / "tree" / "b" / "c" / "three");
+
+	boost::filesystem::path const index = dir / "library.xml";
+
+	{
+		dcp::Library library (index);
+		library.scan (dir / "tree", 2);
+		BOOST_CHECK (library.errors().empty ());
+		list<string> t = titles (library);
+		BOOST_REQUIRE_EQUAL (t.size(), 2);
+		BOOST_CHECK_EQUAL (t.front(), "A Test DCP");
+		BOOST_CHECK_EQUAL (t.back(), "Test_FTR-1_F-119_10_2K_20160524_IOP_OV");
+
+		dcp::LibraryDCP const one = library.dcps().front ();
+		BOOST_REQUIRE (one.standard);
+		BOOST_CHECK_EQUAL (*one.standard, dcp::SMPTE);
+		BOOST_CHECK_EQUAL (one.assets.size(), 2);
+		BOOST_CHECK_EQUAL (one.cpls.front().duration, 24);
+		BOOST_CHECK_EQUAL (one.cpls.front().asset_ids.size(), 2);
+	}
+
+	/* Reading the index back should give the same thing */
+	dcp::Library library (index);
+	list<string> t = titles (library);
+	BOOST_REQUIRE_EQUAL (t.size(), 2);
+	BOOST_CHECK_EQUAL (t.front(), "A Test DCP");
+	BOOST_CHECK_EQUAL (t.back(), "Test_FTR-1_F-119_10_2K_20160524_IOP_OV");
+	BOOST_CHECK_EQUAL (library.dcps().front().assets.size(), 2);
+
+	/* Change the title in one CPL but keep its modification time; a rescan should not notice */
+	boost::filesystem::path const cpl = dir / "tree" / "a" / "one" / "cpl_81fb54df-e1bf-4647-8788-ea7ba154375b.xml";
+	std::time_t const mtime = boost::filesystem::last_write_time (cpl);
+	string xml;
+	{
+		std::ifstream in (cpl.string().c_str());
+		xml = string (std::istreambuf_iterator<char> (in), std::istreambuf_iterator<char> ());
+	}
+	boost::algorithm::replace_all (xml, "<ContentTitleText>A Test DCP", "<ContentTitleText>A Changed DCP");
+	{
+		std::ofstream out (cpl.string().c_str());
+		out << xml;
+	}
+	boost::filesystem::last_write_time (cpl, mtime);
+
+	library.scan (dir / "tree", 2);
+	BOOST_CHECK_EQUAL (titles(library).front(), "A Test DCP");
+
+	/* Now change the time, and it should */
+	boost::filesystem::last_write_time (cpl, mtime + 60);
+	library.scan (dir / "tree", 2);
+	BOOST_CHECK_EQUAL (titles(library).front(), "A Changed DCP");
+
+	/* Removing a DCP should remove it from the library */
+	boost::filesystem::remove_all (dir / "tree" / "b");
+	library.scan (dir / "tree");
+	t = titles (library);
+	BOOST_REQUIRE_EQUAL (t.size(), 1);
+	BOOST_CHECK_EQUAL (t.front(), "A Changed DCP");
+}
@@ -0,0 +1,137 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** @file  test/lut_bench.cc
+ *  @brief Measure the cost of fetching TransferFunction LUTs from many threads at once,
+ *  compared with the mutex-and-map scheme that TransferFunction used to use.
+ */
+
+#include "gamma_transfer_function.h"
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <sys/time.h>
+#include <iostream>
+#include <cstdlib>
+#include <map>
+
+using std::cout;
+using std::cerr;
+using std::map;
+using std::pair;
+using std::make_pair;
+using boost::shared_ptr;
+
+/** The LUT cache as it was before it became lock-free */
+class LockedCache
+{
+public:
+	explicit LockedCache (shared_ptr<const dcp::TransferFunction> tf)
+		: _tf (tf)
+	{}
+
+	double const * lut (int bit_depth, bool inverse) const
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+
+		map<pair<int, bool>, double const *>::const_iterator i = _luts.find (make_pair (bit_depth, inverse));
+		if (i != _luts.end ()) {
+			return i->second;
+		}
+
+		_luts[make_pair(bit_depth, inverse)] = _tf->lut (bit_depth, inverse);
+		return _luts[make_pair(bit_depth, inverse)];
+	}
+
+private:
+	shared_ptr<const dcp::TransferFunction> _tf;
+	mutable map<pair<int, bool>, double const *> _luts;
+	mutable boost::mutex _mutex;
+};
+
+static double
+seconds ()
+{
+	struct timeval t;
+	gettimeofday (&t, 0);
+	return t.tv_sec + t.tv_usec / 1e6;
+}
+
+/* Each thread fetches the two LUTs that rgb_to_xyz uses, over and over, and
+   sums a value from each so that the fetches cannot be optimised away.  The sum
+   is kept locally and only stored at the end, so that the threads do not share
+   cache lines while they are being timed.
+*/
+
+static void
+lock_free (shared_ptr<const dcp::TransferFunction> tf, int calls, double* sum)
+{
+	double s = 0;
+	for (int i = 0; i < calls; ++i) {
+		s += tf->lut(12, false)[i & 4095] + tf->lut(16, true)[i & 65535];
+	}
+	*sum = s;
+}
+
+static void
+locked (LockedCache const * cache, int calls, double* sum)
+{
+	double s = 0;
+	for (int i = 0; i < calls; ++i) {
+		s += cache->lut(12, false)[i & 4095] + cache->lut(16, true)[i & 65535];
+	}
+	*sum = s;
+}
+
+static double
+run (int threads, boost::function<void (double *)> fn)
+{
+	double* sums = new double[threads];
+	double const start = seconds ();
+	boost::thread_group group;
+	for (int i = 0; i < threads; ++i) {
+		sums[i] = 0;
+		group.create_thread (boost::bind (fn, &sums[i]));
+	}
+	group.join_all ();
+	double const taken = seconds () - start;
+	delete[] sums;
+	return taken;
+}
+
+int
+main (int argc, char* argv[])
+{
+	int const threads = argc > 1 ? atoi (argv[1]) : 32;
+	int const calls = argc > 2 ? atoi (argv[2]) : 1000000;
+
+	shared_ptr<const dcp::TransferFunction> tf (new dcp::GammaTransferFunction (2.6));
+	LockedCache cache (tf);
+
+	/* Make the LUTs before we start timing */
+	double dummy = 0;
+	lock_free (tf, 1, &dummy);
+
+	double const lock_free_time = run (threads, boost::bind (&lock_free, tf, calls, _1));
+	double const locked_time = run (threads, boost::bind (&locked, &cache, calls, _1));
+
+	double const total = double (threads) * calls * 2;
+	cout << threads << " threads, " << calls << " pairs of LUT fetches per thread\n";
+	cout << "Lock-free: " << total / lock_free_time / 1e6 << "M fetches/s.\n";
+	cout << "Locked:    " << total / locked_time / 1e6 << "M fetches/s.\n";
+}
@@ -23,6 +23,8 @@
 #include <boost/test/unit_test.hpp>
 #include <sys/time.h>
 
+using std::string;
+
 void progress (float)
 {
 
@@ -44,3 +46,43 @@ BOOST_AUTO_TEST_CASE (make_digest_test)
 	/* Hash it */
 	BOOST_CHECK_EQUAL (dcp::make_digest ("build/test/random", boost::bind (&progress, _1)), "GKbk/V3fcRtP5MaPdSmAGNbKkaU=");
 }
+
+static void
+count_progress (float p, int* calls, float* last)
+{
+	++*calls;
+	*last = p;
+}
+
+/** Check that make_digest gives the same answer whatever its block size, including
+ *  sizes which the file is not a multiple of, and that it calls its progress function
+ *  at least once but not too often.
+ */
+BOOST_AUTO_TEST_CASE (make_digest_block_size_test)
+{
+	/* A few MB, and not a multiple of any of the block sizes */
+	int const N = 3 * 1024 * 1024 + 17;
+	dcp::Data data (N);
+	uint8_t* p = data.data().get();
+	srand (2);
+	for (int i = 0; i < N; ++i) {
+		*p++ = rand() & 0xff;
+	}
+	data.write ("build/test/make_digest_block_size_test");
+
+	string const reference = dcp::make_digest (data);
+
+	/* The last two are read in a single block */
+	int const block_sizes[] = { 4095, 65536, 1024 * 1024, N, 4 * 1024 * 1024 };
+	for (int i = 0; i < 5; ++i) {
+		int calls = 0;
+		float last = 0;
+		BOOST_CHECK_EQUAL (
+			dcp::make_digest ("build/test/make_digest_block_size_test", boost::bind (&count_progress, _1, &calls, &last), block_sizes[i]),
+			reference
+			);
+		BOOST_CHECK (calls >= 1);
+		BOOST_CHECK (calls <= 101);
+		BOOST_CHECK_EQUAL (last, 1);
+	}
+}
@@ -0,0 +1,183 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pcm_simd.h"
+#include "rgb_xyz_simd.h"
+#include "sound_asset.h"
+#include "sound_asset_writer.h"
+#include "sound_asset_reader.h"
+#include "sound_frame.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/random.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include <vector>
+#include <cstring>
+
+using std::vector;
+using std::string;
+using boost::shared_ptr;
+
+static void
+note_handler (dcp::NoteType, string)
+{
+
+}
+
+/** Check some packed samples against values worked out by hand */
+BOOST_AUTO_TEST_CASE (pcm_simd_test)
+{
+	float const left[] = { 0, 0.5, -0.5, 2, -2 };
+	float const right[] = { 1.0 / (1 << 23), -1.0 / (1 << 23), 0.25, 1, -1 };
+	float const * data[] = { left, right };
+
+	uint8_t out[5 * 2 * 3];
+	dcp::simd::pack_pcm_24 (data, 2, 0, 5, out);
+
+	uint8_t const check[] = {
+		0x00, 0x00, 0x00,  0x01, 0x00, 0x00,
+		0x00, 0x00, 0x40,  0xff, 0xff, 0xff,
+		0x00, 0x00, 0xc0,  0x00, 0x00, 0x20,
+		0xff, 0xff, 0x7f,  0xff, 0xff, 0x7f,
+		0x01, 0x00, 0x80,  0x01, 0x00, 0x80
+	};
+
+	BOOST_CHECK_EQUAL_COLLECTIONS (out, out + sizeof (out), check, check + sizeof (check));
+
+	/* The same values from int32_ts, including some out-of-range ones */
+	int32_t const left_int[] = { 0, 1 << 22, -(1 << 22), 1 << 24, -(1 << 24) };
+	int32_t const right_int[] = { 1, -1, 1 << 21, (1 << 23) - 1, -(1 << 23) + 1 };
+	int32_t const * data_int[] = { left_int, right_int };
+
+	dcp::simd::pack_pcm_24 (data_int, 2, 0, 5, out);
+	/* -(1 << 24) clips to -(1 << 23), which is one further than the float version goes */
+	uint8_t check_int[sizeof (check)];
+	memcpy (check_int, check, sizeof (check));
+	check_int[24] = 0x00;
+
+	BOOST_CHECK_EQUAL_COLLECTIONS (out, out + sizeof (out), check_int, check_int + sizeof (check_int));
+}
+
+/** Check that the SIMD versions of pack_pcm_24 give the same results as the scalar one */
+BOOST_AUTO_TEST_CASE (pcm_simd_levels_test)
+{
+	boost::random::mt19937 rng (42);
+	boost::random::uniform_real_distribution<float> sample (-1.5, 1.5);
+
+	/* Odd numbers of frames and an offset so that the scalar tails are used too */
+	int const frames = 1000 + 7;
+	int const offset = 3;
+
+	dcp::simd::Level const old_level = dcp::simd::level ();
+
+	for (int channels = 1; channels <= 16; ++channels) {
+		vector<vector<float> > planes (channels, vector<float> (offset + frames));
+		vector<float const *> data (channels);
+		for (int i = 0; i < channels; ++i) {
+			for (int j = 0; j < offset + frames; ++j) {
+				planes[i][j] = sample (rng);
+			}
+			data[i] = &planes[i][0];
+		}
+
+		dcp::simd::set_level (dcp::simd::LEVEL_SCALAR);
+		vector<uint8_t> ref (frames * channels * 3);
+		dcp::simd::pack_pcm_24 (&data[0], channels, offset, frames, &ref[0]);
+
+		for (int l = dcp::simd::LEVEL_SSE2; l <= dcp::simd::best_level(); ++l) {
+			dcp::simd::set_level (static_cast<dcp::simd::Level> (l));
+			vector<uint8_t> out (frames * channels * 3);
+			dcp::simd::pack_pcm_24 (&data[0], channels, offset, frames, &out[0]);
+			BOOST_CHECK (out == ref);
+		}
+	}
+
+	dcp::simd::set_level (old_level);
+}
+
+/** Write the same samples as floats and as int32_ts, in chunks which do not line up with
+ *  MXF frames, and check that the two assets match.
+ */
+BOOST_AUTO_TEST_CASE (sound_asset_writer_int_test)
+{
+	int const channels = 6;
+	int const frames = 48000 + 1234;
+	int const chunk = 1500;
+
+	vector<vector<float> > float_planes (channels, vector<float> (frames));
+	vector<vector<int32_t> > int_planes (channels, vector<int32_t> (frames));
+	for (int i = 0; i < channels; ++i) {
+		for (int j = 0; j < frames; ++j) {
+			/* Samples in [-(2^23 - 1), 2^23 - 1], the range which the float path can give */
+			int32_t const s = ((j * 977 + i * 131) % ((1 << 24) - 1)) - ((1 << 23) - 1);
+			int_planes[i][j] = s;
+			float_planes[i][j] = float (s) / (1 << 23);
+		}
+	}
+
+	boost::filesystem::path dir = "build/test/sound_asset_writer_int_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	shared_ptr<dcp::SoundAsset> float_asset (new dcp::SoundAsset (dcp::Fraction (24, 1), 48000, channels, dcp::SMPTE));
+	shared_ptr<dcp::SoundAssetWriter> float_writer = float_asset->start_write (dir / "float.mxf");
+	shared_ptr<dcp::SoundAsset> int_asset (new dcp::SoundAsset (dcp::Fraction (24, 1), 48000, channels, dcp::SMPTE));
+	shared_ptr<dcp::SoundAssetWriter> int_writer = int_asset->start_write (dir / "int.mxf");
+
+	for (int i = 0; i < frames; i += chunk) {
+		int const n = std::min (chunk, frames - i);
+		vector<float const *> float_data (channels);
+		vector<int32_t const *> int_data (channels);
+		for (int j = 0; j < channels; ++j) {
+			float_data[j] = &float_planes[j][i];
+			int_data[j] = &int_planes[j][i];
+		}
+		float_writer->write (&float_data[0], n);
+		int_writer->write (&int_data[0], n);
+	}
+
+	float_writer->finalize ();
+	int_writer->finalize ();
+
+	BOOST_CHECK_EQUAL (float_asset->intrinsic_duration(), 25);
+	BOOST_CHECK (float_asset->equals (int_asset, dcp::EqualityOptions (), boost::bind (&note_handler, _1, _2)));
+
+	/* Check a frame which spans two of our writes byte for byte */
+	vector<uint8_t> check;
+	for (int i = 2000 * 3; i < 2000 * 4; ++i) {
+		for (int j = 0; j < channels; ++j) {
+			int32_t const s = int_planes[j][i];
+			check.push_back (s & 0xff);
+			check.push_back ((s & 0xff00) >> 8);
+			check.push_back ((s & 0xff0000) >> 16);
+		}
+	}
+	shared_ptr<const dcp::SoundFrame> float_frame = float_asset->start_read()->get_frame (3);
+	BOOST_CHECK_EQUAL_COLLECTIONS (float_frame->data(), float_frame->data() + float_frame->size(), check.begin(), check.end());
+	shared_ptr<const dcp::SoundFrame> int_frame = int_asset->start_read()->get_frame (3);
+	BOOST_CHECK_EQUAL_COLLECTIONS (int_frame->data(), int_frame->data() + int_frame->size(), check.begin(), check.end());
+
+	/* The final partial frame should be padded with silence */
+	shared_ptr<dcp::SoundAssetReader> reader = int_asset->start_read ();
+	shared_ptr<const dcp::SoundFrame> last = reader->get_frame (24);
+	BOOST_CHECK_EQUAL (last->get (0, 1233), int_planes[0][frames - 1] & 0xffffff);
+	BOOST_CHECK_EQUAL (last->get (5, 1234), 0);
+	BOOST_CHECK_EQUAL (last->get (0, 1999), 0);
+}
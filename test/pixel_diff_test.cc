@@ -0,0 +1,83 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pixel_diff.h"
+#include "rgb_xyz_simd.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/random.hpp>
+#include <vector>
+#include <cmath>
+
+using std::vector;
+
+/** Check the statistics of some differences against values worked out by hand */
+BOOST_AUTO_TEST_CASE (pixel_diff_test)
+{
+	int const a[] = { 10, 20, 30, 40, 50 };
+	int const b[] = { 12, 20, 25, 40, 51 };
+
+	dcp::simd::DiffStats stats;
+	dcp::simd::accumulate_difference (a, b, 5, stats);
+	BOOST_CHECK_EQUAL (stats.count, 5);
+	BOOST_CHECK_EQUAL (stats.sum, 8);
+	BOOST_CHECK_EQUAL (stats.sum_of_squares, 30);
+	BOOST_CHECK_EQUAL (stats.max, 5);
+	BOOST_CHECK_CLOSE (stats.mean (), 1.6, 1e-9);
+	BOOST_CHECK_CLOSE (stats.standard_deviation (), sqrt (30.0 / 5 - 1.6 * 1.6), 1e-9);
+
+	dcp::simd::DiffStats empty;
+	BOOST_CHECK_EQUAL (empty.mean (), 0);
+	BOOST_CHECK_EQUAL (empty.standard_deviation (), 0);
+}
+
+/** Check that the SIMD versions of accumulate_difference give the same results as the scalar one */
+BOOST_AUTO_TEST_CASE (pixel_diff_simd_test)
+{
+	boost::random::mt19937 rng (42);
+	boost::random::uniform_int_distribution<> sample (0, 4095);
+
+	/* An odd length so that the scalar tails are used too */
+	int const n = 4096 * 3 + 5;
+	vector<int> a (n);
+	vector<int> b (n);
+	for (int i = 0; i < n; ++i) {
+		a[i] = sample (rng);
+		b[i] = sample (rng);
+	}
+
+	dcp::simd::Level const old_level = dcp::simd::level ();
+
+	dcp::simd::set_level (dcp::simd::LEVEL_SCALAR);
+	dcp::simd::DiffStats ref;
+	dcp::simd::accumulate_difference (&a[0], &b[0], n, ref);
+
+	for (int l = dcp::simd::LEVEL_SSE2; l <= dcp::simd::best_level(); ++l) {
+		dcp::simd::set_level (static_cast<dcp::simd::Level> (l));
+		dcp::simd::DiffStats stats;
+		/* Two calls, to check that the totals carry on */
+		dcp::simd::accumulate_difference (&a[0], &b[0], 1001, stats);
+		dcp::simd::accumulate_difference (&a[1001], &b[1001], n - 1001, stats);
+		BOOST_CHECK_EQUAL (stats.count, ref.count);
+		BOOST_CHECK_EQUAL (stats.sum, ref.sum);
+		BOOST_CHECK_EQUAL (stats.sum_of_squares, ref.sum_of_squares);
+		BOOST_CHECK_EQUAL (stats.max, ref.max);
+	}
+
+	dcp::simd::set_level (old_level);
+}
@@ -21,6 +21,14 @@
 #include <boost/optional/optional_io.hpp>
 #include "dcp.h"
 #include "cpl.h"
+#include "reel.h"
+#include "reel_picture_asset.h"
+#include "mono_picture_asset.h"
+#include "reel_subtitle_asset.h"
+#include "reel_closed_caption_asset.h"
+#include "smpte_subtitle_asset.h"
+#include "exceptions.h"
+#include <cstdio>
 
 using std::list;
 using boost::shared_ptr;
@@ -54,3 +62,130 @@ BOOST_AUTO_TEST_CASE (read_dcp_test2)
 	BOOST_REQUIRE (d.standard());
 	BOOST_CHECK_EQUAL (d.standard(), dcp::INTEROP);
 }
+
+/** Check that reading a DCP on several threads gives the same result as reading it on one */
+BOOST_AUTO_TEST_CASE (read_dcp_threads_test)
+{
+	dcp::DCP a ("test/ref/DCP/dcp_test3");
+	a.read ();
+	dcp::DCP b ("test/ref/DCP/dcp_test3");
+	b.read (false, 0, false, 4);
+
+	BOOST_REQUIRE_EQUAL (a.cpls().size(), b.cpls().size());
+	BOOST_CHECK_EQUAL (a.cpls().front()->id(), b.cpls().front()->id());
+
+	list<shared_ptr<dcp::Asset> > aa = a.assets ();
+	list<shared_ptr<dcp::Asset> > ba = b.assets ();
+	BOOST_REQUIRE_EQUAL (aa.size(), ba.size());
+	list<shared_ptr<dcp::Asset> >::const_iterator i = aa.begin ();
+	list<shared_ptr<dcp::Asset> >::const_iterator j = ba.begin ();
+	while (i != aa.end ()) {
+		BOOST_CHECK_EQUAL ((*i)->id(), (*j)->id());
+		++i;
+		++j;
+	}
+
+	/* A missing asset should be reported in the same way too */
+	boost::filesystem::path const dir = "build/test/read_dcp_threads_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+	for (boost::filesystem::directory_iterator i("test/ref/DCP/dcp_test1"); i != boost::filesystem::directory_iterator(); ++i) {
+		if (i->path().filename() != "audio.mxf") {
+			boost::filesystem::copy_file (i->path(), dir / i->path().filename());
+		}
+	}
+
+	dcp::DCP c (dir);
+	dcp::DCP::ReadErrors errors;
+	c.read (true, &errors, false, 4);
+	BOOST_REQUIRE_EQUAL (errors.size(), 1);
+	BOOST_CHECK (boost::dynamic_pointer_cast<dcp::MissingAssetError> (errors.front ()));
+	BOOST_CHECK_THROW (dcp::DCP(dir).read (false, 0, false, 4), dcp::MissingAssetError);
+}
+
+/** Check that a lazy read only opens MXFs when they are needed */
+BOOST_AUTO_TEST_CASE (read_dcp_lazy_test)
+{
+	boost::filesystem::path const dir = "build/test/read_dcp_lazy_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+	for (boost::filesystem::directory_iterator i("test/ref/DCP/dcp_test1"); i != boost::filesystem::directory_iterator(); ++i) {
+		boost::filesystem::copy_file (i->path(), dir / i->path().filename());
+	}
+
+	{
+		dcp::DCP d (dir);
+		d.read (false, 0, false, 1, true);
+		BOOST_REQUIRE_EQUAL (d.cpls().size(), 1);
+		BOOST_CHECK_EQUAL (d.cpls().front()->annotation_text(), "A Test DCP");
+
+		shared_ptr<dcp::ReelPictureAsset> picture = d.cpls().front()->reels().front()->main_picture();
+		BOOST_REQUIRE (picture);
+		BOOST_CHECK (picture->asset_ref().resolved ());
+		shared_ptr<dcp::MonoPictureAsset> mono = boost::dynamic_pointer_cast<dcp::MonoPictureAsset> (picture->asset_ref().asset());
+		BOOST_REQUIRE (mono);
+		BOOST_CHECK_EQUAL (mono->intrinsic_duration(), 24);
+		/* Asking again should give the same asset */
+		BOOST_CHECK (picture->asset_ref().asset() == mono);
+	}
+
+	/* Spoil the picture MXF; a lazy read should not notice, but using the asset should */
+	FILE* f = fopen ((dir / "video.mxf").string().c_str(), "wb");
+	BOOST_REQUIRE (f);
+	fclose (f);
+
+	BOOST_CHECK_THROW (dcp::DCP(dir).read (), dcp::DCPReadError);
+
+	dcp::DCP d (dir);
+	d.read (false, 0, false, 1, true);
+	BOOST_REQUIRE_EQUAL (d.cpls().size(), 1);
+	BOOST_CHECK_THROW (d.cpls().front()->reels().front()->main_picture()->asset_ref().asset(), dcp::DCPReadError);
+}
+
+/** Check that a lazy read of a DCP with SMPTE subtitles and closed captions does not open their MXFs */
+BOOST_AUTO_TEST_CASE (read_dcp_lazy_subtitle_test)
+{
+	boost::filesystem::path const dir = "build/test/read_dcp_lazy_subtitle_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	shared_ptr<dcp::SMPTESubtitleAsset> subs (new dcp::SMPTESubtitleAsset ());
+	subs->add_font ("theFontId", "test/data/dummy.ttf");
+	subs->write (dir / "subs.mxf");
+
+	shared_ptr<dcp::SMPTESubtitleAsset> ccap (new dcp::SMPTESubtitleAsset ());
+	ccap->add_font ("theFontId", "test/data/dummy.ttf");
+	ccap->write (dir / "ccap.mxf");
+
+	shared_ptr<dcp::Reel> reel (new dcp::Reel ());
+	reel->add (shared_ptr<dcp::ReelAsset> (new dcp::ReelSubtitleAsset (subs, dcp::Fraction (24, 1), 24, 0)));
+	reel->add (shared_ptr<dcp::ReelAsset> (new dcp::ReelClosedCaptionAsset (ccap, dcp::Fraction (24, 1), 24, 0)));
+	shared_ptr<dcp::CPL> cpl (new dcp::CPL ("", dcp::TRAILER));
+	cpl->add (reel);
+
+	dcp::DCP writer (dir);
+	writer.add (cpl);
+	writer.write_xml (dcp::SMPTE);
+
+	/* Spoil both MXFs; a lazy read should not notice */
+	FILE* f = fopen ((dir / "subs.mxf").string().c_str(), "wb");
+	BOOST_REQUIRE (f);
+	fclose (f);
+	f = fopen ((dir / "ccap.mxf").string().c_str(), "wb");
+	BOOST_REQUIRE (f);
+	fclose (f);
+
+	dcp::DCP d (dir);
+	d.read (false, 0, false, 1, true);
+	BOOST_REQUIRE_EQUAL (d.cpls().size(), 1);
+	shared_ptr<dcp::Reel> read_reel = d.cpls().front()->reels().front();
+	BOOST_REQUIRE (read_reel->main_subtitle());
+	BOOST_CHECK (read_reel->main_subtitle()->asset_ref().resolved());
+	BOOST_CHECK (!read_reel->main_subtitle()->asset_ref().has_asset());
+	BOOST_REQUIRE_EQUAL (read_reel->closed_captions().size(), 1);
+	BOOST_CHECK (read_reel->closed_captions().front()->asset_ref().resolved());
+
+	/* Using them should */
+	BOOST_CHECK_THROW (read_reel->main_subtitle()->asset_ref().asset(), dcp::DCPReadError);
+	BOOST_CHECK_THROW (read_reel->closed_captions().front()->asset_ref().asset(), dcp::DCPReadError);
+}
@@ -18,8 +18,10 @@
 */
 
 #include "rgb_xyz.h"
+#include "rgb_xyz_simd.h"
 #include "openjpeg_image.h"
 #include "colour_conversion.h"
+#include "colour_conversion_plan.h"
 #include <boost/test/unit_test.hpp>
 #include <boost/bind.hpp>
 #include <boost/scoped_array.hpp>
@@ -194,3 +196,147 @@ BOOST_AUTO_TEST_CASE (rgb_xyz_round_trip_test)
 	}
 #endif
 }
+
+/** Check that the vectorised XYZ to RGB conversions give exactly the same results as the scalar ones */
+BOOST_AUTO_TEST_CASE (xyz_rgb_simd_test)
+{
+	srand (1);
+	/* An odd width to exercise the scalar code at the end of each row */
+	dcp::Size const size (643, 37);
+
+	shared_ptr<dcp::OpenJPEGImage> xyz (new dcp::OpenJPEGImage (size));
+	for (int c = 0; c < 3; ++c) {
+		for (int i = 0; i < size.width * size.height; ++i) {
+			xyz->data(c)[i] = rand () & 0xfff;
+		}
+	}
+
+	/* xyz_to_rgba does not accept out-of-range values, so do that first */
+	scoped_array<uint8_t> scalar_rgba (new uint8_t[size.width * size.height * 4]);
+	scoped_array<uint8_t> simd_rgba (new uint8_t[size.width * size.height * 4]);
+
+	dcp::simd::set_level (dcp::simd::LEVEL_SCALAR);
+	dcp::xyz_to_rgba (xyz, dcp::ColourConversion::srgb_to_xyz (), scalar_rgba.get(), size.width * 4);
+
+	for (int l = dcp::simd::LEVEL_SSE2; l <= dcp::simd::best_level(); ++l) {
+		dcp::simd::set_level (static_cast<dcp::simd::Level> (l));
+		dcp::xyz_to_rgba (xyz, dcp::ColourConversion::srgb_to_xyz (), simd_rgba.get(), size.width * 4);
+		BOOST_CHECK_EQUAL (memcmp (scalar_rgba.get(), simd_rgba.get(), size.width * size.height * 4), 0);
+	}
+
+	/* Sprinkle some out-of-range values for xyz_to_rgb to clamp */
+	for (int i = 0; i < 64; ++i) {
+		xyz->data(rand () % 3)[rand () % (size.width * size.height)] = (rand () % 16384) - 8192;
+	}
+
+	scoped_array<uint8_t> scalar_rgb (new uint8_t[size.width * size.height * 6]);
+	scoped_array<uint8_t> simd_rgb (new uint8_t[size.width * size.height * 6]);
+
+	notes.clear ();
+	dcp::simd::set_level (dcp::simd::LEVEL_SCALAR);
+	dcp::xyz_to_rgb (
+		xyz, dcp::ColourConversion::srgb_to_xyz (), scalar_rgb.get(), size.width * 6, boost::optional<dcp::NoteHandler> (boost::bind (&note_handler, _1, _2))
+		);
+	list<string> const scalar_notes = notes;
+
+	for (int l = dcp::simd::LEVEL_SSE2; l <= dcp::simd::best_level(); ++l) {
+		notes.clear ();
+		dcp::simd::set_level (static_cast<dcp::simd::Level> (l));
+		dcp::xyz_to_rgb (
+			xyz, dcp::ColourConversion::srgb_to_xyz (), simd_rgb.get(), size.width * 6, boost::optional<dcp::NoteHandler> (boost::bind (&note_handler, _1, _2))
+			);
+		BOOST_CHECK_EQUAL (memcmp (scalar_rgb.get(), simd_rgb.get(), size.width * size.height * 6), 0);
+		BOOST_CHECK (scalar_notes == notes);
+	}
+
+	dcp::simd::set_level (dcp::simd::best_level ());
+}
+
+/** Check that converting in bands on several threads gives the same results as using one */
+BOOST_AUTO_TEST_CASE (rgb_xyz_threads_test)
+{
+	srand (2);
+	dcp::Size const size (512, 301);
+
+	scoped_array<uint8_t> rgb (new uint8_t[size.width * size.height * 6]);
+	uint16_t* p = reinterpret_cast<uint16_t*> (rgb.get());
+	for (int i = 0; i < size.width * size.height * 3; ++i) {
+		*p++ = rand () & 0xffff;
+	}
+
+	notes.clear ();
+	shared_ptr<dcp::OpenJPEGImage> xyz_one = dcp::rgb_to_xyz (
+		rgb.get(), size, size.width * 6, dcp::ColourConversion::rec709_to_xyz (), boost::optional<dcp::NoteHandler> (boost::bind (&note_handler, _1, _2))
+		);
+	list<string> const one_notes = notes;
+
+	notes.clear ();
+	shared_ptr<dcp::OpenJPEGImage> xyz_many = dcp::rgb_to_xyz (
+		rgb.get(), size, size.width * 6, dcp::ColourConversion::rec709_to_xyz (), 7, boost::optional<dcp::NoteHandler> (boost::bind (&note_handler, _1, _2))
+		);
+
+	/* The clamped values from all bands should be counted in a single note */
+	BOOST_CHECK (one_notes == notes);
+	for (int c = 0; c < 3; ++c) {
+		BOOST_CHECK_EQUAL (memcmp (xyz_one->data(c), xyz_many->data(c), size.width * size.height * sizeof (int)), 0);
+	}
+
+	scoped_array<uint8_t> rgba_one (new uint8_t[size.width * size.height * 4]);
+	scoped_array<uint8_t> rgba_many (new uint8_t[size.width * size.height * 4]);
+	dcp::xyz_to_rgba (xyz_one, dcp::ColourConversion::rec709_to_xyz (), rgba_one.get(), size.width * 4);
+	dcp::xyz_to_rgba (xyz_one, dcp::ColourConversion::rec709_to_xyz (), rgba_many.get(), size.width * 4, 7);
+	BOOST_CHECK_EQUAL (memcmp (rgba_one.get(), rgba_many.get(), size.width * size.height * 4), 0);
+
+	xyz_one->data(0)[0] = -1;
+	xyz_one->data(1)[size.width * size.height - 1] = 4096;
+
+	scoped_array<uint8_t> rgb_one (new uint8_t[size.width * size.height * 6]);
+	scoped_array<uint8_t> rgb_many (new uint8_t[size.width * size.height * 6]);
+
+	notes.clear ();
+	dcp::xyz_to_rgb (
+		xyz_one, dcp::ColourConversion::rec709_to_xyz (), rgb_one.get(), size.width * 6, boost::optional<dcp::NoteHandler> (boost::bind (&note_handler, _1, _2))
+		);
+	BOOST_REQUIRE_EQUAL (notes.size(), 2);
+
+	notes.clear ();
+	dcp::xyz_to_rgb (
+		xyz_one, dcp::ColourConversion::rec709_to_xyz (), rgb_many.get(), size.width * 6, 7, boost::optional<dcp::NoteHandler> (boost::bind (&note_handler, _1, _2))
+		);
+	BOOST_REQUIRE_EQUAL (notes.size(), 2);
+	BOOST_CHECK_EQUAL (notes.front(), "XYZ value -1 out of range");
+	BOOST_CHECK_EQUAL (notes.back(), "XYZ value 4096 out of range");
+
+	BOOST_CHECK_EQUAL (memcmp (rgb_one.get(), rgb_many.get(), size.width * size.height * 6), 0);
+}
+
+/** Check that conversions using a ColourConversionPlan give the same results as those using the ColourConversion */
+BOOST_AUTO_TEST_CASE (rgb_xyz_plan_test)
+{
+	srand (3);
+	dcp::Size const size (97, 61);
+
+	scoped_array<uint8_t> rgb (new uint8_t[size.width * size.height * 6]);
+	uint16_t* p = reinterpret_cast<uint16_t*> (rgb.get());
+	for (int i = 0; i < size.width * size.height * 3; ++i) {
+		*p++ = rand () & 0xffff;
+	}
+
+	dcp::ColourConversionPlan const plan (dcp::ColourConversion::p3_to_xyz ());
+
+	shared_ptr<dcp::OpenJPEGImage> xyz = dcp::rgb_to_xyz (rgb.get(), size, size.width * 6, dcp::ColourConversion::p3_to_xyz ());
+	shared_ptr<dcp::OpenJPEGImage> xyz_plan = dcp::rgb_to_xyz (rgb.get(), size, size.width * 6, plan, 3);
+	for (int c = 0; c < 3; ++c) {
+		BOOST_CHECK_EQUAL (memcmp (xyz->data(c), xyz_plan->data(c), size.width * size.height * sizeof (int)), 0);
+	}
+
+	scoped_array<uint8_t> back (new uint8_t[size.width * size.height * 6]);
+	scoped_array<uint8_t> back_plan (new uint8_t[size.width * size.height * 6]);
+	dcp::xyz_to_rgb (xyz, dcp::ColourConversion::p3_to_xyz (), back.get(), size.width * 6);
+	dcp::xyz_to_rgb (xyz, plan, back_plan.get(), size.width * 6);
+	BOOST_CHECK_EQUAL (memcmp (back.get(), back_plan.get(), size.width * size.height * 6), 0);
+
+	dcp::xyz_to_rgba (xyz, dcp::ColourConversion::srgb_to_xyz (), back.get(), size.width * 4);
+	dcp::xyz_to_rgba (xyz, dcp::ColourConversionPlan::srgb_to_xyz (), back_plan.get(), size.width * 4);
+	BOOST_CHECK_EQUAL (memcmp (back.get(), back_plan.get(), size.width * size.height * 4), 0);
+}
@@ -0,0 +1,502 @@
+/*
+    Copyright (C) 2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** @file  test/stack_bench.cc
+ *  @brief Benchmarks of the main parts of libdcp, run on synthetic DCPs.
+ *
+ *  The fixtures are generated each time, according to the options, so no private
+ *  test data is needed.  Results can be written as JSON so that they can be kept
+ *  and compared between versions.
+ */
+
+#include "colour_conversion.h"
+#include "compose.hpp"
+#include "cpl.h"
+#include "dcp.h"
+#include "decrypted_kdm.h"
+#include "encrypted_kdm.h"
+#include "certificate_chain.h"
+#include "interop_subtitle_asset.h"
+#include "j2k.h"
+#include "key.h"
+#include "mono_picture_asset.h"
+#include "mono_picture_asset_reader.h"
+#include "mono_picture_frame.h"
+#include "openjpeg_image.h"
+#include "picture_asset_writer.h"
+#include "reel.h"
+#include "reel_mono_picture_asset.h"
+#include "rgb_xyz.h"
+#include "subtitle_string.h"
+#include "util.h"
+#include "version.h"
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread.hpp>
+#include <getopt.h>
+#include <sys/time.h>
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <list>
+
+using std::cout;
+using std::cerr;
+using std::string;
+using std::vector;
+using std::list;
+using std::max;
+using boost::shared_ptr;
+using boost::function;
+using boost::scoped_array;
+
+static double
+seconds ()
+{
+	struct timeval t;
+	gettimeofday (&t, 0);
+	return t.tv_sec + t.tv_usec / 1e6;
+}
+
+/** The timings of one benchmark */
+struct Result
+{
+	Result (string name_, string unit_, double amount_)
+		: name (name_)
+		, unit (unit_)
+		, amount (amount_)
+	{}
+
+	string name;
+	/** what `amount' is counting, e.g. frames or bytes */
+	string unit;
+	/** amount of work done by each run */
+	double amount;
+	/** time taken by each run, in seconds */
+	vector<double> times;
+
+	double min () const {
+		double m = times.front ();
+		for (vector<double>::const_iterator i = times.begin(); i != times.end(); ++i) {
+			m = std::min (m, *i);
+		}
+		return m;
+	}
+
+	double mean () const {
+		double t = 0;
+		for (vector<double>::const_iterator i = times.begin(); i != times.end(); ++i) {
+			t += *i;
+		}
+		return t / times.size ();
+	}
+};
+
+struct Options
+{
+	Options ()
+		: width (1998)
+		, height (1080)
+		, frames (48)
+		, reels (50)
+		, subtitles (2000)
+		, encrypt (false)
+		, threads (max (1U, boost::thread::hardware_concurrency ()))
+		, repeat (3)
+		, json (false)
+		, output ("build/bench")
+		, crypt ("test/ref/crypt")
+	{}
+
+	int width;
+	int height;
+	/** number of frames in the picture MXFs */
+	int frames;
+	/** number of reels (each with its own picture MXF) in the DCP that is read */
+	int reels;
+	/** number of subtitles in the subtitle XML */
+	int subtitles;
+	bool encrypt;
+	int threads;
+	/** number of times to run each benchmark */
+	int repeat;
+	bool json;
+	/** directory to write the fixtures to */
+	boost::filesystem::path output;
+	/** directory containing a certificate chain and key for KDMs */
+	boost::filesystem::path crypt;
+};
+
+static Options options;
+static list<Result> results;
+
+static void
+run (string name, string unit, double amount, function<void ()> fn)
+{
+	Result r (name, unit, amount);
+	for (int i = 0; i < options.repeat; ++i) {
+		double const start = seconds ();
+		fn ();
+		r.times.push_back (seconds () - start);
+	}
+
+	if (!options.json) {
+		cerr << name << ": " << (amount / r.min ()) << " " << unit << "/s\n";
+	}
+
+	results.push_back (r);
+}
+
+/** @return a 16-bit RGB gradient of the size given in the options */
+static scoped_array<uint8_t> &
+rgb_frame ()
+{
+	static scoped_array<uint8_t> rgb;
+	if (!rgb) {
+		rgb.reset (new uint8_t[options.width * options.height * 6]);
+		uint16_t* p = reinterpret_cast<uint16_t*> (rgb.get ());
+		for (int y = 0; y < options.height; ++y) {
+			for (int x = 0; x < options.width; ++x) {
+				*p++ = x * 65535 / options.width;
+				*p++ = y * 65535 / options.height;
+				*p++ = (x + y) * 65535 / (options.width + options.height);
+			}
+		}
+	}
+	return rgb;
+}
+
+static void
+rgb_to_xyz (int threads)
+{
+	dcp::rgb_to_xyz (
+		rgb_frame().get(), dcp::Size (options.width, options.height), options.width * 6, dcp::ColourConversion::srgb_to_xyz (), threads
+		);
+}
+
+static void
+xyz_to_rgb (shared_ptr<const dcp::OpenJPEGImage> xyz, uint8_t* rgb, int threads)
+{
+	dcp::xyz_to_rgb (xyz, dcp::ColourConversion::srgb_to_xyz (), rgb, options.width * 6, threads);
+}
+
+static void
+write_mxf (boost::filesystem::path file, dcp::Data const & j2k, int frames, boost::optional<dcp::Key> key)
+{
+	shared_ptr<dcp::MonoPictureAsset> asset (new dcp::MonoPictureAsset (dcp::Fraction (24, 1), dcp::SMPTE));
+	if (key) {
+		asset->set_key (*key);
+	}
+	shared_ptr<dcp::PictureAssetWriter> writer = asset->start_write (file, false);
+	for (int i = 0; i < frames; ++i) {
+		writer->write (j2k.data().get(), j2k.size());
+	}
+	writer->finalize ();
+}
+
+static void
+read_mxf (boost::filesystem::path file, boost::optional<dcp::Key> key)
+{
+	dcp::MonoPictureAsset asset (file);
+	if (key) {
+		asset.set_key (*key);
+	}
+	shared_ptr<dcp::MonoPictureAssetReader> reader = asset.start_read ();
+	for (int i = 0; i < asset.intrinsic_duration(); ++i) {
+		reader->get_frame (i);
+	}
+}
+
+static void
+digest (boost::filesystem::path file)
+{
+	dcp::make_digest (file, 0);
+}
+
+static void
+read_dcp (boost::filesystem::path directory, int threads, bool lazy)
+{
+	dcp::DCP dcp (directory);
+	dcp.read (false, 0, false, threads, lazy);
+}
+
+static void
+read_subtitles (boost::filesystem::path file)
+{
+	dcp::InteropSubtitleAsset asset (file);
+}
+
+static void
+decrypt_kdms (string xml, string key, int count)
+{
+	for (int i = 0; i < count; ++i) {
+		dcp::DecryptedKDM kdm (dcp::EncryptedKDM (xml), key);
+	}
+}
+
+static void
+help (string n)
+{
+	cerr << "Syntax: " << n << " [OPTION]\n"
+	     << "  -w, --width           width of the picture (default 1998)\n"
+	     << "  -h, --height          height of the picture (default 1080)\n"
+	     << "  -f, --frames          frames in each picture MXF (default 48)\n"
+	     << "  -r, --reels           reels in the DCP to read (default 50)\n"
+	     << "  -s, --subtitles       subtitles in the subtitle file to read (default 2000)\n"
+	     << "  -e, --encrypt         also benchmark writing and reading encrypted MXFs\n"
+	     << "  -t, --threads         threads to use for the threaded benchmarks (default: number of CPUs)\n"
+	     << "  -n, --repeat          number of times to run each benchmark (default 3)\n"
+	     << "  -j, --json            write results to stdout as JSON\n"
+	     << "  -o, --output          directory to write fixtures to (default build/bench)\n"
+	     << "  -c, --crypt           directory containing leaf.key and a certificate chain (default test/ref/crypt)\n"
+	     << "      --help            show this help\n";
+}
+
+static void
+write_json ()
+{
+	cout << "{\n"
+	     << "  \"version\": \"" << dcp::version << "\",\n"
+	     << "  \"git_commit\": \"" << dcp::git_commit << "\",\n"
+	     << "  \"parameters\": {\n"
+	     << "    \"width\": " << options.width << ",\n"
+	     << "    \"height\": " << options.height << ",\n"
+	     << "    \"frames\": " << options.frames << ",\n"
+	     << "    \"reels\": " << options.reels << ",\n"
+	     << "    \"subtitles\": " << options.subtitles << ",\n"
+	     << "    \"encrypt\": " << (options.encrypt ? "true" : "false") << ",\n"
+	     << "    \"threads\": " << options.threads << ",\n"
+	     << "    \"repeat\": " << options.repeat << "\n"
+	     << "  },\n"
+	     << "  \"results\": [\n";
+
+	for (list<Result>::const_iterator i = results.begin(); i != results.end(); ++i) {
+		cout << "    { \"name\": \"" << i->name << "\", \"unit\": \"" << i->unit << "\", \"amount\": " << i->amount
+		     << ", \"times\": [";
+		for (vector<double>::const_iterator j = i->times.begin(); j != i->times.end(); ++j) {
+			if (j != i->times.begin()) {
+				cout << ", ";
+			}
+			cout << *j;
+		}
+		cout << "], \"min\": " << i->min() << ", \"mean\": " << i->mean() << ", \"rate\": " << (i->amount / i->min()) << " }";
+		list<Result>::const_iterator j = i;
+		++j;
+		if (j != results.end()) {
+			cout << ",";
+		}
+		cout << "\n";
+	}
+
+	cout << "  ]\n"
+	     << "}\n";
+}
+
+int
+main (int argc, char* argv[])
+{
+	int option_index = 0;
+	while (true) {
+		static struct option long_options[] = {
+			{ "width", required_argument, 0, 'w' },
+			{ "height", required_argument, 0, 'h' },
+			{ "frames", required_argument, 0, 'f' },
+			{ "reels", required_argument, 0, 'r' },
+			{ "subtitles", required_argument, 0, 's' },
+			{ "encrypt", no_argument, 0, 'e' },
+			{ "threads", required_argument, 0, 't' },
+			{ "repeat", required_argument, 0, 'n' },
+			{ "json", no_argument, 0, 'j' },
+			{ "output", required_argument, 0, 'o' },
+			{ "crypt", required_argument, 0, 'c' },
+			{ "help", no_argument, 0, 'A' },
+			{ 0, 0, 0, 0 }
+		};
+
+		int c = getopt_long (argc, argv, "w:h:f:r:s:et:n:jo:c:A", long_options, &option_index);
+
+		if (c == -1) {
+			break;
+		}
+
+		switch (c) {
+		case 'w':
+			options.width = atoi (optarg);
+			break;
+		case 'h':
+			options.height = atoi (optarg);
+			break;
+		case 'f':
+			options.frames = atoi (optarg);
+			break;
+		case 'r':
+			options.reels = atoi (optarg);
+			break;
+		case 's':
+			options.subtitles = atoi (optarg);
+			break;
+		case 'e':
+			options.encrypt = true;
+			break;
+		case 't':
+			options.threads = atoi (optarg);
+			break;
+		case 'n':
+			options.repeat = atoi (optarg);
+			break;
+		case 'j':
+			options.json = true;
+			break;
+		case 'o':
+			options.output = optarg;
+			break;
+		case 'c':
+			options.crypt = optarg;
+			break;
+		case 'A':
+			help (argv[0]);
+			exit (EXIT_SUCCESS);
+		default:
+			help (argv[0]);
+			exit (EXIT_FAILURE);
+		}
+	}
+
+	if (options.width < 32 || options.height < 32) {
+		cerr << argv[0] << ": the picture must be at least 32x32.\n";
+		exit (EXIT_FAILURE);
+	}
+
+	if (options.frames < 1 || options.reels < 1 || options.subtitles < 1 || options.threads < 1 || options.repeat < 1) {
+		cerr << argv[0] << ": counts must be positive.\n";
+		exit (EXIT_FAILURE);
+	}
+
+	dcp::init ();
+
+	boost::filesystem::remove_all (options.output);
+	boost::filesystem::create_directories (options.output);
+
+	dcp::Size const size (options.width, options.height);
+	bool const fourk = options.width > 2048;
+	double const pixels = double (options.width) * options.height;
+
+	/* Colour conversion */
+
+	run ("rgb_to_xyz", "pixels", pixels, boost::bind (&rgb_to_xyz, 1));
+	run ("rgb_to_xyz_threaded", "pixels", pixels, boost::bind (&rgb_to_xyz, options.threads));
+
+	shared_ptr<dcp::OpenJPEGImage> xyz = dcp::rgb_to_xyz (
+		rgb_frame().get(), size, options.width * 6, dcp::ColourConversion::srgb_to_xyz ()
+		);
+	scoped_array<uint8_t> rgb (new uint8_t[options.width * options.height * 6]);
+	run ("xyz_to_rgb", "pixels", pixels, boost::bind (&xyz_to_rgb, xyz, rgb.get(), 1));
+	run ("xyz_to_rgb_threaded", "pixels", pixels, boost::bind (&xyz_to_rgb, xyz, rgb.get(), options.threads));
+
+	/* MXF writing, reading and hashing; every frame is the same */
+
+	dcp::Data const j2k = dcp::compress_j2k (xyz, 250000000, 24, false, fourk);
+	double const bytes = double (j2k.size()) * options.frames;
+	dcp::Key const key;
+
+	boost::filesystem::path const plain = options.output / "plain.mxf";
+	run ("mxf_write", "frames", options.frames, boost::bind (&write_mxf, plain, boost::cref (j2k), options.frames, boost::optional<dcp::Key> ()));
+	run ("mxf_read", "frames", options.frames, boost::bind (&read_mxf, plain, boost::optional<dcp::Key> ()));
+
+	if (options.encrypt) {
+		boost::filesystem::path const encrypted = options.output / "encrypted.mxf";
+		run ("mxf_write_encrypted", "frames", options.frames, boost::bind (&write_mxf, encrypted, boost::cref (j2k), options.frames, key));
+		run ("mxf_read_encrypted", "frames", options.frames, boost::bind (&read_mxf, encrypted, key));
+	}
+
+	run ("make_digest", "bytes", bytes, boost::bind (&digest, plain));
+
+	/* A DCP with many reels, each with its own one-frame MXF of a small picture */
+
+	boost::filesystem::path const package = options.output / "package";
+	boost::filesystem::create_directories (package);
+	dcp::Data const small_j2k = dcp::compress_j2k (
+		dcp::rgb_to_xyz (rgb_frame().get(), dcp::Size (32, 32), options.width * 6, dcp::ColourConversion::srgb_to_xyz ()), 100000000, 24, false, false
+		);
+	shared_ptr<dcp::CPL> cpl (new dcp::CPL ("Benchmark", dcp::FEATURE));
+	for (int i = 0; i < options.reels; ++i) {
+		boost::filesystem::path const file = package / String::compose ("video_%1.mxf", i);
+		write_mxf (file, small_j2k, 1, boost::optional<dcp::Key> ());
+		shared_ptr<dcp::MonoPictureAsset> asset (new dcp::MonoPictureAsset (file));
+		cpl->add (shared_ptr<dcp::Reel> (new dcp::Reel (shared_ptr<dcp::ReelMonoPictureAsset> (new dcp::ReelMonoPictureAsset (asset, 0)))));
+	}
+	dcp::DCP writer (package);
+	writer.add (cpl);
+	writer.write_xml (dcp::SMPTE);
+
+	run ("dcp_read", "reels", options.reels, boost::bind (&read_dcp, package, 1, false));
+	run ("dcp_read_threaded", "reels", options.reels, boost::bind (&read_dcp, package, options.threads, false));
+	run ("dcp_read_lazy", "reels", options.reels, boost::bind (&read_dcp, package, 1, true));
+
+	/* Subtitle XML */
+
+	dcp::InteropSubtitleAsset subtitles;
+	subtitles.set_reel_number ("1");
+	subtitles.set_language ("EN");
+	subtitles.set_movie_title ("Benchmark");
+	for (int i = 0; i < options.subtitles; ++i) {
+		subtitles.add (
+			shared_ptr<dcp::Subtitle> (
+				new dcp::SubtitleString (
+					string ("Arial"), i % 2, false, false, dcp::Colour (255, 255, 255), 42, 1,
+					dcp::Time (i * 48, 24, 24), dcp::Time (i * 48 + 36, 24, 24),
+					0, dcp::HALIGN_CENTER, 0.1, dcp::VALIGN_BOTTOM, dcp::DIRECTION_LTR,
+					String::compose ("Subtitle number %1 of the benchmark", i),
+					dcp::BORDER, dcp::Colour (0, 0, 0), dcp::Time (0, 0, 0, 0, 24), dcp::Time (0, 0, 0, 0, 24)
+					)
+				)
+			);
+	}
+	boost::filesystem::path const subtitle_file = options.output / "subtitles.xml";
+	subtitles.write (subtitle_file);
+	run ("subtitle_parse", "subtitles", options.subtitles, boost::bind (&read_subtitles, subtitle_file));
+
+	/* KDMs with one key per reel of the DCP above */
+
+	shared_ptr<dcp::CertificateChain> signer (new dcp::CertificateChain ());
+	signer->add (dcp::Certificate (dcp::file_to_string (options.crypt / "ca.self-signed.pem")));
+	signer->add (dcp::Certificate (dcp::file_to_string (options.crypt / "intermediate.signed.pem")));
+	signer->add (dcp::Certificate (dcp::file_to_string (options.crypt / "leaf.signed.pem")));
+	string const private_key = dcp::file_to_string (options.crypt / "leaf.key");
+	signer->set_key (private_key);
+
+	dcp::DecryptedKDM decrypted (
+		dcp::LocalTime ("2018-01-01T00:00:00+00:00"), dcp::LocalTime ("2028-01-01T00:00:00+00:00"), "Benchmark", "Benchmark", "2018-01-01T00:00:00+00:00"
+		);
+	for (int i = 0; i < options.reels; ++i) {
+		decrypted.add_key (string ("MDIK"), dcp::make_uuid (), dcp::Key (), cpl->id (), dcp::SMPTE);
+	}
+	string const kdm = decrypted.encrypt (
+		signer, signer->leaf (), vector<dcp::Certificate> (), dcp::MODIFIED_TRANSITIONAL_1, true, 0
+		).as_xml ();
+	int const kdms = 10;
+	run ("kdm_decrypt", "kdms", kdms, boost::bind (&decrypt_kdms, kdm, private_key, kdms));
+
+	if (options.json) {
+		write_json ();
+	}
+
+	return 0;
+}
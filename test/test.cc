@@ -21,6 +21,10 @@
 #define BOOST_TEST_MODULE libdcp_test
 #include "util.h"
 #include "test.h"
+#include "j2k.h"
+#include "openjpeg_image.h"
+#include "mono_picture_asset.h"
+#include "picture_asset_writer.h"
 #include <libxml++/libxml++.h>
 #include <boost/test/unit_test.hpp>
 #include <cstdio>
@@ -29,6 +33,7 @@
 using std::string;
 using std::min;
 using std::list;
+using boost::shared_ptr;
 
 boost::filesystem::path private_test;
 
@@ -151,4 +156,40 @@ check_file (boost::filesystem::path ref, boost::filesystem::path check)
 	fclose (check_file);
 }
 
+/** @return A 32x32 XYZ image which is different for each value of n */
+shared_ptr<dcp::OpenJPEGImage>
+test_xyz_image (int n)
+{
+	shared_ptr<dcp::OpenJPEGImage> xyz (new dcp::OpenJPEGImage (dcp::Size (32, 32)));
+	for (int c = 0; c < 3; ++c) {
+		for (int i = 0; i < 32 * 32; ++i) {
+			xyz->data(c)[i] = (i * 4 + c * 1000 + n * 97) & 4095;
+		}
+	}
+	return xyz;
+}
+
+/** @return test_xyz_image(n) compressed to JPEG2000 */
+dcp::Data
+test_j2k_frame (int n)
+{
+	return dcp::compress_j2k (test_xyz_image (n), 100000000, 24, false, false);
+}
+
+/** Write a SMPTE MonoPictureAsset whose frame i is test_j2k_frame(i), so that tests can
+ *  tell which frame they have been given.
+ */
+shared_ptr<dcp::MonoPictureAsset>
+write_test_frames (boost::filesystem::path file, int frames)
+{
+	shared_ptr<dcp::MonoPictureAsset> asset (new dcp::MonoPictureAsset (dcp::Fraction (24, 1), dcp::SMPTE));
+	shared_ptr<dcp::PictureAssetWriter> writer = asset->start_write (file, false);
+	for (int i = 0; i < frames; ++i) {
+		dcp::Data const j2k = test_j2k_frame (i);
+		writer->write (j2k.data().get(), j2k.size());
+	}
+	writer->finalize ();
+	return asset;
+}
+
 BOOST_GLOBAL_FIXTURE (TestConfig);
@@ -17,13 +17,23 @@
     along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "data.h"
 #include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
 
 namespace xmlpp {
 	class Element;
 }
 
+namespace dcp {
+	class MonoPictureAsset;
+	class OpenJPEGImage;
+}
+
 extern boost::filesystem::path private_test;
 extern void check_xml (xmlpp::Element* ref, xmlpp::Element* test, std::list<std::string> ignore);
 extern void check_xml (std::string ref, std::string test, std::list<std::string> ignore);
 extern void check_file (boost::filesystem::path ref, boost::filesystem::path check);
+extern boost::shared_ptr<dcp::OpenJPEGImage> test_xyz_image (int n);
+extern dcp::Data test_j2k_frame (int n);
+extern boost::shared_ptr<dcp::MonoPictureAsset> write_test_frames (boost::filesystem::path file, int frames);
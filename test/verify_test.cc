@@ -33,6 +33,7 @@
 
 #include "verify.h"
 #include "util.h"
+#include "hash_cache.h"
 #include <boost/test/unit_test.hpp>
 #include <cstdio>
 #include <iostream>
@@ -86,14 +87,15 @@ BOOST_AUTO_TEST_CASE (verify_test1)
 	BOOST_CHECK_EQUAL (st->first, "Checking reel");
 	BOOST_REQUIRE (!st->second);
 	++st;
-	BOOST_CHECK_EQUAL (st->first, "Checking picture asset hash");
-	BOOST_REQUIRE (st->second);
-	BOOST_CHECK_EQUAL (st->second.get(), boost::filesystem::canonical("build/test/verify_test1/video.mxf"));
-	++st;
+	/* Asset hashes are given stages as they are started, which is biggest first */
 	BOOST_CHECK_EQUAL (st->first, "Checking sound asset hash");
 	BOOST_REQUIRE (st->second);
 	BOOST_CHECK_EQUAL (st->second.get(), boost::filesystem::canonical("build/test/verify_test1/audio.mxf"));
 	++st;
+	BOOST_CHECK_EQUAL (st->first, "Checking picture asset hash");
+	BOOST_REQUIRE (st->second);
+	BOOST_CHECK_EQUAL (st->second.get(), boost::filesystem::canonical("build/test/verify_test1/video.mxf"));
+	++st;
 	BOOST_REQUIRE (st == stages.end());
 
 	BOOST_CHECK_EQUAL (notes.size(), 0);
@@ -145,3 +147,41 @@ BOOST_AUTO_TEST_CASE (verify_test1)
 	BOOST_CHECK_EQUAL (notes.back().note(), "PKL and CPL hashes differ for sound asset.");
 
 }
+
+/** Check that verify uses and updates its hash cache */
+BOOST_AUTO_TEST_CASE (verify_test2)
+{
+	boost::filesystem::path const dir = "build/test/verify_test2";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directory (dir);
+	for (boost::filesystem::directory_iterator i("test/ref/DCP/dcp_test1"); i != boost::filesystem::directory_iterator(); ++i) {
+		boost::filesystem::copy_file (i->path(), dir / i->path().filename());
+	}
+
+	vector<boost::filesystem::path> directories;
+	directories.push_back (dir);
+	boost::filesystem::path const cache = "build/test/verify_test2.cache";
+	boost::filesystem::remove (cache);
+
+	/* First time round both assets are hashed and added to the cache */
+	list<dcp::VerificationNote> notes = dcp::verify (directories, &stage, &progress, 2, cache);
+	BOOST_CHECK_EQUAL (notes.size(), 0);
+	BOOST_CHECK_EQUAL (dcp::file_to_string(cache).find(dcp::make_digest(dir / "video.mxf", 0)) != string::npos, true);
+	BOOST_CHECK_EQUAL (dcp::file_to_string(cache).find(dcp::make_digest(dir / "audio.mxf", 0)) != string::npos, true);
+
+	/* A wrong hash in the cache for an unchanged file should be believed */
+	boost::filesystem::path const video = dir / "video.mxf";
+	{
+		dcp::HashCache hashes (cache);
+		hashes.add (video, "wrong");
+	}
+
+	notes = dcp::verify (directories, &stage, &progress, 2, cache);
+	BOOST_REQUIRE_EQUAL (notes.size(), 1);
+	BOOST_CHECK_EQUAL (notes.front().note(), "Picture asset hash is incorrect.");
+
+	/* but not once the file has been touched */
+	boost::filesystem::last_write_time (video, boost::filesystem::last_write_time (video) + 1);
+	notes = dcp::verify (directories, &stage, &progress, 2, cache);
+	BOOST_CHECK_EQUAL (notes.size(), 0);
+}
@@ -39,6 +39,7 @@
 #include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 #include <iostream>
 #include <list>
 
@@ -46,6 +47,7 @@ using std::list;
 using std::cerr;
 using std::cout;
 using std::string;
+using std::max;
 using boost::shared_ptr;
 using boost::optional;
 using boost::dynamic_pointer_cast;
@@ -69,6 +71,13 @@ help (string n)
 	     << "      --key                    hexadecimal key to use to decrypt MXFs\n"
 	     << "  -k, --keep-going             carry on in the event of errors, if possible\n"
 	     << "      --ignore-missing-assets  ignore missing asset files\n"
+	     << "  -r, --reduce                 compare pictures at 1/2^N resolution first, and only\n"
+	     << "                               at full resolution if they differ at that resolution;\n"
+	     << "                               this is quicker but can miss fine differences; -v\n"
+	     << "                               says if any frames were accepted at the reduced resolution\n"
+	     << "      --reduced-mean-pixel     maximum allowed mean pixel error at reduced resolution (default 0)\n"
+	     << "      --reduced-std-dev-pixel  maximum allowed standard deviation of pixel error at reduced resolution (default 0)\n"
+	     << "  -t, --threads                number of threads to compare pictures with (default: number of CPUs)\n"
 	     << "\n"
 	     << "The <DCP>s are the DCP directories to compare.\n"
 	     << "Comparison is of metadata and content, ignoring timestamps\n"
@@ -124,6 +133,7 @@ main (int argc, char* argv[])
 	options.reel_hashes_can_differ = true;
 	options.reel_annotation_texts_can_differ = false;
 	options.keep_going = false;
+	options.threads = max (1U, boost::thread::hardware_concurrency ());
 	bool ignore_missing_assets = false;
 	optional<string> key;
 
@@ -138,15 +148,19 @@ main (int argc, char* argv[])
 			{ "keep-going", no_argument, 0, 'k'},
 			{ "annotation-texts", no_argument, 0, 'a'},
 			{ "issue-dates", no_argument, 0, 'd'},
+			{ "reduce", required_argument, 0, 'r'},
+			{ "threads", required_argument, 0, 't'},
 			/* From here we're using random capital letters for the short option */
 			{ "ignore-missing-assets", no_argument, 0, 'A'},
 			{ "cpl-annotation-texts", no_argument, 0, 'C'},
 			{ "key", required_argument, 0, 'D'},
 			{ "reel-annotation-texts", no_argument, 0, 'E'},
+			{ "reduced-mean-pixel", required_argument, 0, 'F'},
+			{ "reduced-std-dev-pixel", required_argument, 0, 'G'},
 			{ 0, 0, 0, 0 }
 		};
 
-		int c = getopt_long (argc, argv, "Vhvm:s:kadACD:E", long_options, &option_index);
+		int c = getopt_long (argc, argv, "Vhvm:s:kadr:t:ACD:EF:G:", long_options, &option_index);
 
 		if (c == -1) {
 			break;
@@ -177,6 +191,12 @@ main (int argc, char* argv[])
 		case 'd':
 			options.issue_dates_can_differ = true;
 			break;
+		case 'r':
+			options.reduce = atoi (optarg);
+			break;
+		case 't':
+			options.threads = atoi (optarg);
+			break;
 		case 'A':
 			ignore_missing_assets = true;
 			break;
@@ -190,6 +210,12 @@ main (int argc, char* argv[])
 		case 'E':
 			options.reel_annotation_texts_can_differ = true;
 			break;
+		case 'F':
+			options.max_reduced_mean_pixel_error = atof (optarg);
+			break;
+		case 'G':
+			options.max_reduced_std_dev_pixel_error = atof (optarg);
+			break;
 		}
 	}
 
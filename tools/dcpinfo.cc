@@ -45,6 +45,8 @@
 #include "interop_subtitle_asset.h"
 #include "smpte_subtitle_asset.h"
 #include "mono_picture_asset.h"
+#include "mono_picture_frame.h"
+#include "decode_pipeline.h"
 #include "encrypted_kdm.h"
 #include "decrypted_kdm.h"
 #include "cpl.h"
@@ -52,6 +54,8 @@
 #include <getopt.h>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
 #include <iostream>
 #include <cstdlib>
 #include <inttypes.h>
@@ -61,6 +65,7 @@ using std::cerr;
 using std::cout;
 using std::list;
 using std::pair;
+using std::make_pair;
 using std::min;
 using std::max;
 using std::exception;
@@ -88,6 +93,36 @@ mbits_per_second (int size, Fraction frame_rate)
 	return size * 8 * frame_rate.as_float() / 1e6;
 }
 
+/** @return J2K size of the frame, and whether or not it could be decompressed (if we tried) */
+static pair<int, bool>
+analyse_frame (shared_ptr<const MonoPictureFrame> frame, bool decompress)
+{
+	bool ok = true;
+	if (decompress) {
+		try {
+			frame->xyz_image();
+		} catch (exception& e) {
+			ok = false;
+		}
+	}
+
+	return make_pair (frame->j2k_size(), ok);
+}
+
+static void
+print_frame (int64_t n, pair<int, bool> frame, bool decompress, pair<int, int>* j2k_size_range)
+{
+	printf("Frame %" PRId64 " J2K size %7d", n, frame.first);
+	j2k_size_range->first = min(j2k_size_range->first, frame.first);
+	j2k_size_range->second = max(j2k_size_range->second, frame.first);
+
+	if (decompress) {
+		printf(frame.second ? " decrypted OK" : " decryption FAILED");
+	}
+
+	printf("\n");
+}
+
 static void
 main_picture (shared_ptr<Reel> reel, bool analyse, bool decompress)
 {
@@ -111,25 +146,18 @@ main_picture (shared_ptr<Reel> reel, bool analyse, bool decompress)
 		shared_ptr<MonoPictureAsset> ma = dynamic_pointer_cast<MonoPictureAsset>(reel->main_picture()->asset());
 		if (analyse && ma) {
 			shared_ptr<MonoPictureAssetReader> reader = ma->start_read ();
+			reader->set_pooled (true);
 			pair<int, int> j2k_size_range (INT_MAX, 0);
-			for (int64_t i = 0; i < ma->intrinsic_duration(); ++i) {
-				shared_ptr<const MonoPictureFrame> frame = reader->get_frame (i);
-				printf("Frame %" PRId64 " J2K size %7d", i, frame->j2k_size());
-				j2k_size_range.first = min(j2k_size_range.first, frame->j2k_size());
-				j2k_size_range.second = max(j2k_size_range.second, frame->j2k_size());
-
-				if (decompress) {
-					try {
-						frame->xyz_image();
-						printf(" decrypted OK");
-					} catch (exception& e) {
-						printf(" decryption FAILED");
-					}
-				}
-
-				printf("\n");
-
-			}
+			/* Decompression is slow, so spread it over all our cores */
+			int const threads = decompress ? max (1U, boost::thread::hardware_concurrency ()) : 1;
+			decode_frames<ASDCP::JP2K::MXFReader, MonoPictureFrame, pair<int, bool> > (
+				reader,
+				0,
+				ma->intrinsic_duration(),
+				boost::bind (&analyse_frame, _1, decompress),
+				boost::bind (&print_frame, _1, _2, decompress, &j2k_size_range),
+				threads
+				);
 			printf(
 				"J2K size ranges from %d (%.1f Mbit/s) to %d (%.1f Mbit/s)\n",
 				j2k_size_range.first, mbits_per_second(j2k_size_range.first, ma->frame_rate()),